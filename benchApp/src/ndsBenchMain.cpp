@@ -0,0 +1,781 @@
+/*
+ * EPICS support for NDS3
+ *
+ * Copyright (c) 2015 Cosylab d.d.
+ *
+ * For more information about the license please refer to the license.txt
+ * file included in the distribution.
+ */
+
+/**
+ * @file ndsBenchMain.cpp
+ *
+ * Micro-benchmark for the hot paths of the EPICS interface.
+ *
+ * The benchmark builds an NDS3 port in-process, lets the EPICS interface
+ *  generate and load its records, starts the IOC and then measures the
+ *  operations performed by the drivers on the interface.
+ *
+ * Usage: ndsBench mode [name=value ...]
+ *
+ * Modes:
+ * - push: push values to the PVs from one or more producer threads.
+ * - read: read the PVs through the asyn port, as the records do.
+ * - write: write the PVs through the asyn port, as the records do.
+ *          Parameters of push, read and write: pvs (number of PVs),
+ *          operations, type (int32, float64, int32Array or float64Array),
+ *          size (elements of the arrays), threads, scan (passive or intr,
+ *          push only), subscribers (additional interrupt clients per PV,
+ *          push only)
+ * - startup: measure the time spent creating the records of the PVs and
+ *            initializing the IOC.
+ *            Parameters: pvs (number of PVs)
+ * - jitter: measure the wake-up latency of a periodic thread started with
+ *           runInThread().
+ *           Parameters: period (microseconds), samples, priority (0-99),
+ *                       policy (other, fifo or rr), cpus (e.g. 0,2-3)
+ *
+ */
+
+#include <cstdint>
+#include <cstdlib>
+#include <ctime>
+#include <cstdio>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sstream>
+#include <stdexcept>
+#include <algorithm>
+
+#include <dbAccess.h>
+#include <iocInit.h>
+#include <epicsExit.h>
+#include <asynDriver.h>
+#include <asynInt32.h>
+#include <asynFloat64.h>
+#include <asynInt32Array.h>
+#include <asynFloat64Array.h>
+#include <asynInt32SyncIO.h>
+#include <asynFloat64SyncIO.h>
+#include <asynInt32ArraySyncIO.h>
+#include <asynFloat64ArraySyncIO.h>
+
+#include <nds3/nds3.h>
+#include <nds3/impl/epicsFactoryImpl.h>
+#include <nds3/impl/epicsLatencyHistogram.h>
+
+extern "C" int ndsBench_registerRecordDeviceDriver(DBBASE* pDatabase);
+
+namespace
+{
+
+typedef std::map<std::string, std::string> benchParameters_t;
+
+/*
+ * Retrieve a numeric parameter from the command line
+ *
+ ****************************************************/
+size_t getParameter(const benchParameters_t& parameters, const std::string& name, size_t defaultValue)
+{
+    benchParameters_t::const_iterator findParameter = parameters.find(name);
+    if(findParameter == parameters.end())
+    {
+        return defaultValue;
+    }
+    std::istringstream parameterStream(findParameter->second);
+    size_t value;
+    parameterStream >> value;
+    if(parameterStream.fail())
+    {
+        throw std::runtime_error("Invalid value for parameter " + name);
+    }
+    return value;
+}
+
+/*
+ * Retrieve a string parameter from the command line
+ *
+ ***************************************************/
+std::string getParameter(const benchParameters_t& parameters, const std::string& name, const std::string& defaultValue)
+{
+    benchParameters_t::const_iterator findParameter = parameters.find(name);
+    if(findParameter == parameters.end())
+    {
+        return defaultValue;
+    }
+    return findParameter->second;
+}
+
+double secondsBetween(const timespec& start, const timespec& end)
+{
+    return (double)(end.tv_sec - start.tv_sec) + (double)(end.tv_nsec - start.tv_nsec) / 1.0e9;
+}
+
+/*
+ * Allocations made through operator new by all the threads, counted by the
+ *  replacement of operator new at the end of the file
+ *
+ ***************************************************************************/
+std::atomic<std::uint64_t> allocations(0);
+
+const double asynTimeout(1.0);
+
+/*
+ * Interrupt callbacks of the additional subscribers: count the calls
+ *
+ ********************************************************************/
+template<typename T>
+void countCallback(void* userPvt, asynUser* /* pasynUser */, T /* value */)
+{
+    ((std::atomic<std::uint64_t>*)userPvt)->fetch_add(1, std::memory_order_relaxed);
+}
+
+template<typename T>
+void countArrayCallback(void* userPvt, asynUser* /* pasynUser */, T* /* pValue */, size_t /* numElements */)
+{
+    ((std::atomic<std::uint64_t>*)userPvt)->fetch_add(1, std::memory_order_relaxed);
+}
+
+/*
+ * Register an interrupt client on the asyn interface of a connected asynUser
+ *
+ ****************************************************************************/
+template<typename interface_t, typename callback_t>
+asynStatus registerInterruptUser(asynUser* pUser, const char* interfaceType, callback_t callback, void* userPvt)
+{
+    asynInterface* pInterface(pasynManager->findInterface(pUser, interfaceType, 1));
+    if(pInterface == 0)
+    {
+        return asynError;
+    }
+    void* registrarPvt;
+    return ((interface_t*)pInterface->pinterface)->registerInterruptUser(pInterface->drvPvt, pUser, callback, userPvt, &registrarPvt);
+}
+
+/*
+ * Access to the asyn interface of each benchmarked type
+ *
+ *******************************************************/
+template<typename T>
+struct benchTraits_t;
+
+template<>
+struct benchTraits_t<std::int32_t>
+{
+    static const bool isArray = false;
+
+    static void fillValue(std::int32_t* pValue, size_t /* arraySize */)
+    {
+        *pValue = 0;
+    }
+
+    static asynStatus connect(const std::string& portName, const std::string& drvInfo, asynUser** ppUser)
+    {
+        return pasynInt32SyncIO->connect(portName.c_str(), 0, ppUser, drvInfo.c_str());
+    }
+
+    static asynStatus read(asynUser* pUser, std::int32_t* pValue)
+    {
+        return pasynInt32SyncIO->read(pUser, (epicsInt32*)pValue, asynTimeout);
+    }
+
+    static asynStatus write(asynUser* pUser, std::int32_t* pValue)
+    {
+        return pasynInt32SyncIO->write(pUser, (epicsInt32)*pValue, asynTimeout);
+    }
+
+    static asynStatus subscribe(asynUser* pUser, std::atomic<std::uint64_t>* pCallbacks)
+    {
+        return registerInterruptUser<asynInt32>(pUser, asynInt32Type, &countCallback<epicsInt32>, pCallbacks);
+    }
+};
+
+template<>
+struct benchTraits_t<double>
+{
+    static const bool isArray = false;
+
+    static void fillValue(double* pValue, size_t /* arraySize */)
+    {
+        *pValue = 0;
+    }
+
+    static asynStatus connect(const std::string& portName, const std::string& drvInfo, asynUser** ppUser)
+    {
+        return pasynFloat64SyncIO->connect(portName.c_str(), 0, ppUser, drvInfo.c_str());
+    }
+
+    static asynStatus read(asynUser* pUser, double* pValue)
+    {
+        return pasynFloat64SyncIO->read(pUser, pValue, asynTimeout);
+    }
+
+    static asynStatus write(asynUser* pUser, double* pValue)
+    {
+        return pasynFloat64SyncIO->write(pUser, *pValue, asynTimeout);
+    }
+
+    static asynStatus subscribe(asynUser* pUser, std::atomic<std::uint64_t>* pCallbacks)
+    {
+        return registerInterruptUser<asynFloat64>(pUser, asynFloat64Type, &countCallback<epicsFloat64>, pCallbacks);
+    }
+};
+
+template<>
+struct benchTraits_t<std::vector<std::int32_t> >
+{
+    static const bool isArray = true;
+
+    static void fillValue(std::vector<std::int32_t>* pValue, size_t arraySize)
+    {
+        pValue->resize(arraySize);
+    }
+
+    static asynStatus connect(const std::string& portName, const std::string& drvInfo, asynUser** ppUser)
+    {
+        return pasynInt32ArraySyncIO->connect(portName.c_str(), 0, ppUser, drvInfo.c_str());
+    }
+
+    static asynStatus read(asynUser* pUser, std::vector<std::int32_t>* pValue)
+    {
+        size_t numElements;
+        return pasynInt32ArraySyncIO->read(pUser, (epicsInt32*)pValue->data(), pValue->size(), &numElements, asynTimeout);
+    }
+
+    static asynStatus write(asynUser* pUser, std::vector<std::int32_t>* pValue)
+    {
+        return pasynInt32ArraySyncIO->write(pUser, (epicsInt32*)pValue->data(), pValue->size(), asynTimeout);
+    }
+
+    static asynStatus subscribe(asynUser* pUser, std::atomic<std::uint64_t>* pCallbacks)
+    {
+        return registerInterruptUser<asynInt32Array>(pUser, asynInt32ArrayType, &countArrayCallback<epicsInt32>, pCallbacks);
+    }
+};
+
+template<>
+struct benchTraits_t<std::vector<double> >
+{
+    static const bool isArray = true;
+
+    static void fillValue(std::vector<double>* pValue, size_t arraySize)
+    {
+        pValue->resize(arraySize);
+    }
+
+    static asynStatus connect(const std::string& portName, const std::string& drvInfo, asynUser** ppUser)
+    {
+        return pasynFloat64ArraySyncIO->connect(portName.c_str(), 0, ppUser, drvInfo.c_str());
+    }
+
+    static asynStatus read(asynUser* pUser, std::vector<double>* pValue)
+    {
+        size_t numElements;
+        return pasynFloat64ArraySyncIO->read(pUser, pValue->data(), pValue->size(), &numElements, asynTimeout);
+    }
+
+    static asynStatus write(asynUser* pUser, std::vector<double>* pValue)
+    {
+        return pasynFloat64ArraySyncIO->write(pUser, pValue->data(), pValue->size(), asynTimeout);
+    }
+
+    static asynStatus subscribe(asynUser* pUser, std::atomic<std::uint64_t>* pCallbacks)
+    {
+        return registerInterruptUser<asynFloat64Array>(pUser, asynFloat64ArrayType, &countArrayCallback<epicsFloat64>, pCallbacks);
+    }
+};
+
+/*
+ * Result of runOperations()
+ *
+ ***************************/
+struct benchResult_t
+{
+    double m_seconds;
+    std::uint64_t m_allocations;
+    nds::latencySummary_t m_latency;
+};
+
+/*
+ * Execute the operations from the producer threads and measure each of them.
+ *  Thread t executes the operations t, t + numThreads, t + 2 * numThreads...
+ *
+ ****************************************************************************/
+template<typename operation_t>
+benchResult_t runOperations(size_t numThreads, size_t numOperations, operation_t operation)
+{
+    std::vector<std::unique_ptr<nds::EpicsLatencyHistogram> > latencies;
+    for(size_t threadNumber(0); threadNumber != numThreads; ++threadNumber)
+    {
+        latencies.push_back(std::unique_ptr<nds::EpicsLatencyHistogram>(new nds::EpicsLatencyHistogram));
+    }
+
+    std::atomic<bool> startFlag(false);
+    std::vector<std::thread> threads;
+    for(size_t threadNumber(0); threadNumber != numThreads; ++threadNumber)
+    {
+        threads.push_back(std::thread([&startFlag, &latencies, &operation, threadNumber, numThreads, numOperations]()
+        {
+            while(!startFlag.load(std::memory_order_acquire))
+            {
+            }
+
+            nds::EpicsLatencyHistogram& latency(*latencies[threadNumber]);
+            for(size_t operationNumber(threadNumber); operationNumber < numOperations; operationNumber += numThreads)
+            {
+                timespec before, after;
+                clock_gettime(CLOCK_MONOTONIC, &before);
+                operation(threadNumber, operationNumber);
+                clock_gettime(CLOCK_MONOTONIC, &after);
+                latency.record((std::uint64_t)((after.tv_sec - before.tv_sec) * 1000000000LL + (after.tv_nsec - before.tv_nsec)));
+            }
+        }));
+    }
+
+    // The threads are waiting for the flag: from here on count the time and
+    //  the allocations
+    benchResult_t result;
+    timespec start, end;
+    std::uint64_t allocationsBefore(allocations.load(std::memory_order_relaxed));
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    startFlag.store(true, std::memory_order_release);
+    for(std::vector<std::thread>::iterator scanThreads(threads.begin()), endThreads(threads.end()); scanThreads != endThreads; ++scanThreads)
+    {
+        scanThreads->join();
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    result.m_allocations = allocations.load(std::memory_order_relaxed) - allocationsBefore;
+    result.m_seconds = secondsBetween(start, end);
+
+    for(size_t threadNumber(1); threadNumber != numThreads; ++threadNumber)
+    {
+        latencies[0]->merge(*latencies[threadNumber]);
+    }
+    latencies[0]->getSummary(&result.m_latency);
+
+    return result;
+}
+
+/*
+ * Push, read and write benchmarks: measure the throughput, the latency and
+ *  the allocations of the operations on the PVs of a port
+ *
+ **************************************************************************/
+template<typename T>
+void benchOperations(nds::Factory& factory, const std::string& mode, const std::string& typeName, const benchParameters_t& parameters)
+{
+    typedef benchTraits_t<T> traits_t;
+
+    const size_t numPVs(getParameter(parameters, "pvs", (size_t)1000));
+    const size_t numOperations(getParameter(parameters, "operations", (size_t)(mode == "push" ? 1000000 : 100000)));
+    const size_t numThreads(getParameter(parameters, "threads", (size_t)1));
+    const size_t numSubscribers(getParameter(parameters, "subscribers", (size_t)0));
+    const size_t arraySize(traits_t::isArray ? getParameter(parameters, "size", (size_t)1024) : 1);
+    const std::string scan(getParameter(parameters, "scan", std::string("passive")));
+
+    if(numPVs == 0 || numThreads == 0)
+    {
+        throw std::runtime_error("The number of PVs and of threads must be greater than zero");
+    }
+    if(mode != "push" && (numSubscribers != 0 || scan != "passive"))
+    {
+        throw std::runtime_error("The subscribers and the scan type apply only to the push benchmark");
+    }
+
+    nds::Port port("BENCH");
+
+    std::vector<nds::PVDelegateIn<T> > inputPVs;
+    std::vector<nds::PVDelegateOut<T> > outputPVs;
+    std::vector<std::string> pvNames;
+    for(size_t pvNumber(0); pvNumber != numPVs; ++pvNumber)
+    {
+        std::ostringstream pvName;
+        pvName << typeName << "-" << pvNumber;
+
+        if(mode == "write")
+        {
+            nds::PVDelegateOut<T> pv(pvName.str(),
+                                     [](const timespec& /* timestamp */, const T& /* value */)
+            {
+            },
+                                     [arraySize](timespec* pTimestamp, T* pValue)
+            {
+                clock_gettime(CLOCK_REALTIME, pTimestamp);
+                traits_t::fillValue(pValue, arraySize);
+            });
+            if(traits_t::isArray)
+            {
+                pv.setMaxElements(arraySize);
+            }
+            outputPVs.push_back(port.addChild(pv));
+        }
+        else
+        {
+            nds::PVDelegateIn<T> pv(pvName.str(), [arraySize](timespec* pTimestamp, T* pValue)
+            {
+                clock_gettime(CLOCK_REALTIME, pTimestamp);
+                traits_t::fillValue(pValue, arraySize);
+            });
+            if(traits_t::isArray)
+            {
+                pv.setMaxElements(arraySize);
+            }
+            if(scan == "intr")
+            {
+                pv.setScanType(nds::scanType_t::interrupt);
+            }
+            inputPVs.push_back(port.addChild(pv));
+        }
+    }
+
+    port.initialize(0, factory);
+
+    iocInit();
+
+    // The names used by the records to find the PVs on the asyn port
+    for(size_t pvNumber(0); pvNumber != numPVs; ++pvNumber)
+    {
+        pvNames.push_back(mode == "write" ? outputPVs[pvNumber].getFullNameFromPort() : inputPVs[pvNumber].getFullNameFromPort());
+    }
+
+    // Each thread uses its own asynUsers and its own value
+    std::vector<std::vector<asynUser*> > users(numThreads);
+    if(mode != "push")
+    {
+        for(size_t threadNumber(0); threadNumber != numThreads; ++threadNumber)
+        {
+            users[threadNumber].resize(numPVs);
+            for(size_t pvNumber(0); pvNumber != numPVs; ++pvNumber)
+            {
+                if(traits_t::connect(port.getFullName(), pvNames[pvNumber], &users[threadNumber][pvNumber]) != asynSuccess)
+                {
+                    throw std::runtime_error("Cannot connect to the PV " + pvNames[pvNumber]);
+                }
+            }
+        }
+    }
+
+    std::vector<T> values(numThreads);
+    for(size_t threadNumber(0); threadNumber != numThreads; ++threadNumber)
+    {
+        traits_t::fillValue(&values[threadNumber], arraySize);
+    }
+
+    std::atomic<std::uint64_t> callbacks(0);
+    for(size_t pvNumber(0); pvNumber != numPVs && mode == "push"; ++pvNumber)
+    {
+        for(size_t subscriberNumber(0); subscriberNumber != numSubscribers; ++subscriberNumber)
+        {
+            asynUser* pUser;
+            if(traits_t::connect(port.getFullName(), pvNames[pvNumber], &pUser) != asynSuccess ||
+               traits_t::subscribe(pUser, &callbacks) != asynSuccess)
+            {
+                throw std::runtime_error("Cannot subscribe to the PV " + pvNames[pvNumber]);
+            }
+        }
+    }
+
+    std::atomic<std::uint64_t> errors(0);
+    benchResult_t result;
+    if(mode == "push")
+    {
+        timespec timestamp;
+        clock_gettime(CLOCK_REALTIME, &timestamp);
+
+        result = runOperations(numThreads, numOperations, [&inputPVs, &values, &timestamp, numPVs](size_t threadNumber, size_t operationNumber)
+        {
+            inputPVs[operationNumber % numPVs].push(timestamp, values[threadNumber]);
+        });
+    }
+    else
+    {
+        const bool write(mode == "write");
+        result = runOperations(numThreads, numOperations, [&users, &values, &errors, numPVs, write](size_t threadNumber, size_t operationNumber)
+        {
+            asynUser* pUser(users[threadNumber][operationNumber % numPVs]);
+            asynStatus status(write ? traits_t::write(pUser, &values[threadNumber]) : traits_t::read(pUser, &values[threadNumber]));
+            if(status != asynSuccess)
+            {
+                errors.fetch_add(1, std::memory_order_relaxed);
+            }
+        });
+    }
+
+    printf("%s: %zu %s PVs", mode.c_str(), numPVs, typeName.c_str());
+    if(traits_t::isArray)
+    {
+        printf(" of %zu elements", arraySize);
+    }
+    if(mode == "push")
+    {
+        printf(" (scan %s, %zu subscribers)", scan.c_str(), numSubscribers);
+    }
+    printf(", %zu threads, %zu operations in %.3f s\n", numThreads, numOperations, result.m_seconds);
+    printf("%s: %.0f operations/s, latency p50 %.2f us, p99 %.2f us, max %.1f us, %.2f allocations/operation\n",
+           mode.c_str(),
+           (double)numOperations / result.m_seconds,
+           (double)result.m_latency.m_p50Nanoseconds / 1000.0,
+           (double)result.m_latency.m_p99Nanoseconds / 1000.0,
+           (double)result.m_latency.m_maxNanoseconds / 1000.0,
+           (double)result.m_allocations / (double)numOperations);
+    if(numSubscribers != 0)
+    {
+        printf("%s: %llu callbacks to the additional subscribers\n", mode.c_str(), (unsigned long long)callbacks.load());
+    }
+    if(errors.load() != 0)
+    {
+        printf("%s: %llu operations failed\n", mode.c_str(), (unsigned long long)errors.load());
+    }
+}
+
+/*
+ * Select the type of the PVs of the push, read and write benchmarks
+ *
+ *******************************************************************/
+void benchOperations(nds::Factory& factory, const std::string& mode, const benchParameters_t& parameters)
+{
+    const std::string typeName(getParameter(parameters, "type", std::string("int32")));
+    if(typeName == "int32")
+    {
+        benchOperations<std::int32_t>(factory, mode, typeName, parameters);
+    }
+    else if(typeName == "float64")
+    {
+        benchOperations<double>(factory, mode, typeName, parameters);
+    }
+    else if(typeName == "int32Array")
+    {
+        benchOperations<std::vector<std::int32_t> >(factory, mode, typeName, parameters);
+    }
+    else if(typeName == "float64Array")
+    {
+        benchOperations<std::vector<double> >(factory, mode, typeName, parameters);
+    }
+    else
+    {
+        throw std::runtime_error("Unknown type " + typeName + ": use int32, float64, int32Array or float64Array");
+    }
+}
+
+
+/*
+ * Startup benchmark: measures the creation of the records and iocInit
+ *
+ *********************************************************************/
+void benchStartup(nds::Factory& factory, const benchParameters_t& parameters)
+{
+    const size_t numPVs(getParameter(parameters, "pvs", (size_t)10000));
+
+    timespec start, declared, initialized, started;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    nds::Port port("BENCH");
+    for(size_t pvNumber(0); pvNumber != numPVs; ++pvNumber)
+    {
+        std::ostringstream pvName;
+        pvName << "Int32-" << pvNumber;
+        port.addChild(nds::PVDelegateIn<std::int32_t>(pvName.str(), [](timespec* pTimestamp, std::int32_t* pValue)
+        {
+            clock_gettime(CLOCK_REALTIME, pTimestamp);
+            *pValue = 0;
+        }));
+    }
+    clock_gettime(CLOCK_MONOTONIC, &declared);
+
+    // Registers the PVs and creates their records
+    port.initialize(0, factory);
+    clock_gettime(CLOCK_MONOTONIC, &initialized);
+
+    iocInit();
+    clock_gettime(CLOCK_MONOTONIC, &started);
+
+    printf("startup: %zu PVs: declaration %.3f s, records %.3f s, iocInit %.3f s, total %.3f s\n",
+           numPVs,
+           secondsBetween(start, declared),
+           secondsBetween(declared, initialized),
+           secondsBetween(initialized, started),
+           secondsBetween(start, started));
+}
+
+
+
+/*
+ * Jitter benchmark: measures how late a periodic thread wakes up
+ *
+ ****************************************************************/
+void benchJitter(nds::Factory& factory, const benchParameters_t& parameters)
+{
+    const size_t periodMicroseconds(getParameter(parameters, "period", (size_t)1000));
+    const size_t numSamples(getParameter(parameters, "samples", (size_t)10000));
+    const std::string policy(getParameter(parameters, "policy", std::string("other")));
+    const std::string cpus(getParameter(parameters, "cpus", std::string()));
+
+    if(periodMicroseconds == 0 || numSamples == 0)
+    {
+        throw std::runtime_error("The period and the number of samples must be greater than zero");
+    }
+
+    nds::threadPolicySettings_t settings;
+    settings.m_priority = (unsigned int)getParameter(parameters, "priority", (size_t)epicsThreadPriorityMedium);
+    settings.m_policy = nds::parseSchedulingPolicy(policy);
+    if(!cpus.empty())
+    {
+        settings.m_cpus = nds::parseCpuList(cpus);
+    }
+    nds::EpicsFactoryImpl::addThreadPolicy("*ndsJitter", settings);
+
+    nds::Port port("BENCH");
+    port.initialize(0, factory);
+
+    iocInit();
+
+    // Latencies in microseconds
+    std::vector<double> latencies(numSamples);
+
+    nds::Thread thread(port.runInThread("ndsJitter", [&latencies, periodMicroseconds]()
+    {
+        timespec wakeUp;
+        clock_gettime(CLOCK_MONOTONIC, &wakeUp);
+        for(std::vector<double>::iterator scanLatencies(latencies.begin()), endLatencies(latencies.end());
+            scanLatencies != endLatencies;
+            ++scanLatencies)
+        {
+            wakeUp.tv_nsec += (long)(periodMicroseconds * 1000);
+            wakeUp.tv_sec += wakeUp.tv_nsec / 1000000000;
+            wakeUp.tv_nsec %= 1000000000;
+            clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &wakeUp, 0);
+
+            timespec now;
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            *scanLatencies = secondsBetween(wakeUp, now) * 1.0e6;
+        }
+    }));
+    thread.join();
+
+    double totalLatency(0);
+    for(std::vector<double>::const_iterator scanLatencies(latencies.begin()), endLatencies(latencies.end());
+        scanLatencies != endLatencies;
+        ++scanLatencies)
+    {
+        totalLatency += *scanLatencies;
+    }
+    std::sort(latencies.begin(), latencies.end());
+
+    printf("jitter: %zu samples, period %zu us, priority %u, policy %s, cpus %s\n",
+           numSamples, periodMicroseconds, settings.m_priority, policy.c_str(), cpus.empty() ? "all" : cpus.c_str());
+    printf("jitter: latency min %.1f us, avg %.1f us, p50 %.1f us, p99 %.1f us, p99.9 %.1f us, max %.1f us\n",
+           latencies.front(),
+           totalLatency / (double)numSamples,
+           latencies[numSamples / 2],
+           latencies[numSamples * 99 / 100],
+           latencies[numSamples * 999 / 1000],
+           latencies.back());
+}
+
+}
+
+/*
+ * Count the allocations made by the benchmarked code
+ *
+ ****************************************************/
+void* operator new(std::size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    void* pMemory(std::malloc(size == 0 ? 1 : size));
+    if(pMemory == 0)
+    {
+        throw std::bad_alloc();
+    }
+    return pMemory;
+}
+
+void operator delete(void* pMemory) noexcept
+{
+    std::free(pMemory);
+}
+
+int main(int argc, char* argv[])
+{
+    if(argc < 2)
+    {
+        printf("Usage: %s mode [name=value ...]\n", argv[0]);
+        printf("Modes:\n");
+        printf("  push [pvs=1000] [operations=1000000] [type=int32|float64|int32Array|float64Array] [size=1024]\n");
+        printf("       [threads=1] [scan=passive|intr] [subscribers=0]\n");
+        printf("  read|write [pvs=1000] [operations=100000] [type=int32|float64|int32Array|float64Array] [size=1024]\n");
+        printf("       [threads=1]\n");
+        printf("  startup [pvs=10000]\n");
+        printf("  jitter [period=1000] [samples=10000] [priority=50] [policy=other|fifo|rr] [cpus=list]\n");
+        return 1;
+    }
+
+    std::string mode(argv[1]);
+    benchParameters_t parameters;
+    for(int argument(2); argument < argc; ++argument)
+    {
+        std::string nameValue(argv[argument]);
+        size_t equalPosition = nameValue.find('=');
+        if(equalPosition == nameValue.npos)
+        {
+            printf("Parameters must be in the form name=value: %s\n", argv[argument]);
+            return 1;
+        }
+        parameters[nameValue.substr(0, equalPosition)] = nameValue.substr(equalPosition + 1);
+    }
+
+    // The dbd file is installed in <top>/dbd, the executable in <top>/bin/<arch>
+    std::string dbdFileName(argv[0]);
+    size_t slashPosition = dbdFileName.rfind('/');
+    if(slashPosition == std::string::npos)
+    {
+        dbdFileName.clear();
+    }
+    else
+    {
+        dbdFileName.erase(++slashPosition);
+    }
+    dbdFileName += "../../dbd/ndsBench.dbd";
+
+    if(dbLoadDatabase(dbdFileName.c_str(), 0, 0) != 0)
+    {
+        printf("Cannot load %s\n", dbdFileName.c_str());
+        return 1;
+    }
+    ndsBench_registerRecordDeviceDriver(pdbbase);
+
+    try
+    {
+        nds::Factory factory("epics");
+
+        if(mode == "push" || mode == "read" || mode == "write")
+        {
+            benchOperations(factory, mode, parameters);
+        }
+        else if(mode == "startup")
+        {
+            benchStartup(factory, parameters);
+        }
+        else if(mode == "jitter")
+        {
+            benchJitter(factory, parameters);
+        }
+        else
+        {
+            printf("Unknown mode %s\n", mode.c_str());
+            return 1;
+        }
+    }
+    catch(const std::runtime_error& e)
+    {
+        printf("%s\n", e.what());
+        return 1;
+    }
+
+    epicsExit(0);
+    return 0;
+}
@@ -0,0 +1,20 @@
+#!../../bin/linux-x86_64/demo
+
+## Soak and scaling test: the load generator serves 10000 scalar PVs and
+## 100 arrays of 16384 elements pushed 10 times per second by 4 threads.
+## See doc/load_generator.md
+
+< envPaths
+
+## Register all support components
+dbLoadDatabase("../../dbd/demo.dbd",0,0)
+demo_registerRecordDeviceDriver(pdbbase) 
+
+## Keep the push and status loops on dedicated threads named after them
+ndsSetThreadPolicy("loadPush*")
+ndsSetThreadPolicy("loadStatus")
+
+ndsLoadDriver("${TOP}/lib/linux-x86_64/libndsLoadGenerator.so")
+ndsCreateDevice(loadGenerator, "LOAD", "scalars=10000", "arrays=100", "arraySize=16384", "rate=10", "threads=4")
+
+iocInit()
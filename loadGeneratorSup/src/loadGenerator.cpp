@@ -0,0 +1,437 @@
+/*
+ * EPICS support for NDS3
+ *
+ * Copyright (c) 2015 Cosylab d.d.
+ *
+ * For more information about the license please refer to the license.txt
+ * file included in the distribution.
+ */
+
+/**
+ * @file loadGenerator.cpp
+ *
+ * Synthetic NDS device used to load an IOC with many PVs and a high data
+ *  rate, see doc/load_generator.md.
+ *
+ */
+
+#include <ctime>
+#include <functional>
+#include <sstream>
+#include <stdexcept>
+#include <algorithm>
+
+#include "loadGenerator.h"
+
+namespace nds
+{
+
+/*
+ * Retrieve the parameters passed to ndsCreateDevice
+ *
+ ***************************************************/
+static std::string getParameter(const namedParameters_t& parameters, const std::string& name, const std::string& defaultValue)
+{
+    namedParameters_t::const_iterator findParameter = parameters.find(name);
+    if(findParameter == parameters.end())
+    {
+        return defaultValue;
+    }
+    return findParameter->second;
+}
+
+static double getNumericParameter(const namedParameters_t& parameters, const std::string& name, double defaultValue)
+{
+    namedParameters_t::const_iterator findParameter = parameters.find(name);
+    if(findParameter == parameters.end())
+    {
+        return defaultValue;
+    }
+    std::istringstream parameterStream(findParameter->second);
+    double value;
+    parameterStream >> value;
+    if(parameterStream.fail() || value < 0)
+    {
+        throw std::runtime_error("The parameter " + name + " of the load generator must be a positive number");
+    }
+    return value;
+}
+
+static void addNanoseconds(timespec* pTime, std::int64_t nanoseconds)
+{
+    std::int64_t totalNanoseconds((std::int64_t)pTime->tv_nsec + nanoseconds);
+    pTime->tv_sec += (time_t)(totalNanoseconds / 1000000000);
+    pTime->tv_nsec = (long)(totalNanoseconds % 1000000000);
+}
+
+static std::int64_t nanosecondsBetween(const timespec& start, const timespec& end)
+{
+    return (std::int64_t)(end.tv_sec - start.tv_sec) * 1000000000 + (end.tv_nsec - start.tv_nsec);
+}
+
+
+/*
+ * A generated PV, pushed by one of the push threads
+ *
+ ***************************************************/
+class LoadGeneratorPV
+{
+public:
+    virtual ~LoadGeneratorPV()
+    {
+    }
+
+    /**
+     * @brief Push a generated value.
+     *
+     * @param timestamp the timestamp of the value
+     * @param counter   incremented by the push thread at each period
+     * @return the number of bytes pushed
+     */
+    virtual size_t push(const timespec& timestamp, std::uint64_t counter) = 0;
+};
+
+
+template<typename T>
+class LoadGeneratorScalarPV: public LoadGeneratorPV
+{
+public:
+    LoadGeneratorScalarPV(Port& root, const std::string& name, scanType_t scanType, double scanPeriodSeconds):
+        m_pv(root.addChild(PVDelegateIn<T>(name, [](timespec* pTimestamp, T* pValue)
+        {
+            clock_gettime(CLOCK_REALTIME, pTimestamp);
+            *pValue = (T)(pTimestamp->tv_nsec % 1000);
+        })))
+    {
+        m_pv.setScanType(scanType, scanPeriodSeconds);
+    }
+
+    virtual size_t push(const timespec& timestamp, std::uint64_t counter)
+    {
+        m_pv.push(timestamp, (T)(counter % 1000));
+        return sizeof(T);
+    }
+
+private:
+    PVDelegateIn<T> m_pv;
+};
+
+
+template<typename T>
+class LoadGeneratorArrayPV: public LoadGeneratorPV
+{
+public:
+    LoadGeneratorArrayPV(Port& root, const std::string& name, scanType_t scanType, double scanPeriodSeconds, size_t size):
+        m_pv(root.addChild(PVDelegateIn<std::vector<T> >(name, [size](timespec* pTimestamp, std::vector<T>* pValue)
+        {
+            clock_gettime(CLOCK_REALTIME, pTimestamp);
+            pValue->resize(size);
+            for(size_t scanElements(0); scanElements != size; ++scanElements)
+            {
+                (*pValue)[scanElements] = (T)(scanElements % 100);
+            }
+        }))),
+        m_value(size)
+    {
+        m_pv.setScanType(scanType, scanPeriodSeconds);
+        m_pv.setMaxElements(size);
+
+        for(size_t scanElements(0); scanElements != size; ++scanElements)
+        {
+            m_value[scanElements] = (T)(scanElements % 100);
+        }
+    }
+
+    virtual size_t push(const timespec& timestamp, std::uint64_t counter)
+    {
+        // Only the pushing thread accesses the value
+        if(!m_value.empty())
+        {
+            m_value[0] = (T)(counter % 100);
+        }
+        m_pv.push(timestamp, m_value);
+        return m_value.size() * sizeof(T);
+    }
+
+private:
+    PVDelegateIn<std::vector<T> > m_pv;
+    std::vector<T> m_value;
+};
+
+
+/*
+ * Constructor
+ *
+ *************/
+LoadGenerator::LoadGenerator(Factory& factory, const std::string& deviceName, const namedParameters_t& parameters):
+    m_root(deviceName),
+    m_numThreads((size_t)getNumericParameter(parameters, "threads", 1)),
+    m_rate(getNumericParameter(parameters, "rate", 10)),
+    m_push(true),
+    m_pushRatePV(m_root.addChild(PVDelegateIn<double>("PushRate", std::bind(&LoadGenerator::readPushRate, this, std::placeholders::_1, std::placeholders::_2)))),
+    m_dataRatePV(m_root.addChild(PVDelegateIn<double>("DataRate", std::bind(&LoadGenerator::readDataRate, this, std::placeholders::_1, std::placeholders::_2)))),
+    m_overrunsPV(m_root.addChild(PVDelegateIn<double>("Overruns", std::bind(&LoadGenerator::readOverruns, this, std::placeholders::_1, std::placeholders::_2)))),
+    m_enabled(true), m_stop(false), m_pushes(0), m_bytes(0), m_overruns(0), m_pushRate(0), m_dataRate(0)
+{
+    const size_t numScalars((size_t)getNumericParameter(parameters, "scalars", 100));
+    const size_t numArrays((size_t)getNumericParameter(parameters, "arrays", 10));
+    const size_t arraySize((size_t)getNumericParameter(parameters, "arraySize", 1024));
+    const std::string scalarType(getParameter(parameters, "scalarType", "float64"));
+    const std::string arrayType(getParameter(parameters, "arrayType", "float64Array"));
+    const std::string scan(getParameter(parameters, "scan", "intr"));
+
+    if(m_numThreads == 0)
+    {
+        throw std::runtime_error("The load generator needs at least one thread");
+    }
+
+    // With the periodic and passive scans the records read the PVs
+    scanType_t scanType(scanType_t::interrupt);
+    double scanPeriodSeconds(0);
+    if(scan == "periodic")
+    {
+        scanType = scanType_t::periodic;
+        m_push = false;
+    }
+    else if(scan == "passive")
+    {
+        scanType = scanType_t::passive;
+        m_push = false;
+    }
+    else if(scan != "intr")
+    {
+        throw std::runtime_error("The scan of the load generator must be intr, periodic or passive");
+    }
+    if(scan != "passive")
+    {
+        if(m_rate <= 0)
+        {
+            throw std::runtime_error("The rate of the load generator must be greater than zero");
+        }
+        scanPeriodSeconds = 1.0 / m_rate;
+    }
+
+    for(size_t pvNumber(0); pvNumber != numScalars; ++pvNumber)
+    {
+        std::ostringstream pvName;
+        pvName << "Scalar-" << pvNumber;
+        if(scalarType == "int32")
+        {
+            m_pvs.push_back(std::unique_ptr<LoadGeneratorPV>(new LoadGeneratorScalarPV<std::int32_t>(m_root, pvName.str(), scanType, scanPeriodSeconds)));
+        }
+        else if(scalarType == "float64")
+        {
+            m_pvs.push_back(std::unique_ptr<LoadGeneratorPV>(new LoadGeneratorScalarPV<double>(m_root, pvName.str(), scanType, scanPeriodSeconds)));
+        }
+        else
+        {
+            throw std::runtime_error("The scalarType of the load generator must be int32 or float64");
+        }
+    }
+
+    for(size_t pvNumber(0); pvNumber != numArrays; ++pvNumber)
+    {
+        std::ostringstream pvName;
+        pvName << "Array-" << pvNumber;
+        if(arrayType == "int8Array")
+        {
+            m_pvs.push_back(std::unique_ptr<LoadGeneratorPV>(new LoadGeneratorArrayPV<std::int8_t>(m_root, pvName.str(), scanType, scanPeriodSeconds, arraySize)));
+        }
+        else if(arrayType == "int32Array")
+        {
+            m_pvs.push_back(std::unique_ptr<LoadGeneratorPV>(new LoadGeneratorArrayPV<std::int32_t>(m_root, pvName.str(), scanType, scanPeriodSeconds, arraySize)));
+        }
+        else if(arrayType == "float64Array")
+        {
+            m_pvs.push_back(std::unique_ptr<LoadGeneratorPV>(new LoadGeneratorArrayPV<double>(m_root, pvName.str(), scanType, scanPeriodSeconds, arraySize)));
+        }
+        else
+        {
+            throw std::runtime_error("The arrayType of the load generator must be int8Array, int32Array or float64Array");
+        }
+    }
+
+    // Status PVs, updated every second
+    m_pushRatePV.setScanType(scanType_t::interrupt);
+    m_pushRatePV.setDescription("Values pushed per second");
+    m_dataRatePV.setScanType(scanType_t::interrupt);
+    m_dataRatePV.setDescription("Megabytes pushed per second");
+    m_overrunsPV.setScanType(scanType_t::interrupt);
+    m_overrunsPV.setDescription("Periods late because of the load");
+
+    m_root.addChild(PVDelegateOut<std::int32_t>("Enable",
+                                                std::bind(&LoadGenerator::writeEnable, this, std::placeholders::_1, std::placeholders::_2),
+                                                std::bind(&LoadGenerator::readEnable, this, std::placeholders::_1, std::placeholders::_2)));
+
+    m_root.initialize(this, factory);
+
+    ndsInfoStream(m_root) << "Load generator " << deviceName << ": " << numScalars << " " << scalarType << " PVs, "
+                          << numArrays << " " << arrayType << " PVs of " << arraySize << " elements, scan " << scan
+                          << ", rate " << m_rate << "/s, " << m_numThreads << " threads" << std::endl;
+
+    if(m_push)
+    {
+        for(size_t threadNumber(0); threadNumber != m_numThreads; ++threadNumber)
+        {
+            std::ostringstream threadName;
+            threadName << "loadPush" << threadNumber;
+            m_threads.push_back(m_root.runInThread(threadName.str(), std::bind(&LoadGenerator::pushLoop, this, threadNumber)));
+        }
+    }
+    m_threads.push_back(m_root.runInThread("loadStatus", std::bind(&LoadGenerator::statusLoop, this)));
+}
+
+
+/*
+ * Destructor
+ *
+ ************/
+LoadGenerator::~LoadGenerator()
+{
+    m_stop.store(true);
+    for(std::vector<Thread>::iterator scanThreads(m_threads.begin()), endThreads(m_threads.end()); scanThreads != endThreads; ++scanThreads)
+    {
+        scanThreads->join();
+    }
+}
+
+
+/*
+ * Sleep in steps of 100 ms, so the destructor doesn't wait for long periods
+ *
+ ***************************************************************************/
+bool LoadGenerator::waitUntil(const timespec& wakeUp) const
+{
+    for(;;)
+    {
+        if(m_stop.load())
+        {
+            return false;
+        }
+
+        timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        std::int64_t remainingNanoseconds(nanosecondsBetween(now, wakeUp));
+        if(remainingNanoseconds <= 0)
+        {
+            return true;
+        }
+
+        timespec sleepTime;
+        sleepTime.tv_sec = 0;
+        sleepTime.tv_nsec = (long)std::min(remainingNanoseconds, (std::int64_t)100000000);
+        nanosleep(&sleepTime, 0);
+    }
+}
+
+
+/*
+ * Push the PVs assigned to a thread at the configured rate
+ *
+ **********************************************************/
+void LoadGenerator::pushLoop(size_t threadNumber)
+{
+    const std::int64_t periodNanoseconds((std::int64_t)(1.0e9 / m_rate));
+
+    timespec wakeUp;
+    clock_gettime(CLOCK_MONOTONIC, &wakeUp);
+
+    for(std::uint64_t counter(0); waitUntil(wakeUp); ++counter)
+    {
+        if(m_enabled.load(std::memory_order_relaxed))
+        {
+            timespec timestamp;
+            clock_gettime(CLOCK_REALTIME, &timestamp);
+
+            size_t pushes(0);
+            size_t bytes(0);
+            for(size_t scanPVs(threadNumber), endPVs(m_pvs.size()); scanPVs < endPVs; scanPVs += m_numThreads)
+            {
+                bytes += m_pvs[scanPVs]->push(timestamp, counter);
+                ++pushes;
+            }
+            m_pushes.fetch_add(pushes, std::memory_order_relaxed);
+            m_bytes.fetch_add(bytes, std::memory_order_relaxed);
+        }
+
+        // When the pushes took longer than the period skip the missed
+        //  periods instead of pushing in bursts
+        addNanoseconds(&wakeUp, periodNanoseconds);
+        timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        if(nanosecondsBetween(wakeUp, now) > 0)
+        {
+            m_overruns.fetch_add(1, std::memory_order_relaxed);
+            wakeUp = now;
+        }
+    }
+}
+
+
+/*
+ * Measure the push and data rates every second
+ *
+ **********************************************/
+void LoadGenerator::statusLoop()
+{
+    std::uint64_t lastPushes(0);
+    std::uint64_t lastBytes(0);
+
+    timespec wakeUp;
+    clock_gettime(CLOCK_MONOTONIC, &wakeUp);
+    for(;;)
+    {
+        addNanoseconds(&wakeUp, 1000000000);
+        if(!waitUntil(wakeUp))
+        {
+            return;
+        }
+
+        std::uint64_t pushes(m_pushes.load(std::memory_order_relaxed));
+        std::uint64_t bytes(m_bytes.load(std::memory_order_relaxed));
+        m_pushRate.store((double)(pushes - lastPushes));
+        m_dataRate.store((double)(bytes - lastBytes) / 1.0e6);
+        lastPushes = pushes;
+        lastBytes = bytes;
+
+        timespec timestamp;
+        clock_gettime(CLOCK_REALTIME, &timestamp);
+        m_pushRatePV.push(timestamp, m_pushRate.load());
+        m_dataRatePV.push(timestamp, m_dataRate.load());
+        m_overrunsPV.push(timestamp, (double)m_overruns.load(std::memory_order_relaxed));
+    }
+}
+
+
+void LoadGenerator::writeEnable(const timespec& /* timestamp */, const std::int32_t& value)
+{
+    m_enabled.store(value != 0);
+}
+
+void LoadGenerator::readEnable(timespec* pTimestamp, std::int32_t* pValue)
+{
+    clock_gettime(CLOCK_REALTIME, pTimestamp);
+    *pValue = m_enabled.load() ? 1 : 0;
+}
+
+void LoadGenerator::readPushRate(timespec* pTimestamp, double* pValue)
+{
+    clock_gettime(CLOCK_REALTIME, pTimestamp);
+    *pValue = m_pushRate.load();
+}
+
+void LoadGenerator::readDataRate(timespec* pTimestamp, double* pValue)
+{
+    clock_gettime(CLOCK_REALTIME, pTimestamp);
+    *pValue = m_dataRate.load();
+}
+
+void LoadGenerator::readOverruns(timespec* pTimestamp, double* pValue)
+{
+    clock_gettime(CLOCK_REALTIME, pTimestamp);
+    *pValue = (double)m_overruns.load(std::memory_order_relaxed);
+}
+
+}
+
+NDS_DEFINE_DRIVER(loadGenerator, nds::LoadGenerator);
@@ -0,0 +1,92 @@
+/*
+ * EPICS support for NDS3
+ *
+ * Copyright (c) 2015 Cosylab d.d.
+ *
+ * For more information about the license please refer to the license.txt
+ * file included in the distribution.
+ */
+
+#ifndef NDSLOADGENERATOR_H
+#define NDSLOADGENERATOR_H
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include <nds3/nds3.h>
+
+namespace nds
+{
+
+class LoadGeneratorPV;
+
+/**
+ * @brief Synthetic device that creates a configurable number of scalar and
+ *        array PVs and pushes generated values to them.
+ *
+ * Used to reproduce the scale of a production IOC (number of PVs, data rate)
+ *  without hardware, for soak and scaling tests. The parameters are passed
+ *  to ndsCreateDevice as name=value pairs, see doc/load_generator.md:
+ *
+ * @code
+ * ndsCreateDevice(loadGenerator, "LOAD", "scalars=10000", "arrays=100", "arraySize=16384", "rate=10", "threads=4")
+ * @endcode
+ */
+class LoadGenerator
+{
+public:
+    LoadGenerator(nds::Factory& factory, const std::string& deviceName, const nds::namedParameters_t& parameters);
+    ~LoadGenerator();
+
+private:
+    /**
+     * @brief Sleep until the wake-up time, unless the device is destroyed.
+     *
+     * @param wakeUp the wake-up time (CLOCK_MONOTONIC)
+     * @return false if the device is being destroyed
+     */
+    bool waitUntil(const timespec& wakeUp) const;
+
+    void pushLoop(size_t threadNumber);
+
+    void statusLoop();
+
+    void writeEnable(const timespec& timestamp, const std::int32_t& value);
+
+    void readEnable(timespec* pTimestamp, std::int32_t* pValue);
+
+    void readPushRate(timespec* pTimestamp, double* pValue);
+
+    void readDataRate(timespec* pTimestamp, double* pValue);
+
+    void readOverruns(timespec* pTimestamp, double* pValue);
+
+    nds::Port m_root;
+
+    std::vector<std::unique_ptr<LoadGeneratorPV> > m_pvs; ///< The generated PVs, pushed by the thread number (index % m_numThreads)
+
+    size_t m_numThreads;
+    double m_rate;          ///< Pushes per second on each PV, or scans per second with the periodic scan
+    bool m_push;            ///< False if the records read the PVs (passive and periodic scans)
+
+    nds::PVDelegateIn<double> m_pushRatePV;
+    nds::PVDelegateIn<double> m_dataRatePV;
+    nds::PVDelegateIn<double> m_overrunsPV;
+
+    std::atomic<bool> m_enabled;           ///< Set by the Enable PV
+    std::atomic<bool> m_stop;              ///< Set by the destructor
+    std::atomic<std::uint64_t> m_pushes;   ///< Values pushed since the creation
+    std::atomic<std::uint64_t> m_bytes;    ///< Bytes pushed since the creation
+    std::atomic<std::uint64_t> m_overruns; ///< Periods in which a thread could not push all its PVs in time
+    std::atomic<double> m_pushRate;        ///< Pushes per second, measured by the status thread
+    std::atomic<double> m_dataRate;        ///< Megabytes per second, measured by the status thread
+
+    std::vector<nds::Thread> m_threads;
+};
+
+}
+
+#endif // NDSLOADGENERATOR_H
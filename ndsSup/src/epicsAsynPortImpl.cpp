@@ -0,0 +1,202 @@
+/*
+ * EPICS support for NDS3
+ *
+ * Copyright (c) 2015 Cosylab d.d.
+ *
+ * For more information about the license please refer to the license.txt
+ * file included in the distribution.
+ */
+
+/**
+ * @file epicsAsynPortImpl.cpp
+ *
+ * Contains the asyn ports created by the EPICS layer.
+ *
+ */
+
+#include "nds3/impl/epicsAsynPortImpl.h"
+#include "nds3/impl/epicsInterfaceImpl.h"
+
+namespace nds
+{
+
+/*
+ * Constructor
+ *
+ *************/
+#ifdef NDS3_EXTENDED_DATA_TYPES
+static const int extendedTypesMask(asynInt16ArrayMask | asynFloat32ArrayMask | asynInt64Mask | asynInt64ArrayMask);
+#else
+static const int extendedTypesMask(0);
+#endif
+
+EpicsAsynPortImpl::EpicsAsynPortImpl(const std::string& portName, int asynFlags, const threadPolicySettings_t& threadPolicy):
+    asynPortDriver(
+        portName.c_str(),
+        0,    /* maxAddr */
+        0,
+        //asynCommonMask |
+        asynDrvUserMask |
+        //asynOptionMask |
+        asynInt32Mask |
+        // asynUInt32DigitalMask |
+        asynFloat64Mask  |
+        //asynOctetMask |
+        asynInt8ArrayMask |
+        asynInt32ArrayMask |
+        asynFloat64ArrayMask |
+        asynGenericPointerMask |
+        extendedTypesMask           /* Interface mask */
+        ,
+        asynInt32Mask |
+        // asynUInt32DigitalMask |
+        asynFloat64Mask |
+        //asynOctetMask |
+        asynInt8ArrayMask |
+        asynInt32ArrayMask |
+        asynFloat64ArrayMask |
+        asynGenericPointerMask |
+        extendedTypesMask                    /* Interrupt mask */
+        , asynFlags | ASYN_MULTIDEVICE,      /* asynFlags. */
+        1,                                 /* Autoconnect */
+        threadPolicy.m_priority,           /* Priority of the port's thread */
+        (int)threadPolicy.m_stackSize)     /* Stack size, 0 for the default */
+{
+}
+
+
+/*
+ * Constructor
+ *
+ *************/
+EpicsShardPortImpl::EpicsShardPortImpl(const std::string& portName, EpicsInterfaceImpl* pOwner, int asynFlags,
+                                       const threadPolicySettings_t& threadPolicy):
+    EpicsAsynPortImpl(portName, asynFlags, threadPolicy), m_pOwner(pOwner)
+{
+    // The interrupt clients of the shard are indexed by the owner, which
+    //  delivers the pushed values
+    m_pOwner->installInterruptHooks(&asynStdInterfaces);
+}
+
+
+EpicsInterfaceImpl* EpicsShardPortImpl::getInterfaceImpl()
+{
+    return m_pOwner;
+}
+
+
+/*
+ * Forward the requests to the owner
+ *
+ ***********************************/
+asynStatus EpicsShardPortImpl::readInt32(asynUser *pasynUser, epicsInt32 *value)
+{
+    return m_pOwner->readInt32(pasynUser, value);
+}
+
+asynStatus EpicsShardPortImpl::writeInt32(asynUser *pasynUser, epicsInt32 value)
+{
+    return m_pOwner->writeInt32(pasynUser, value);
+}
+
+asynStatus EpicsShardPortImpl::readFloat64(asynUser *pasynUser, epicsFloat64 *value)
+{
+    return m_pOwner->readFloat64(pasynUser, value);
+}
+
+asynStatus EpicsShardPortImpl::writeFloat64(asynUser *pasynUser, epicsFloat64 value)
+{
+    return m_pOwner->writeFloat64(pasynUser, value);
+}
+
+asynStatus EpicsShardPortImpl::readInt8Array(asynUser *pasynUser, epicsInt8* pValue, size_t nElements, size_t *nIn)
+{
+    return m_pOwner->readInt8Array(pasynUser, pValue, nElements, nIn);
+}
+
+asynStatus EpicsShardPortImpl::writeInt8Array(asynUser *pasynUser, epicsInt8* pValue, size_t nElements)
+{
+    return m_pOwner->writeInt8Array(pasynUser, pValue, nElements);
+}
+
+asynStatus EpicsShardPortImpl::readFloat64Array(asynUser *pasynUser, double* pValue, size_t nElements, size_t *nIn)
+{
+    return m_pOwner->readFloat64Array(pasynUser, pValue, nElements, nIn);
+}
+
+asynStatus EpicsShardPortImpl::writeFloat64Array(asynUser *pasynUser, double* pValue, size_t nElements)
+{
+    return m_pOwner->writeFloat64Array(pasynUser, pValue, nElements);
+}
+
+asynStatus EpicsShardPortImpl::readInt32Array(asynUser *pasynUser, epicsInt32 *value, size_t nElements, size_t *nIn)
+{
+    return m_pOwner->readInt32Array(pasynUser, value, nElements, nIn);
+}
+
+asynStatus EpicsShardPortImpl::writeInt32Array(asynUser *pasynUser, epicsInt32 *value, size_t nElements)
+{
+    return m_pOwner->writeInt32Array(pasynUser, value, nElements);
+}
+
+#ifdef NDS3_EXTENDED_DATA_TYPES
+asynStatus EpicsShardPortImpl::readInt16Array(asynUser *pasynUser, epicsInt16 *value, size_t nElements, size_t *nIn)
+{
+    return m_pOwner->readInt16Array(pasynUser, value, nElements, nIn);
+}
+
+asynStatus EpicsShardPortImpl::writeInt16Array(asynUser *pasynUser, epicsInt16 *value, size_t nElements)
+{
+    return m_pOwner->writeInt16Array(pasynUser, value, nElements);
+}
+
+asynStatus EpicsShardPortImpl::readFloat32Array(asynUser *pasynUser, epicsFloat32 *value, size_t nElements, size_t *nIn)
+{
+    return m_pOwner->readFloat32Array(pasynUser, value, nElements, nIn);
+}
+
+asynStatus EpicsShardPortImpl::writeFloat32Array(asynUser *pasynUser, epicsFloat32 *value, size_t nElements)
+{
+    return m_pOwner->writeFloat32Array(pasynUser, value, nElements);
+}
+
+asynStatus EpicsShardPortImpl::readInt64(asynUser *pasynUser, epicsInt64 *value)
+{
+    return m_pOwner->readInt64(pasynUser, value);
+}
+
+asynStatus EpicsShardPortImpl::writeInt64(asynUser *pasynUser, epicsInt64 value)
+{
+    return m_pOwner->writeInt64(pasynUser, value);
+}
+
+asynStatus EpicsShardPortImpl::readInt64Array(asynUser *pasynUser, epicsInt64 *value, size_t nElements, size_t *nIn)
+{
+    return m_pOwner->readInt64Array(pasynUser, value, nElements, nIn);
+}
+
+asynStatus EpicsShardPortImpl::writeInt64Array(asynUser *pasynUser, epicsInt64 *value, size_t nElements)
+{
+    return m_pOwner->writeInt64Array(pasynUser, value, nElements);
+}
+#endif
+
+asynStatus EpicsShardPortImpl::drvUserCreate(asynUser *pasynUser, const char *drvInfo,
+                                             const char **pptypeName, size_t *psize)
+{
+    return m_pOwner->drvUserCreate(pasynUser, drvInfo, pptypeName, psize);
+}
+
+
+/*
+ * Print the status of the port (asynReport)
+ *
+ *******************************************/
+void EpicsShardPortImpl::report(FILE* fp, int details)
+{
+    asynPortDriver::report(fp, details);
+
+    fprintf(fp, "    Serves PVs of port %s\n", m_pOwner->getPortName().c_str());
+}
+
+}
@@ -15,6 +15,7 @@
 #include <set>
 #include <string>
 #include <sstream>
+#include <algorithm>
 
 #include <epicsStdlib.h>
 #include <iocshRegisterCommon.h>
@@ -23,10 +24,12 @@
 #include <epicsThread.h>
 #include <errlog.h>
 #include <epicsExit.h>
+#include <epicsString.h>
 
 #include "nds3/exceptions.h"
 #include "nds3/impl/epicsFactoryImpl.h"
 #include "nds3/impl/epicsInterfaceImpl.h"
+#include "nds3/impl/epicsInterfaceProxyImpl.h"
 #include "nds3/impl/epicsThread.h"
 
 // Include embedded dbd file
@@ -91,6 +94,26 @@ void EpicsFactoryImpl::createNdsDevice(const iocshArgBuf * arguments)
     }
 }
 
+void EpicsFactoryImpl::destroyNdsDevice(const iocshArgBuf * arguments)
+{
+    try
+    {
+        if(arguments[0].sval == 0)
+        {
+            errlogSevPrintf(errlogInfo, "Usage of command ndsDestroyDevice: ndsDestroyDevice parameter\n");
+            return;
+        }
+
+        m_pFactory->destroyDevice(arguments[0].sval);
+    }
+    catch(const std::runtime_error& e)
+    {
+        std::ostringstream errorString;
+        errorString << e.what() << std::endl;
+        errlogSevPrintf(errlogInfo, "%s", errorString.str().c_str());
+    }
+}
+
 void EpicsFactoryImpl::loadNdsDriver(const iocshArgBuf * arguments)
 {
     try
@@ -227,10 +250,540 @@ void EpicsFactoryImpl::ndsUserCommand(const iocshArgBuf * arguments)
 }
 
 
-EpicsFactoryImpl::EpicsFactoryImpl(): m_separator("-"), m_emptyString()
+void EpicsFactoryImpl::setPortShards(const iocshArgBuf * arguments)
+{
+    if(arguments[0].sval == 0 || arguments[1].sval == 0)
+    {
+        errlogSevPrintf(errlogInfo, "Usage of command ndsSetPortShards: ndsSetPortShards portName numShards\n");
+        return;
+    }
+
+    size_t numShards(0);
+    std::istringstream numShardsString(arguments[1].sval);
+    numShardsString >> numShards;
+    if(numShardsString.fail() || numShards == 0)
+    {
+        errlogSevPrintf(errlogInfo, "The number of shards must be a positive number\n");
+        return;
+    }
+
+    m_pFactory->m_portShards[arguments[0].sval] = numShards;
+}
+
+
+void EpicsFactoryImpl::setNonBlockingPVs(const iocshArgBuf * arguments)
+{
+    if(arguments[0].sval == 0)
+    {
+        errlogSevPrintf(errlogInfo, "Usage of command ndsSetNonBlockingPVs: ndsSetNonBlockingPVs pvNamePattern\n");
+        return;
+    }
+
+    m_pFactory->m_nonBlockingPVs.push_back(arguments[0].sval);
+}
+
+
+void EpicsFactoryImpl::setValueCache(const iocshArgBuf * arguments)
+{
+    if(arguments[0].sval == 0)
+    {
+        errlogSevPrintf(errlogInfo, "Usage of command ndsSetValueCache: ndsSetValueCache pvNamePattern [maxAgeSeconds]\n");
+        return;
+    }
+
+    double maxAgeSeconds(0);
+    if(arguments[1].sval != 0)
+    {
+        std::istringstream maxAgeString(arguments[1].sval);
+        maxAgeString >> maxAgeSeconds;
+        if(maxAgeString.fail() || maxAgeSeconds < 0)
+        {
+            errlogSevPrintf(errlogInfo, "The maximum age must be a number of seconds, 0 for no limit\n");
+            return;
+        }
+    }
+
+    m_pFactory->m_valueCacheRules.push_back(std::make_pair(std::string(arguments[0].sval), maxAgeSeconds));
+}
+
+
+void EpicsFactoryImpl::setDatabaseCache(const iocshArgBuf * arguments)
+{
+    if(arguments[0].sval == 0)
+    {
+        errlogSevPrintf(errlogInfo, "Usage of command ndsSetDatabaseCache: ndsSetDatabaseCache directory\n");
+        return;
+    }
+
+    m_pFactory->m_databaseCacheDirectory = arguments[0].sval;
+}
+
+
+void EpicsFactoryImpl::setProcessAtInit(const iocshArgBuf * arguments)
+{
+    std::string mode(arguments[0].sval == 0 ? "" : arguments[0].sval);
+    if(mode == "serial")
+    {
+        m_pFactory->m_parallelProcessAtInit = false;
+    }
+    else if(mode == "parallel")
+    {
+        m_pFactory->m_parallelProcessAtInit = true;
+    }
+    else
+    {
+        errlogSevPrintf(errlogInfo, "Usage of command ndsSetProcessAtInit: ndsSetProcessAtInit serial|parallel\n");
+    }
+}
+
+
+void EpicsFactoryImpl::setThreadPool(const iocshArgBuf * arguments)
+{
+    if(arguments[0].sval == 0)
+    {
+        errlogSevPrintf(errlogInfo, "Usage of command ndsSetThreadPool: ndsSetThreadPool numIdleThreads [enabled]\n");
+        return;
+    }
+
+    size_t numIdleThreads(0);
+    std::istringstream numIdleThreadsString(arguments[0].sval);
+    numIdleThreadsString >> numIdleThreads;
+    if(numIdleThreadsString.fail())
+    {
+        errlogSevPrintf(errlogInfo, "The number of idle threads must be a number\n");
+        return;
+    }
+
+    bool enabled(true);
+    if(arguments[1].sval != 0)
+    {
+        std::istringstream enabledString(arguments[1].sval);
+        enabledString >> enabled;
+        if(enabledString.fail())
+        {
+            errlogSevPrintf(errlogInfo, "The pool must be enabled with 1 or disabled with 0\n");
+            return;
+        }
+    }
+
+    m_pFactory->m_threadPool.setMaxIdleWorkers(numIdleThreads);
+    m_pFactory->m_threadPool.setEnabled(enabled);
+}
+
+
+void EpicsFactoryImpl::threadPoolReport(const iocshArgBuf * /* arguments */)
+{
+    m_pFactory->m_threadPool.report(stdout);
+}
+
+
+void EpicsFactoryImpl::setThreadPolicy(const iocshArgBuf * arguments)
+{
+    if(arguments[0].sval == 0)
+    {
+        errlogSevPrintf(errlogInfo, "Usage of command ndsSetThreadPolicy: ndsSetThreadPolicy threadNamePattern "
+                        "[priority=0-99] [policy=other|fifo|rr] [stack=bytes] [cpus=list]\n");
+        return;
+    }
+
+    threadPolicySettings_t settings;
+
+    try
+    {
+        // The command has the pattern and 4 thread parameters
+        for(size_t argumentNumber(1); argumentNumber != 5 && arguments[argumentNumber].sval != 0; ++argumentNumber)
+        {
+            std::string argument(arguments[argumentNumber].sval);
+            size_t equalPosition = argument.find('=');
+            if(equalPosition == argument.npos)
+            {
+                throw std::runtime_error("The thread parameters must be in the form name=value: " + argument);
+            }
+            std::string name(argument.substr(0, equalPosition));
+            std::string value(argument.substr(equalPosition + 1));
+
+            if(name == "priority" || name == "stack")
+            {
+                std::istringstream valueStream(value);
+                size_t number(0);
+                valueStream >> number;
+                if(valueStream.fail() || (name == "priority" && number > epicsThreadPriorityMax))
+                {
+                    throw std::runtime_error("Invalid value for the thread parameter " + name);
+                }
+                if(name == "priority")
+                {
+                    settings.m_priority = (unsigned int)number;
+                }
+                else
+                {
+                    settings.m_stackSize = number;
+                }
+            }
+            else if(name == "policy")
+            {
+                settings.m_policy = parseSchedulingPolicy(value);
+            }
+            else if(name == "cpus")
+            {
+                settings.m_cpus = parseCpuList(value);
+            }
+            else
+            {
+                throw std::runtime_error("Unknown thread parameter " + name);
+            }
+        }
+    }
+    catch(const std::runtime_error& e)
+    {
+        errlogSevPrintf(errlogInfo, "%s\n", e.what());
+        return;
+    }
+
+    addThreadPolicy(arguments[0].sval, settings);
+}
+
+
+void EpicsFactoryImpl::setLogRateLimit(const iocshArgBuf * arguments)
+{
+    if(arguments[0].sval == 0)
+    {
+        errlogSevPrintf(errlogInfo, "Usage of command ndsSetLogRateLimit: ndsSetLogRateLimit messagesPerSecond [burst]\n");
+        return;
+    }
+
+    double messagesPerSecond(0);
+    std::istringstream messagesPerSecondString(arguments[0].sval);
+    messagesPerSecondString >> messagesPerSecond;
+    if(messagesPerSecondString.fail() || messagesPerSecond < 0)
+    {
+        errlogSevPrintf(errlogInfo, "The rate must be a number of messages per second, 0 for no limit\n");
+        return;
+    }
+
+    double burst(messagesPerSecond);
+    if(arguments[1].sval != 0)
+    {
+        std::istringstream burstString(arguments[1].sval);
+        burstString >> burst;
+        if(burstString.fail() || burst < 1)
+        {
+            errlogSevPrintf(errlogInfo, "The burst must be a number of messages, at least 1\n");
+            return;
+        }
+    }
+
+    m_pFactory->m_pLogger->setRateLimit(messagesPerSecond, burst);
+}
+
+
+void EpicsFactoryImpl::logReport(const iocshArgBuf * /* arguments */)
+{
+    m_pFactory->m_pLogger->report(stdout);
+}
+
+
+void EpicsFactoryImpl::setPvStatsRecords(const iocshArgBuf * arguments)
+{
+    if(arguments[0].sval == 0)
+    {
+        errlogSevPrintf(errlogInfo, "Usage of command ndsSetPvStatsRecords: ndsSetPvStatsRecords pvNamePattern [scanSeconds]\n");
+        return;
+    }
+
+    double scanSeconds(1);
+    if(arguments[1].sval != 0)
+    {
+        std::istringstream scanString(arguments[1].sval);
+        scanString >> scanSeconds;
+        if(scanString.fail() || scanSeconds <= 0)
+        {
+            errlogSevPrintf(errlogInfo, "The scan period must be a positive number of seconds\n");
+            return;
+        }
+    }
+
+    m_pFactory->m_pvStatsRecordsRules.push_back(std::make_pair(std::string(arguments[0].sval), scanSeconds));
+}
+
+
+/*
+ * Sort the PVs by the selected counter, highest first
+ *
+ *****************************************************/
+static std::uint64_t getSortKey(const pvStatisticsSnapshot_t& statistics, const std::string& sortBy)
+{
+    if(sortBy == "pushes")
+    {
+        return statistics.m_pushes;
+    }
+    if(sortBy == "callbacks")
+    {
+        return statistics.m_callbacks;
+    }
+    if(sortBy == "bytes")
+    {
+        return statistics.m_bytes;
+    }
+    if(sortBy == "errors")
+    {
+        return statistics.m_errors;
+    }
+    return statistics.m_readNanoseconds + statistics.m_writeNanoseconds;
+}
+
+void EpicsFactoryImpl::pvStats(const iocshArgBuf * arguments)
+{
+    std::string sortBy(arguments[0].sval == 0 ? "time" : arguments[0].sval);
+    if(sortBy != "time" && sortBy != "pushes" && sortBy != "callbacks" && sortBy != "bytes" && sortBy != "errors")
+    {
+        errlogSevPrintf(errlogInfo, "Usage of command ndsPvStats: ndsPvStats [time|pushes|callbacks|bytes|errors] [count]\n");
+        return;
+    }
+    size_t count(20);
+    if(arguments[1].sval != 0)
+    {
+        std::istringstream countString(arguments[1].sval);
+        countString >> count;
+        if(arguments[1].sval[0] == '-' || countString.fail() || !countString.eof() || count == 0)
+        {
+            errlogSevPrintf(errlogInfo, "The number of PVs to print must be a positive number\n");
+            return;
+        }
+    }
+
+    EpicsInterfaceImpl::pvStatisticsList_t statistics;
+    {
+        std::lock_guard<std::mutex> lock(m_pFactory->m_interfacesLock);
+        for(interfaces_t::const_iterator scanInterfaces(m_pFactory->m_interfaces.begin()), endInterfaces(m_pFactory->m_interfaces.end());
+            scanInterfaces != endInterfaces;
+            ++scanInterfaces)
+        {
+            scanInterfaces->second->collectStatistics(&statistics);
+        }
+    }
+
+    std::stable_sort(statistics.begin(), statistics.end(),
+                     [&sortBy](const EpicsInterfaceImpl::pvStatistics_t& left, const EpicsInterfaceImpl::pvStatistics_t& right)
+    {
+        return getSortKey(left.m_statistics, sortBy) > getSortKey(right.m_statistics, sortBy);
+    });
+    if(statistics.size() > count)
+    {
+        statistics.resize(count);
+    }
+
+    printf("%-40s %10s %10s %10s %10s %10s %10s %10s %8s %12s\n",
+           "PV", "pushes", "callbacks", "reads", "writes", "read us", "write us", "time s", "errors", "bytes");
+    for(EpicsInterfaceImpl::pvStatisticsList_t::const_iterator scanStatistics(statistics.begin()), endStatistics(statistics.end());
+        scanStatistics != endStatistics;
+        ++scanStatistics)
+    {
+        const pvStatisticsSnapshot_t& pv(scanStatistics->m_statistics);
+        printf("%-40s %10llu %10llu %10llu %10llu %10.1f %10.1f %10.3f %8llu %12llu\n",
+               scanStatistics->m_pvName.c_str(),
+               (unsigned long long)pv.m_pushes,
+               (unsigned long long)pv.m_callbacks,
+               (unsigned long long)pv.m_reads,
+               (unsigned long long)pv.m_writes,
+               pv.m_reads == 0 ? 0.0 : (double)pv.m_readNanoseconds / (double)pv.m_reads / 1000.0,
+               pv.m_writes == 0 ? 0.0 : (double)pv.m_writeNanoseconds / (double)pv.m_writes / 1000.0,
+               (double)(pv.m_readNanoseconds + pv.m_writeNanoseconds) / 1.0e9,
+               (unsigned long long)pv.m_errors,
+               (unsigned long long)pv.m_bytes);
+    }
+}
+
+
+void EpicsFactoryImpl::setLatencyHistograms(const iocshArgBuf * arguments)
+{
+    if(arguments[0].sval == 0)
+    {
+        errlogSevPrintf(errlogInfo, "Usage of command ndsSetLatencyHistograms: ndsSetLatencyHistograms pvNamePattern\n");
+        return;
+    }
+
+    m_pFactory->m_latencyHistogramPVs.push_back(arguments[0].sval);
+}
+
+
+void EpicsFactoryImpl::latencyReport(const iocshArgBuf * arguments)
+{
+    bool found(false);
+    std::lock_guard<std::mutex> lock(m_pFactory->m_interfacesLock);
+    for(interfaces_t::const_iterator scanInterfaces(m_pFactory->m_interfaces.begin()), endInterfaces(m_pFactory->m_interfaces.end());
+        scanInterfaces != endInterfaces;
+        ++scanInterfaces)
+    {
+        if(arguments[0].sval == 0 || scanInterfaces->first == arguments[0].sval)
+        {
+            scanInterfaces->second->latencyReport(stdout);
+            found = true;
+        }
+    }
+    if(!found && arguments[0].sval != 0)
+    {
+        errlogSevPrintf(errlogInfo, "The port %s does not exist\n", arguments[0].sval);
+    }
+}
+
+
+void EpicsFactoryImpl::latencyReset(const iocshArgBuf * arguments)
+{
+    bool found(false);
+    std::lock_guard<std::mutex> lock(m_pFactory->m_interfacesLock);
+    for(interfaces_t::const_iterator scanInterfaces(m_pFactory->m_interfaces.begin()), endInterfaces(m_pFactory->m_interfaces.end());
+        scanInterfaces != endInterfaces;
+        ++scanInterfaces)
+    {
+        if(arguments[0].sval == 0 || scanInterfaces->first == arguments[0].sval)
+        {
+            scanInterfaces->second->resetLatency();
+            found = true;
+        }
+    }
+    if(!found && arguments[0].sval != 0)
+    {
+        errlogSevPrintf(errlogInfo, "The port %s does not exist\n", arguments[0].sval);
+    }
+}
+
+
+void EpicsFactoryImpl::initReport(const iocshArgBuf * /* arguments */)
+{
+    if(m_pFactory->m_iocRunning.tv_sec == 0 && m_pFactory->m_iocRunning.tv_nsec == 0)
+    {
+        errlogSevPrintf(errlogInfo, "iocInit has not been completed yet\n");
+    }
+    else
+    {
+        const timespec& start(m_pFactory->m_iocBuildStart);
+        const timespec& database(m_pFactory->m_databaseInitialized);
+        const timespec& running(m_pFactory->m_iocRunning);
+        printf("iocInit: %.3f s, of which %.3f s initializing the records\n",
+               (double)(running.tv_sec - start.tv_sec) + (double)(running.tv_nsec - start.tv_nsec) / 1.0e9,
+               (double)(database.tv_sec - start.tv_sec) + (double)(database.tv_nsec - start.tv_nsec) / 1.0e9);
+    }
+
+    std::lock_guard<std::mutex> lock(m_pFactory->m_interfacesLock);
+    for(interfaces_t::const_iterator scanInterfaces(m_pFactory->m_interfaces.begin()), endInterfaces(m_pFactory->m_interfaces.end());
+        scanInterfaces != endInterfaces;
+        ++scanInterfaces)
+    {
+        scanInterfaces->second->initReport(stdout);
+    }
+}
+
+
+void EpicsFactoryImpl::setPushQueue(const iocshArgBuf * arguments)
+{
+    if(arguments[0].sval == 0 || arguments[1].sval == 0)
+    {
+        errlogSevPrintf(errlogInfo, "Usage of command ndsSetPushQueue: ndsSetPushQueue portName queueSize [block|dropOldest|keepLatest]\n");
+        return;
+    }
+
+    pushQueueSettings_t settings;
+
+    std::istringstream queueSize(arguments[1].sval);
+    queueSize >> settings.m_queueSize;
+    if(queueSize.fail() || settings.m_queueSize == 0)
+    {
+        errlogSevPrintf(errlogInfo, "The queue size must be a positive number\n");
+        return;
+    }
+
+    std::string overflowPolicy(arguments[2].sval == 0 ? "block" : arguments[2].sval);
+    if(overflowPolicy == "block")
+    {
+        settings.m_overflowPolicy = pushQueueOverflow_t::block;
+    }
+    else if(overflowPolicy == "dropOldest")
+    {
+        settings.m_overflowPolicy = pushQueueOverflow_t::dropOldest;
+    }
+    else if(overflowPolicy == "keepLatest")
+    {
+        settings.m_overflowPolicy = pushQueueOverflow_t::keepLatest;
+    }
+    else
+    {
+        errlogSevPrintf(errlogInfo, "Unknown overflow policy %s. Use block, dropOldest or keepLatest\n", overflowPolicy.c_str());
+        return;
+    }
+
+    m_pFactory->m_pushQueueSettings[arguments[0].sval] = settings;
+}
+
+
+void EpicsFactoryImpl::setPushFilter(const iocshArgBuf * arguments)
+{
+    if(arguments[0].sval == 0 || arguments[1].sval == 0)
+    {
+        errlogSevPrintf(errlogInfo, "Usage of command ndsSetPushFilter: ndsSetPushFilter pvNamePattern "
+                        "[deadband=value] [relativeDeadband=value] [minInterval=seconds] [onChange=0|1]\n");
+        return;
+    }
+
+    pushFilterSettings_t settings;
+
+    for(size_t argumentNumber(1); arguments[argumentNumber].sval != 0; ++argumentNumber)
+    {
+        std::string argument(arguments[argumentNumber].sval);
+        size_t equalPosition = argument.find('=');
+        if(equalPosition == argument.npos)
+        {
+            errlogSevPrintf(errlogInfo, "The filter parameters must be in the form name=value: %s\n", argument.c_str());
+            return;
+        }
+        std::string name(argument.substr(0, equalPosition));
+        std::istringstream valueStream(argument.substr(equalPosition + 1));
+        double value;
+        valueStream >> value;
+        if(valueStream.fail() || value < 0)
+        {
+            errlogSevPrintf(errlogInfo, "Invalid value for the filter parameter %s\n", name.c_str());
+            return;
+        }
+
+        if(name == "deadband")
+        {
+            settings.m_absoluteDeadband = value;
+        }
+        else if(name == "relativeDeadband")
+        {
+            settings.m_relativeDeadband = value;
+        }
+        else if(name == "minInterval")
+        {
+            settings.m_minIntervalSeconds = value;
+        }
+        else if(name == "onChange")
+        {
+            settings.m_onChange = (value != 0);
+        }
+        else
+        {
+            errlogSevPrintf(errlogInfo, "Unknown filter parameter %s\n", name.c_str());
+            return;
+        }
+    }
+
+    m_pFactory->m_pushFilterRules.push_back(std::make_pair(std::string(arguments[0].sval), settings));
+}
+
+
+EpicsFactoryImpl::EpicsFactoryImpl(): m_separator("-"), m_emptyString(), m_parallelProcessAtInit(false),
+    m_threadPool("ndsPool", 4, 10.0)
 {
     m_pFactory = this;
 
+    m_iocBuildStart.tv_sec = m_iocBuildStart.tv_nsec = 0;
+    m_databaseInitialized.tv_sec = m_databaseInitialized.tv_nsec = 0;
+    m_iocRunning.tv_sec = m_iocRunning.tv_nsec = 0;
+
+    m_pLogger.reset(new EpicsLogger(this, 1024));
+
     // Register the global commands
     ///////////////////////////////
     {
@@ -252,6 +805,12 @@ EpicsFactoryImpl::EpicsFactoryImpl(): m_separator("-"), m_emptyString()
         registerGlobalCommand("ndsCreateDevice", ndsCreateDeviceParameters, createNdsDevice);
     }
 
+    {
+        commandParametersNames_t ndsDestroyDeviceParameters;
+        ndsDestroyDeviceParameters.push_back("parameter");
+        registerGlobalCommand("ndsDestroyDevice", ndsDestroyDeviceParameters, destroyNdsDevice);
+    }
+
     {
         commandParametersNames_t ndsCommandParameters;
         ndsCommandParameters.push_back("commandName");
@@ -277,6 +836,131 @@ EpicsFactoryImpl::EpicsFactoryImpl(): m_separator("-"), m_emptyString()
         registerGlobalCommand("ndsEnableNamingRules", ndsEnableNamingRulesParameters, enableNdsNamingRules);
     }
 
+    {
+        commandParametersNames_t ndsSetPushQueueParameters;
+        ndsSetPushQueueParameters.push_back("portName");
+        ndsSetPushQueueParameters.push_back("queueSize");
+        ndsSetPushQueueParameters.push_back("overflowPolicy");
+        registerGlobalCommand("ndsSetPushQueue", ndsSetPushQueueParameters, setPushQueue);
+    }
+
+    {
+        commandParametersNames_t ndsSetPortShardsParameters;
+        ndsSetPortShardsParameters.push_back("portName");
+        ndsSetPortShardsParameters.push_back("numShards");
+        registerGlobalCommand("ndsSetPortShards", ndsSetPortShardsParameters, setPortShards);
+    }
+
+    {
+        commandParametersNames_t ndsSetNonBlockingPVsParameters;
+        ndsSetNonBlockingPVsParameters.push_back("pvNamePattern");
+        registerGlobalCommand("ndsSetNonBlockingPVs", ndsSetNonBlockingPVsParameters, setNonBlockingPVs);
+    }
+
+    {
+        commandParametersNames_t ndsSetValueCacheParameters;
+        ndsSetValueCacheParameters.push_back("pvNamePattern");
+        ndsSetValueCacheParameters.push_back("maxAgeSeconds");
+        registerGlobalCommand("ndsSetValueCache", ndsSetValueCacheParameters, setValueCache);
+    }
+
+    {
+        commandParametersNames_t ndsSetPushFilterParameters;
+        ndsSetPushFilterParameters.push_back("pvNamePattern");
+        for(size_t createParameters(0); createParameters != 4; ++createParameters)
+        {
+            std::ostringstream parameterName;
+            parameterName << "filterParameter" << createParameters;
+            ndsSetPushFilterParameters.push_back(parameterName.str());
+        }
+        registerGlobalCommand("ndsSetPushFilter", ndsSetPushFilterParameters, setPushFilter);
+    }
+
+    {
+        commandParametersNames_t ndsSetDatabaseCacheParameters;
+        ndsSetDatabaseCacheParameters.push_back("directory");
+        registerGlobalCommand("ndsSetDatabaseCache", ndsSetDatabaseCacheParameters, setDatabaseCache);
+    }
+
+    {
+        commandParametersNames_t ndsSetProcessAtInitParameters;
+        ndsSetProcessAtInitParameters.push_back("mode");
+        registerGlobalCommand("ndsSetProcessAtInit", ndsSetProcessAtInitParameters, setProcessAtInit);
+    }
+
+    {
+        commandParametersNames_t ndsInitReportParameters;
+        registerGlobalCommand("ndsInitReport", ndsInitReportParameters, initReport);
+    }
+
+    {
+        commandParametersNames_t ndsSetThreadPoolParameters;
+        ndsSetThreadPoolParameters.push_back("numIdleThreads");
+        ndsSetThreadPoolParameters.push_back("enabled");
+        registerGlobalCommand("ndsSetThreadPool", ndsSetThreadPoolParameters, setThreadPool);
+    }
+
+    {
+        commandParametersNames_t ndsThreadPoolReportParameters;
+        registerGlobalCommand("ndsThreadPoolReport", ndsThreadPoolReportParameters, threadPoolReport);
+    }
+
+    {
+        commandParametersNames_t ndsSetThreadPolicyParameters;
+        ndsSetThreadPolicyParameters.push_back("threadNamePattern");
+        for(size_t createParameters(0); createParameters != 4; ++createParameters)
+        {
+            std::ostringstream parameterName;
+            parameterName << "threadParameter" << createParameters;
+            ndsSetThreadPolicyParameters.push_back(parameterName.str());
+        }
+        registerGlobalCommand("ndsSetThreadPolicy", ndsSetThreadPolicyParameters, setThreadPolicy);
+    }
+
+    {
+        commandParametersNames_t ndsSetLogRateLimitParameters;
+        ndsSetLogRateLimitParameters.push_back("messagesPerSecond");
+        ndsSetLogRateLimitParameters.push_back("burst");
+        registerGlobalCommand("ndsSetLogRateLimit", ndsSetLogRateLimitParameters, setLogRateLimit);
+    }
+
+    {
+        commandParametersNames_t ndsLogReportParameters;
+        registerGlobalCommand("ndsLogReport", ndsLogReportParameters, logReport);
+    }
+
+    {
+        commandParametersNames_t ndsSetPvStatsRecordsParameters;
+        ndsSetPvStatsRecordsParameters.push_back("pvNamePattern");
+        ndsSetPvStatsRecordsParameters.push_back("scanSeconds");
+        registerGlobalCommand("ndsSetPvStatsRecords", ndsSetPvStatsRecordsParameters, setPvStatsRecords);
+    }
+
+    {
+        commandParametersNames_t ndsPvStatsParameters;
+        ndsPvStatsParameters.push_back("sortBy");
+        ndsPvStatsParameters.push_back("count");
+        registerGlobalCommand("ndsPvStats", ndsPvStatsParameters, pvStats);
+    }
+
+    {
+        commandParametersNames_t ndsSetLatencyHistogramsParameters;
+        ndsSetLatencyHistogramsParameters.push_back("pvNamePattern");
+        registerGlobalCommand("ndsSetLatencyHistograms", ndsSetLatencyHistogramsParameters, setLatencyHistograms);
+    }
+
+    {
+        commandParametersNames_t ndsLatencyReportParameters;
+        ndsLatencyReportParameters.push_back("portName");
+        registerGlobalCommand("ndsLatencyReport", ndsLatencyReportParameters, latencyReport);
+    }
+
+    {
+        commandParametersNames_t ndsLatencyResetParameters;
+        ndsLatencyResetParameters.push_back("portName");
+        registerGlobalCommand("ndsLatencyReset", ndsLatencyResetParameters, latencyReset);
+    }
+
     initHookRegister(&EpicsFactoryImpl::epicsInitHookFunction);
 
 
@@ -284,25 +968,107 @@ EpicsFactoryImpl::EpicsFactoryImpl(): m_separator("-"), m_emptyString()
 
 void EpicsFactoryImpl::epicsInitHookFunction(initHookState state)
 {
+    switch(state)
+    {
+    case initHookAtIocBuild:
+        clock_gettime(CLOCK_MONOTONIC, &m_pFactory->m_iocBuildStart);
+        break;
+    case initHookAfterInitDatabase:
+        clock_gettime(CLOCK_MONOTONIC, &m_pFactory->m_databaseInitialized);
+        break;
+    case initHookAfterIocRunning:
+        clock_gettime(CLOCK_MONOTONIC, &m_pFactory->m_iocRunning);
+        break;
+    default:
+        break;
+    }
+
     if(state == initHookAfterIocRunning)
     {
         // Process all records with PINI
-        for(std::list<std::string>::const_iterator scanPVs(m_pFactory->m_processAtInit.begin()), endPVs(m_pFactory->m_processAtInit.end());
-            scanPVs != endPVs;
-            ++scanPVs)
+        m_pFactory->processPendingRecords();
+    }
+}
+
+InterfaceBaseImpl* EpicsFactoryImpl::getNewInterface(const std::string& fullName)
+{
+    // The asyn ports and the records cannot be deleted: the interface of a
+    //  destroyed port is kept and reused when the port is created again
+    {
+        std::lock_guard<std::mutex> lock(m_interfacesLock);
+        interfaces_t::const_iterator findInterface = m_interfaces.find(fullName);
+        if(findInterface != m_interfaces.end())
         {
-            std::string command("dbpf ");
-            command += *scanPVs;
-            command += ".PROC 1";
-            iocshCmd(command.c_str());
+            return new EpicsInterfaceProxyImpl(findInterface->second);
         }
-        m_pFactory->m_processAtInit.clear();
     }
+
+    EpicsInterfaceImpl* pInterface = new EpicsInterfaceImpl(fullName, this);
+
+    portShards_t::const_iterator findShards = m_portShards.find(fullName);
+    if(findShards != m_portShards.end())
+    {
+        pInterface->enableShards(findShards->second);
+    }
+
+    portPushQueueSettings_t::const_iterator findPushQueue = m_pushQueueSettings.find(fullName);
+    if(findPushQueue != m_pushQueueSettings.end())
+    {
+        pInterface->enablePushQueue(findPushQueue->second.m_queueSize, findPushQueue->second.m_overflowPolicy);
+    }
+
+    std::lock_guard<std::mutex> lock(m_interfacesLock);
+    m_interfaces[fullName] = pInterface;
+
+    return new EpicsInterfaceProxyImpl(pInterface);
 }
 
-InterfaceBaseImpl* EpicsFactoryImpl::getNewInterface(const std::string& fullName)
+
+/*
+ * Find the interface of a port
+ *
+ ******************************/
+EpicsInterfaceImpl* EpicsFactoryImpl::getInterface(const std::string& portName)
 {
-    return new EpicsInterfaceImpl(fullName, this);
+    if(m_pFactory == 0)
+    {
+        return 0;
+    }
+
+    std::lock_guard<std::mutex> lock(m_pFactory->m_interfacesLock);
+    interfaces_t::const_iterator findInterface = m_pFactory->m_interfaces.find(portName);
+    if(findInterface == m_pFactory->m_interfaces.end())
+    {
+        return 0;
+    }
+    return findInterface->second;
+}
+
+
+/*
+ * Add a rule for the settings of the threads
+ *
+ ********************************************/
+void EpicsFactoryImpl::addThreadPolicy(const std::string& threadNamePattern, const threadPolicySettings_t& settings)
+{
+    if(m_pFactory == 0)
+    {
+        throw std::logic_error("The EPICS factory has not been created yet");
+    }
+
+    std::lock_guard<std::mutex> lock(m_pFactory->m_threadPolicyLock);
+    m_pFactory->m_threadPolicyRules.push_back(std::make_pair(threadNamePattern, settings));
+}
+
+
+/*
+ * Remove a destroyed interface from the list of interfaces
+ *
+ **********************************************************/
+void EpicsFactoryImpl::deregisterInterface(const std::string& portName)
+{
+    std::lock_guard<std::mutex> lock(m_interfacesLock);
+    m_interfaces.erase(portName);
 }
 
 
@@ -385,7 +1151,119 @@ void EpicsFactoryImpl::registerGlobalCommand(const std::string& commandName, con
 
 void EpicsFactoryImpl::processAtInit(const std::string& pvName)
 {
-    m_processAtInit.push_back(pvName);
+    m_processAtInit.addRecord(pvName);
+}
+
+void EpicsFactoryImpl::processPendingRecords()
+{
+    if(m_iocRunning.tv_sec != 0 || m_iocRunning.tv_nsec != 0)
+    {
+        m_processAtInit.process(m_parallelProcessAtInit);
+    }
+}
+
+bool EpicsFactoryImpl::isIocInitialized() const
+{
+    return m_iocBuildStart.tv_sec != 0 || m_iocBuildStart.tv_nsec != 0;
+}
+
+bool EpicsFactoryImpl::isNonBlockingPV(const std::string& pvName) const
+{
+    for(std::list<std::string>::const_iterator scanPatterns(m_nonBlockingPVs.begin()), endPatterns(m_nonBlockingPVs.end());
+        scanPatterns != endPatterns;
+        ++scanPatterns)
+    {
+        if(epicsStrGlobMatch(pvName.c_str(), scanPatterns->c_str()))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool EpicsFactoryImpl::hasLatencyHistograms(const std::string& pvName) const
+{
+    for(std::list<std::string>::const_iterator scanPatterns(m_latencyHistogramPVs.begin()), endPatterns(m_latencyHistogramPVs.end());
+        scanPatterns != endPatterns;
+        ++scanPatterns)
+    {
+        if(epicsStrGlobMatch(pvName.c_str(), scanPatterns->c_str()))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool EpicsFactoryImpl::getValueCacheSettings(const std::string& pvName, double* pMaxAgeSeconds) const
+{
+    bool found(false);
+    for(valueCacheRules_t::const_iterator scanRules(m_valueCacheRules.begin()), endRules(m_valueCacheRules.end());
+        scanRules != endRules;
+        ++scanRules)
+    {
+        if(epicsStrGlobMatch(pvName.c_str(), scanRules->first.c_str()))
+        {
+            *pMaxAgeSeconds = scanRules->second;
+            found = true;
+        }
+    }
+    return found;
+}
+
+bool EpicsFactoryImpl::getPvStatsRecordsSettings(const std::string& pvName, double* pScanSeconds) const
+{
+    bool found(false);
+    for(pvStatsRecordsRules_t::const_iterator scanRules(m_pvStatsRecordsRules.begin()), endRules(m_pvStatsRecordsRules.end());
+        scanRules != endRules;
+        ++scanRules)
+    {
+        if(epicsStrGlobMatch(pvName.c_str(), scanRules->first.c_str()))
+        {
+            *pScanSeconds = scanRules->second;
+            found = true;
+        }
+    }
+    return found;
+}
+
+const std::string& EpicsFactoryImpl::getDatabaseCacheDirectory() const
+{
+    return m_databaseCacheDirectory;
+}
+
+bool EpicsFactoryImpl::getPushFilterSettings(const std::string& pvName, pushFilterSettings_t* pSettings) const
+{
+    bool found(false);
+    for(pushFilterRules_t::const_iterator scanRules(m_pushFilterRules.begin()), endRules(m_pushFilterRules.end());
+        scanRules != endRules;
+        ++scanRules)
+    {
+        if(epicsStrGlobMatch(pvName.c_str(), scanRules->first.c_str()))
+        {
+            *pSettings = scanRules->second;
+            found = true;
+        }
+    }
+    return found;
+}
+
+bool EpicsFactoryImpl::getThreadPolicySettings(const std::string& threadName, threadPolicySettings_t* pSettings) const
+{
+    std::lock_guard<std::mutex> lock(m_threadPolicyLock);
+
+    bool found(false);
+    for(threadPolicyRules_t::const_iterator scanRules(m_threadPolicyRules.begin()), endRules(m_threadPolicyRules.end());
+        scanRules != endRules;
+        ++scanRules)
+    {
+        if(epicsStrGlobMatch(threadName.c_str(), scanRules->first.c_str()))
+        {
+            *pSettings = scanRules->second;
+            found = true;
+        }
+    }
+    return found;
 }
 
 void EpicsFactoryImpl::log(const std::string &logString, logLevel_t logLevel)
@@ -409,6 +1287,11 @@ void EpicsFactoryImpl::log(const std::string &logString, logLevel_t logLevel)
     }
 }
 
+EpicsLogger& EpicsFactoryImpl::getLogger()
+{
+    return *m_pLogger;
+}
+
 LogStreamGetterImpl* EpicsFactoryImpl::getLogStreamGetter()
 {
     return this;
@@ -508,7 +1391,18 @@ void EpicsFactoryImpl::deregisterCommand(const BaseImpl& node)
 
 ThreadBaseImpl* EpicsFactoryImpl::runInThread(const std::string& name, threadFunction_t function)
 {
-    return new EpicsThread(this, name, function);
+    // The threads with a rule, even without settings, are not shared
+    threadPolicySettings_t settings;
+    if(getThreadPolicySettings(name, &settings))
+    {
+        return new EpicsThread(this, name, function, settings);
+    }
+
+    if(!m_threadPool.isEnabled())
+    {
+        return new EpicsThread(this, name, function);
+    }
+    return m_threadPool.run(this, name, function);
 }
 
 const std::string& EpicsFactoryImpl::getDefaultSeparator(const std::uint32_t nodeLevel) const
@@ -527,8 +1421,11 @@ EpicsLogStreamBufferImpl::EpicsLogStreamBufferImpl(const logLevel_t logLevel, Ep
 
 int EpicsLogStreamBufferImpl::sync()
 {
-    std::string string(std::string(pbase(), pptr() - pbase()));
-    m_pFactory->log(string, m_logLevel);
+    // Queued for the logger's thread: the caller doesn't wait for errlog
+    if(pptr() != pbase())
+    {
+        m_pFactory->getLogger().log(&m_rateLimiter, m_logLevel, pbase(), pptr() - pbase());
+    }
     seekpos(0);
     return 0;
 }
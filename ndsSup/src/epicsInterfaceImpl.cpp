@@ -18,74 +18,500 @@
 #include <sstream>
 #include <ostream>
 #include <fstream>
+#include <cstdio>
 #include <stdexcept>
+#include <algorithm>
 #include <memory.h>
 
-#include <iocsh.h>
+#include <dbStaticLib.h>
+#include <errlog.h>
+#include <epicsThread.h>
 
 #include <nds3/pvBase.h>
 #include <nds3/exceptions.h>
 #include <nds3/definitions.h>
 #include <nds3/impl/pvBaseImpl.h>
 #include <nds3/impl/pvActionImpl.h>
+#include <nds3/impl/pvBaseInImpl.h>
 #include <nds3/impl/pvVariableInImpl.h>
+#include <nds3/impl/pvVariableOutImpl.h>
 #include <nds3/impl/portImpl.h>
 
 #include "nds3/impl/epicsInterfaceImpl.h"
 #include "nds3/impl/epicsFactoryImpl.h"
+#include "nds3/impl/epicsArrayAccess.h"
 
 namespace nds
 {
 
+static const char notRegisteredError[] = "The PV is not registered";
+
+// The array reads and writes that fall back to the vector interface reuse a
+//  vector per thread up to this size; larger arrays use a vector per call
+static const size_t maxReusedVectorBytes(65536);
+
+/*
+ * Waveform with the statistics of another PV (ndsSetPvStatsRecords)
+ *
+ *******************************************************************/
+class EpicsStatisticsPV: public PVBaseInImpl, public EpicsNonBlockingPV
+{
+public:
+    EpicsStatisticsPV(const std::string& name, const EpicsPvStatistics& statistics):
+        PVBaseInImpl(name), m_statistics(statistics)
+    {
+    }
+
+    virtual dataType_t getDataType() const
+    {
+        return dataType_t::dataFloat64Array;
+    }
+
+    virtual void read(timespec* pTimestamp, std::vector<double>* pValue) const
+    {
+        clock_gettime(CLOCK_REALTIME, pTimestamp);
+
+        pvStatisticsSnapshot_t snapshot(m_statistics.getSnapshot());
+        pValue->resize(numElements);
+        (*pValue)[0] = (double)snapshot.m_pushes;
+        (*pValue)[1] = (double)snapshot.m_callbacks;
+        (*pValue)[2] = (double)snapshot.m_reads;
+        (*pValue)[3] = (double)snapshot.m_writes;
+        (*pValue)[4] = (double)snapshot.m_readNanoseconds / 1.0e9;
+        (*pValue)[5] = (double)snapshot.m_writeNanoseconds / 1.0e9;
+        (*pValue)[6] = (double)snapshot.m_errors;
+        (*pValue)[7] = (double)snapshot.m_bytes;
+    }
+
+    static const size_t numElements = 8;
+
+private:
+    const EpicsPvStatistics& m_statistics;
+};
+
+
+/*
+ * Settings of the thread of an asyn port, from ndsSetThreadPolicy
+ *
+ *****************************************************************/
+static threadPolicySettings_t getPortThreadPolicy(EpicsFactoryImpl* pEpicsFactory, const std::string& asynPortName)
+{
+    threadPolicySettings_t settings;
+    pEpicsFactory->getThreadPolicySettings(asynPortName, &settings);
+    return settings;
+}
+
 /*
  * Constructor
  *
  *************/
 EpicsInterfaceImpl::EpicsInterfaceImpl(const std::string& portName, EpicsFactoryImpl* pEpicsFactory):
-    asynPortDriver(
-        portName.c_str(),
-        0,    /* maxAddr */
-        0,
-        //asynCommonMask |
-        asynDrvUserMask |
-        //asynOptionMask |
-        asynInt32Mask |
-        // asynUInt32DigitalMask |
-        asynFloat64Mask  |
-        //asynOctetMask |
-        asynInt8ArrayMask |
-        //asynInt16ArrayMask |
-        asynInt32ArrayMask |
-        //asynFloat32ArrayMask |
-        asynFloat64ArrayMask
-        //asynGenericPointerMask,   /* Interface mask */
-        ,
-        asynInt32Mask |
-        // asynUInt32DigitalMask |
-        asynFloat64Mask |
-        //asynOctetMask |
-        asynInt8ArrayMask |
-        //asynInt16ArrayMask |
-        asynInt32ArrayMask |
-        //asynFloat32ArrayMask |
-        asynFloat64ArrayMask
-        //asynGenericPointerMask,            /* Interrupt mask */
-        , ASYN_CANBLOCK | ASYN_MULTIDEVICE,  /* asynFlags. */
-        1,                                 /* Autoconnect */
-        0,                                 /* Default priority */
-        0), m_pEpicsFactory(pEpicsFactory)
+    EpicsAsynPortImpl(portName, ASYN_CANBLOCK, getPortThreadPolicy(pEpicsFactory, portName)),
+    m_numRecords(0), m_recordsFromCache(false), m_recordsCreationSeconds(0),
+    m_drvUserCreateCalls(0), m_drvUserCreateNanoseconds(0),
+    m_pEpicsFactory(pEpicsFactory)
 {
+    installInterruptHooks(&asynStdInterfaces);
+    applyPortThreadPolicy(portName);
 }
 
 
 /*
- * Convert a data type from enum to string.
+ * Destructor
  *
- * We use a switch and not a map for the conversion so we receive warnings
- *  if we forget a conversion.
+ ************/
+EpicsInterfaceImpl::~EpicsInterfaceImpl()
+{
+    m_pEpicsFactory->deregisterInterface(portName);
+
+    // Stop the dispatcher before the subscribers index is destroyed
+    m_pPushDispatcher.reset();
+}
+
+
+/*
+ * Enable the delivery of the pushed values from a dedicated thread
+ *
+ ******************************************************************/
+void EpicsInterfaceImpl::enablePushQueue(size_t queueSize, pushQueueOverflow_t overflowPolicy)
+{
+    if(m_pPushDispatcher.get() != 0)
+    {
+        throw std::logic_error("The push queue has already been enabled on the port " + std::string(portName));
+    }
+    std::lock_guard<std::mutex> lock(m_registrationLock);
+    m_pPushDispatcher.reset(new EpicsPushDispatcher(m_pEpicsFactory, this, portName, queueSize, overflowPolicy));
+    m_pPushDispatcher->setNumReasons(m_reasons.size());
+}
+
+
+/*
+ * Create the additional asyn ports
+ *
+ **********************************/
+void EpicsInterfaceImpl::enableShards(size_t numShards)
+{
+    if(!m_shardPorts.empty())
+    {
+        throw std::logic_error("The shards have already been enabled on the port " + std::string(portName));
+    }
+    if(!m_reasons.empty())
+    {
+        throw std::logic_error("The shards must be enabled before the PVs are registered on the port " + std::string(portName));
+    }
+
+    for(size_t scanShards(1); scanShards < numShards; ++scanShards)
+    {
+        std::ostringstream shardName;
+        shardName << portName << "_" << scanShards;
+        m_shardPorts.push_back(std::unique_ptr<EpicsShardPortImpl>(
+                                   new EpicsShardPortImpl(shardName.str(), this, ASYN_CANBLOCK,
+                                                          getPortThreadPolicy(m_pEpicsFactory, shardName.str()))));
+        applyPortThreadPolicy(shardName.str());
+    }
+}
+
+
+/*
+ * Apply the scheduling policy and the affinity to the thread of a port.
+ *  asyn names the thread of a port after the port
+ *
+ ***********************************************************************/
+void EpicsInterfaceImpl::applyPortThreadPolicy(const std::string& asynPortName)
+{
+    threadPolicySettings_t settings;
+    if(!m_pEpicsFactory->getThreadPolicySettings(asynPortName, &settings) ||
+       (settings.m_policy == schedulingPolicy_t::other && settings.m_cpus.empty()))
+    {
+        return;
+    }
+
+    epicsThreadId threadId(epicsThreadGetId(asynPortName.c_str()));
+    if(threadId == 0)
+    {
+        errlogSevPrintf(errlogMinor, "Cannot find the thread of the asyn port %s\n", asynPortName.c_str());
+        return;
+    }
+
+    try
+    {
+        applyThreadPolicy(threadId, settings);
+    }
+    catch(const std::runtime_error& e)
+    {
+        errlogSevPrintf(errlogMinor, "Asyn port %s: %s\n", asynPortName.c_str(), e.what());
+    }
+}
+
+
+/*
+ * Return the port that serves a reason. Shard 0 is the main port
+ *
+ ****************************************************************/
+std::string EpicsInterfaceImpl::getShardPortName(size_t reason) const
+{
+    size_t shard(reason % (m_shardPorts.size() + 1));
+    if(shard == 0)
+    {
+        return portName;
+    }
+    return m_shardPorts[shard - 1]->portName;
+}
+
+
+/*
+ * Check if a PV is a variable of the specified type
+ *
+ ***************************************************/
+template<typename T>
+static bool isVariable(const PVBaseImpl* pPV)
+{
+    return dynamic_cast<const PVVariableInImpl<T>*>(pPV) != 0 || dynamic_cast<const PVVariableOutImpl<T>*>(pPV) != 0;
+}
+
+
+/*
+ * Check if the PV is a variable of its data type.
+ *
+ * We use a switch so we receive warnings if we forget a data type.
+ *
+ ******************************************************************/
+static bool isVariable(const PVBaseImpl& pv)
+{
+    const PVBaseImpl* pPV(&pv);
+    switch(pv.getDataType())
+    {
+    case dataType_t::dataInt32:
+        return isVariable<std::int32_t>(pPV);
+    case dataType_t::dataFloat64:
+        return isVariable<double>(pPV);
+    case dataType_t::dataInt8Array:
+        return isVariable<std::vector<std::int8_t> >(pPV);
+    case dataType_t::dataUint8Array:
+        return isVariable<std::vector<std::uint8_t> >(pPV);
+    case dataType_t::dataInt32Array:
+        return isVariable<std::vector<std::int32_t> >(pPV);
+    case dataType_t::dataFloat64Array:
+        return isVariable<std::vector<double> >(pPV);
+    case dataType_t::dataString:
+        return isVariable<std::string>(pPV);
+#ifdef NDS3_EXTENDED_DATA_TYPES
+    case dataType_t::dataInt16Array:
+        return isVariable<std::vector<std::int16_t> >(pPV);
+    case dataType_t::dataUint16Array:
+        return isVariable<std::vector<std::uint16_t> >(pPV);
+    case dataType_t::dataFloat32Array:
+        return isVariable<std::vector<float> >(pPV);
+    case dataType_t::dataInt64:
+        return isVariable<std::int64_t>(pPV);
+    case dataType_t::dataInt64Array:
+        return isVariable<std::vector<std::int64_t> >(pPV);
+#endif
+    }
+    return false;
+}
+
+
+/*
+ * Check if the PV can be served by the synchronous port
+ *
+ *******************************************************/
+bool EpicsInterfaceImpl::isNonBlocking(const PVBaseImpl& pv) const
+{
+    return dynamic_cast<const EpicsNonBlockingPV*>(&pv) != 0 ||
+            isVariable(pv) ||
+            m_pEpicsFactory->isNonBlockingPV(pv.getFullExternalName());
+}
+
+
+/*
+ * Return the synchronous port, allocating it if necessary
+ *
+ *********************************************************/
+std::string EpicsInterfaceImpl::getSynchronousPortName()
+{
+    if(m_pSynchronousPort.get() == 0)
+    {
+        m_pSynchronousPort.reset(new EpicsShardPortImpl(std::string(portName) + "_sync", this, 0, threadPolicySettings_t()));
+    }
+    return m_pSynchronousPort->portName;
+}
+
+
+std::string EpicsInterfaceImpl::getPortName() const
+{
+    return portName;
+}
+
+
+EpicsInterfaceImpl* EpicsInterfaceImpl::getInterfaceImpl()
+{
+    return this;
+}
+
+
+/*
+ * Install the interrupt hooks on all the interfaces of a port
+ *
+ *************************************************************/
+void EpicsInterfaceImpl::installInterruptHooks(asynStandardInterfaces* pInterfaces)
+{
+    installInterruptHook<int32Hook_t, &EpicsInterfaceImpl::m_int32Hook>(&pInterfaces->int32);
+    installInterruptHook<float64Hook_t, &EpicsInterfaceImpl::m_float64Hook>(&pInterfaces->float64);
+    installInterruptHook<int8ArrayHook_t, &EpicsInterfaceImpl::m_int8ArrayHook>(&pInterfaces->int8Array);
+    installInterruptHook<int32ArrayHook_t, &EpicsInterfaceImpl::m_int32ArrayHook>(&pInterfaces->int32Array);
+    installInterruptHook<float64ArrayHook_t, &EpicsInterfaceImpl::m_float64ArrayHook>(&pInterfaces->float64Array);
+    installInterruptHook<genericPointerHook_t, &EpicsInterfaceImpl::m_genericPointerHook>(&pInterfaces->genericPointer);
+#ifdef NDS3_EXTENDED_DATA_TYPES
+    installInterruptHook<int16ArrayHook_t, &EpicsInterfaceImpl::m_int16ArrayHook>(&pInterfaces->int16Array);
+    installInterruptHook<float32ArrayHook_t, &EpicsInterfaceImpl::m_float32ArrayHook>(&pInterfaces->float32Array);
+    installInterruptHook<int64Hook_t, &EpicsInterfaceImpl::m_int64Hook>(&pInterfaces->int64);
+    installInterruptHook<int64ArrayHook_t, &EpicsInterfaceImpl::m_int64ArrayHook>(&pInterfaces->int64Array);
+#endif
+}
+
+
+/*
+ * Replace the interrupt registration functions of an asyn interface
+ *
+ * asynPortDriver has already registered the interface with asynManager,
+ *  which keeps a pointer to asynInterface: the records retrieve pinterface
+ *  during their initialization, so they will call our hooks.
+ *
+ ***************************************************************************/
+template<typename hook_t, hook_t EpicsInterfaceImpl::*pHook>
+void EpicsInterfaceImpl::installInterruptHook(asynInterface* pAsynInterface)
+{
+    hook_t& hook = this->*pHook;
+    const typename hook_t::interface_t* pOriginal = (const typename hook_t::interface_t*)pAsynInterface->pinterface;
+
+    // The shards share the hook of the main port: asynPortDriver uses the same
+    //  functions table for all its instances, and the functions receive the
+    //  port in drvPvt.
+    if(hook.m_pOriginal != 0 && hook.m_pOriginal != pOriginal)
+    {
+        throw std::logic_error("The asyn ports of " + std::string(portName) + " use different interrupt functions");
+    }
+    hook.m_pOriginal = pOriginal;
+    hook.m_interface = *hook.m_pOriginal;
+    hook.m_interface.registerInterruptUser = &EpicsInterfaceImpl::registerInterruptUser<hook_t, pHook>;
+    hook.m_interface.cancelInterruptUser = &EpicsInterfaceImpl::cancelInterruptUser<hook_t, pHook>;
+    pAsynInterface->pinterface = &hook.m_interface;
+}
+
+
+/*
+ * Called when an asyn client registers for interrupts
+ *
+ *****************************************************/
+template<typename hook_t, hook_t EpicsInterfaceImpl::*pHook>
+asynStatus EpicsInterfaceImpl::registerInterruptUser(void* drvPvt, asynUser* pasynUser,
+                                                     typename hook_t::callback_t callback, void* userPvt, void** registrarPvt)
+{
+    hook_t& hook = static_cast<EpicsAsynPortImpl*>((asynPortDriver*)drvPvt)->getInterfaceImpl()->*pHook;
+
+    asynStatus status = hook.m_pOriginal->registerInterruptUser(drvPvt, pasynUser, callback, userPvt, registrarPvt);
+    if(status != asynSuccess)
+    {
+        return status;
+    }
+
+    // Only the clients on address 0 receive the pushed values
+    int addr;
+    pasynManager->getAddr(pasynUser, &addr);
+    if(addr != 0 || pasynUser->reason < 0)
+    {
+        return status;
+    }
+
+    typename hook_t::interrupt_t* pInterrupt = (typename hook_t::interrupt_t*)((interruptNode*)*registrarPvt)->drvPvt;
+
+    // The deliveries in progress keep the previous list
+    std::lock_guard<std::mutex> lock(hook.m_lock);
+    if((size_t)pasynUser->reason >= hook.m_subscribers.size())
+    {
+        hook.m_subscribers.resize(pasynUser->reason + 1);
+    }
+    std::shared_ptr<const typename hook_t::subscribers_t>& pSubscribers(hook.m_subscribers[pasynUser->reason]);
+    std::shared_ptr<typename hook_t::subscribers_t> pNewSubscribers(pSubscribers.get() == 0 ?
+                                                                        new typename hook_t::subscribers_t :
+                                                                        new typename hook_t::subscribers_t(*pSubscribers));
+    pNewSubscribers->push_back(pInterrupt);
+    pSubscribers = pNewSubscribers;
+
+    return status;
+}
+
+
+/*
+ * Called when an asyn client unregisters from the interrupts
+ *
+ * The client is removed from the index before asyn releases it: we wait
+ *  for the deliveries of the other threads that may still call it. When
+ *  the client is cancelled from a callback the deliveries of the calling
+ *  thread skip it instead.
  *
  *************************************************************************/
-typedef std::pair<std::string, std::string> dataTypeAndFTVL_t;
+template<typename hook_t, hook_t EpicsInterfaceImpl::*pHook>
+asynStatus EpicsInterfaceImpl::cancelInterruptUser(void* drvPvt, asynUser* pasynUser, void* registrarPvt)
+{
+    hook_t& hook = static_cast<EpicsAsynPortImpl*>((asynPortDriver*)drvPvt)->getInterfaceImpl()->*pHook;
+
+    typename hook_t::interrupt_t* pInterrupt = (typename hook_t::interrupt_t*)((interruptNode*)registrarPvt)->drvPvt;
+
+    {
+        std::unique_lock<std::mutex> lock(hook.m_lock);
+        for(size_t scanReasons(0), endReasons(hook.m_subscribers.size()); scanReasons != endReasons; ++scanReasons)
+        {
+            std::shared_ptr<const typename hook_t::subscribers_t>& pSubscribers(hook.m_subscribers[scanReasons]);
+            if(pSubscribers.get() == 0 || std::find(pSubscribers->begin(), pSubscribers->end(), pInterrupt) == pSubscribers->end())
+            {
+                continue;
+            }
+            std::shared_ptr<typename hook_t::subscribers_t> pNewSubscribers(new typename hook_t::subscribers_t(*pSubscribers));
+            pNewSubscribers->erase(std::find(pNewSubscribers->begin(), pNewSubscribers->end(), pInterrupt));
+            pSubscribers = pNewSubscribers;
+        }
+
+        const std::thread::id thisThread(std::this_thread::get_id());
+        for(;;)
+        {
+            bool otherDeliveries(false);
+            for(typename hook_t::delivery_t* pDelivery(hook.m_pDeliveries); pDelivery != 0; pDelivery = pDelivery->m_pNext)
+            {
+                const typename hook_t::subscribers_t& subscribers(*pDelivery->m_pSubscribers);
+                if(std::find(subscribers.begin(), subscribers.end(), pInterrupt) == subscribers.end())
+                {
+                    continue;
+                }
+                if(pDelivery->m_thread != thisThread)
+                {
+                    otherDeliveries = true;
+                }
+                else if(std::find(pDelivery->m_cancelled.begin(), pDelivery->m_cancelled.end(), pInterrupt) == pDelivery->m_cancelled.end())
+                {
+                    pDelivery->m_cancelled.push_back(pInterrupt);
+                }
+            }
+            if(!otherDeliveries)
+            {
+                break;
+            }
+            ++hook.m_waitingCancels;
+            hook.m_deliveryDone.wait(lock);
+            --hook.m_waitingCancels;
+        }
+    }
+
+    return hook.m_pOriginal->cancelInterruptUser(drvPvt, pasynUser, registrarPvt);
+}
+
+
+/*
+ * Types table: for each NDS value type the asyn interface that carries it
+ *  and the records that display it.
+ *
+ * The push(), read and write functions and the db generation use this
+ *  table: a new type needs one line here, the asyn overrides and the push()
+ *  overload that forward to the generic functions.
+ *
+ ***************************************************************************/
+#define NDS_EPICS_TYPE_TRAITS(valueType, asynType, hookMember, inRecord, outRecord, inDeviceType, outDeviceType, ftvlString) \
+template<> \
+struct EpicsInterfaceImpl::typeTraits_t<valueType> \
+{ \
+    typedef asynType asyn_t; \
+    static auto getHook(EpicsInterfaceImpl& epicsInterface) -> decltype((epicsInterface.hookMember)) { return epicsInterface.hookMember; } \
+    static const char* inputRecord() { return inRecord; } \
+    static const char* outputRecord() { return outRecord; } \
+    static const char* inputDeviceType() { return inDeviceType; } \
+    static const char* outputDeviceType() { return outDeviceType; } \
+    static const char* ftvl() { return ftvlString; } \
+};
+
+//                    NDS type                      asyn type     hook                input rec.  output rec. input DTYP             output DTYP             FTVL
+NDS_EPICS_TYPE_TRAITS(std::int32_t,                 epicsInt32,   m_int32Hook,        "longin",   "longout",  "asynInt32",           "asynInt32",            "")
+NDS_EPICS_TYPE_TRAITS(double,                       epicsFloat64, m_float64Hook,      "ai",       "ao",       "asynFloat64",         "asynFloat64",          "")
+NDS_EPICS_TYPE_TRAITS(std::vector<std::int8_t>,     epicsInt8,    m_int8ArrayHook,    "waveform", "waveform", "asynInt8ArrayIn",     "asynInt8ArrayOut",     "CHAR")
+NDS_EPICS_TYPE_TRAITS(std::vector<std::uint8_t>,    epicsInt8,    m_int8ArrayHook,    "waveform", "waveform", "asynInt8ArrayIn",     "asynInt8ArrayOut",     "UCHAR")
+NDS_EPICS_TYPE_TRAITS(std::vector<std::int32_t>,    epicsInt32,   m_int32ArrayHook,   "waveform", "waveform", "asynInt32ArrayIn",    "asynInt32ArrayOut",    "LONG")
+NDS_EPICS_TYPE_TRAITS(std::vector<double>,          epicsFloat64, m_float64ArrayHook, "waveform", "waveform", "asynFloat64ArrayIn",  "asynFloat64ArrayOut",  "DOUBLE")
+NDS_EPICS_TYPE_TRAITS(std::string,                  epicsInt8,    m_int8ArrayHook,    "waveform", "waveform", "asynInt8ArrayIn",     "asynInt8ArrayOut",     "CHAR")
+#ifdef NDS3_EXTENDED_DATA_TYPES
+NDS_EPICS_TYPE_TRAITS(std::vector<std::int16_t>,    epicsInt16,   m_int16ArrayHook,   "waveform", "waveform", "asynInt16ArrayIn",    "asynInt16ArrayOut",    "SHORT")
+NDS_EPICS_TYPE_TRAITS(std::vector<std::uint16_t>,   epicsInt16,   m_int16ArrayHook,   "waveform", "waveform", "asynInt16ArrayIn",    "asynInt16ArrayOut",    "USHORT")
+NDS_EPICS_TYPE_TRAITS(std::vector<float>,           epicsFloat32, m_float32ArrayHook, "waveform", "waveform", "asynFloat32ArrayIn",  "asynFloat32ArrayOut",  "FLOAT")
+NDS_EPICS_TYPE_TRAITS(std::int64_t,                 epicsInt64,   m_int64Hook,        "int64in",  "int64out", "asynInt64",           "asynInt64",            "")
+NDS_EPICS_TYPE_TRAITS(std::vector<std::int64_t>,    epicsInt64,   m_int64ArrayHook,   "waveform", "waveform", "asynInt64ArrayIn",    "asynInt64ArrayOut",    "INT64")
+#endif
+
+#undef NDS_EPICS_TYPE_TRAITS
+
+
+/*
+ * Record type, DTYP and FTVL of a PV
+ *
+ ************************************/
 struct recordDataFTVL_t
 {
     recordDataFTVL_t(const std::string& recordType, const std::string& dataType, const std::string ftvl):
@@ -100,86 +526,82 @@ struct recordDataFTVL_t
     std::string m_ftvl;
 };
 
-recordDataFTVL_t dataTypeToEpicsString(const PVBaseImpl& pv)
+template<typename T>
+static recordDataFTVL_t getRecordFromTraits(const PVBaseImpl& pv)
 {
+    typedef EpicsInterfaceImpl::typeTraits_t<T> traits_t;
     if(pv.getDataDirection() == dataDirection_t::input)
     {
-        switch(pv.getDataType())
-        {
-        case dataType_t::dataInt32:
-            if(pv.getEnumerations().empty())
-            {
-                return recordDataFTVL_t("longin", "asynInt32", "");
-            }
-            else
-            {
-                return recordDataFTVL_t("mbbi", "asynInt32", "");
-            }
-        case dataType_t::dataFloat64:
-            return recordDataFTVL_t("ai", "asynFloat64", "");
-        case dataType_t::dataInt8Array:
-            return recordDataFTVL_t("waveform", "asynInt8ArrayIn", "CHAR");
-        case dataType_t::dataUint8Array:
-            return recordDataFTVL_t("waveform", "asynInt8ArrayIn", "UCHAR");
-        case dataType_t::dataInt32Array:
-            return recordDataFTVL_t("waveform", "asynInt32ArrayIn", "LONG");
-        case dataType_t::dataFloat64Array:
-            return recordDataFTVL_t("waveform", "asynFloat64ArrayIn", "DOUBLE");
-        case dataType_t::dataString:
-            return recordDataFTVL_t("waveform", "asynInt8ArrayIn", "CHAR");
-        }
-        throw std::logic_error("Unknown data type");
-
+        return recordDataFTVL_t(traits_t::inputRecord(), traits_t::inputDeviceType(), traits_t::ftvl());
     }
-    else
+    return recordDataFTVL_t(traits_t::outputRecord(), traits_t::outputDeviceType(), traits_t::ftvl());
+}
+
+
+/*
+ * Convert a data type from enum to string.
+ *
+ * We use a switch and not a map for the conversion so we receive warnings
+ *  if we forget a conversion.
+ *
+ *************************************************************************/
+recordDataFTVL_t dataTypeToEpicsString(const PVBaseImpl& pv)
+{
+    switch(pv.getDataType())
     {
-        switch(pv.getDataType())
+    case dataType_t::dataInt32:
+        if(!pv.getEnumerations().empty())
         {
-        case dataType_t::dataInt32:
-            if(pv.getEnumerations().empty())
-            {
-                return recordDataFTVL_t("longout", "asynInt32", "");
-            }
-            else
-            {
-                return recordDataFTVL_t("mbbo", "asynInt32", "");
-            }
-        case dataType_t::dataFloat64:
-            return recordDataFTVL_t("ao", "asynFloat64", "");
-        case dataType_t::dataInt8Array:
-            return recordDataFTVL_t("waveform", "asynInt8ArrayOut", "CHAR");
-        case dataType_t::dataUint8Array:
-            return recordDataFTVL_t("waveform", "asynInt8ArrayOut", "UCHAR");
-        case dataType_t::dataInt32Array:
-            return recordDataFTVL_t("waveform", "asynInt32ArrayOut", "LONG");
-        case dataType_t::dataFloat64Array:
-            return recordDataFTVL_t("waveform", "asynFloat64ArrayOut", "DOUBLE");
-        case dataType_t::dataString:
-            return recordDataFTVL_t("waveform", "asynInt8ArrayOut", "CHAR");
+            return recordDataFTVL_t(pv.getDataDirection() == dataDirection_t::input ? "mbbi" : "mbbo", "asynInt32", "");
         }
-        throw std::logic_error("Unknown data type");
-
+        return getRecordFromTraits<std::int32_t>(pv);
+    case dataType_t::dataFloat64:
+        return getRecordFromTraits<double>(pv);
+    case dataType_t::dataInt8Array:
+        return getRecordFromTraits<std::vector<std::int8_t> >(pv);
+    case dataType_t::dataUint8Array:
+        return getRecordFromTraits<std::vector<std::uint8_t> >(pv);
+    case dataType_t::dataInt32Array:
+        return getRecordFromTraits<std::vector<std::int32_t> >(pv);
+    case dataType_t::dataFloat64Array:
+        return getRecordFromTraits<std::vector<double> >(pv);
+    case dataType_t::dataString:
+        return getRecordFromTraits<std::string>(pv);
+#ifdef NDS3_EXTENDED_DATA_TYPES
+    case dataType_t::dataInt16Array:
+        return getRecordFromTraits<std::vector<std::int16_t> >(pv);
+    case dataType_t::dataUint16Array:
+        return getRecordFromTraits<std::vector<std::uint16_t> >(pv);
+    case dataType_t::dataFloat32Array:
+        return getRecordFromTraits<std::vector<float> >(pv);
+    case dataType_t::dataInt64:
+        return getRecordFromTraits<std::int64_t>(pv);
+    case dataType_t::dataInt64Array:
+        return getRecordFromTraits<std::vector<std::int64_t> >(pv);
+#endif
     }
+    throw std::logic_error("Unknown data type");
 }
 
 
 /*
- * Register a PV and generated the db file
+ * Register a PV and define its records
  *
  *****************************************/
 void EpicsInterfaceImpl::registerPV(std::shared_ptr<PVBaseImpl> pv)
 {
-    // Save the PV in a list. The order in the is used as "reason".
-    ///////////////////////////////////////////////////////////////
-    m_pvs.push_back(pv);
-    m_pvNameToReason[pv->getFullNameFromPort()] = m_pvs.size() - 1;
+    // Assign a reason to the PV. The reason is used as index by the asyn
+    //  requests and by the pushes
+    ///////////////////////////////////////////////////////////////////////
+    bool reused(false);
+    size_t reason(allocateReason(pv, &reused));
 
-    // Auto generate a db file
+    // Define the records, created by registrationTerminated()
     //////////////////////////////////////////////////////////////////////////
     recordDataFTVL_t recordDataFTVL = dataTypeToEpicsString(*(pv.get()));
 
     int portAddress(0);
-    std::ostringstream dbEntry;
+    std::string linkPortName(isNonBlocking(*pv) ? getSynchronousPortName() : getShardPortName(reason));
 
     std::string externalName(pv->getFullExternalName());
 
@@ -198,22 +620,24 @@ void EpicsInterfaceImpl::registerPV(std::shared_ptr<PVBaseImpl> pv)
         break;
     }
 
-    dbEntry << "record(" << recordDataFTVL.m_recordType << ", \"" << externalName << "\") {" << std::endl;
-    dbEntry << "    field(DESC, \"" << pv->getDescription() << "\")" << std::endl;
-    dbEntry << "    field(DTYP, \"" << recordDataFTVL.m_dataType << "\")" << std::endl;
+    recordDefinition_t record(recordDataFTVL.m_recordType, externalName);
+    record.addField("DESC", pv->getDescription());
+    record.addField("DTYP", recordDataFTVL.m_dataType);
 
     if(!recordDataFTVL.m_ftvl.empty())
     {
-        dbEntry << "    field(FTVL, \"" << recordDataFTVL.m_ftvl << "\")" << std::endl;
+        record.addField("FTVL", recordDataFTVL.m_ftvl);
     }
 
     size_t maxElements(pv->getMaxElements());
     if(maxElements > 1)
     {
-        dbEntry << "    field(NELM, " << maxElements << ")" << std::endl;
+        std::ostringstream nelm;
+        nelm << maxElements;
+        record.addField("NELM", nelm.str());
     }
 
-    dbEntry << "    field(SCAN, \"" << scanType.str() << "\")" << std::endl;
+    record.addField("SCAN", scanType.str());
 
     if(pv->getProcessAtInit())
     {
@@ -221,13 +645,15 @@ void EpicsInterfaceImpl::registerPV(std::shared_ptr<PVBaseImpl> pv)
     }
 
     // Add INP/OUT fields
+    std::ostringstream link;
+    link << "@asyn(" << linkPortName << ", " << portAddress<< ")" << pv->getFullNameFromPort();
     if(pv->getDataDirection() == dataDirection_t::input || recordDataFTVL.m_recordType == "waveform")
     {
-        dbEntry << "    field(INP, \"@asyn(" << pv->getPort()->getFullName() << ", " << portAddress<< ")" << pv->getFullNameFromPort() << "\")" << std::endl;
+        record.addField("INP", link.str());
     }
     else
     {
-        dbEntry << "    field(OUT, \"@asyn(" << pv->getPort()->getFullName() << ", " << portAddress<< ")" << pv->getFullNameFromPort() << "\")" << std::endl;
+        record.addField("OUT", link.str());
     }
 
     // Add enumerations
@@ -236,14 +662,40 @@ void EpicsInterfaceImpl::registerPV(std::shared_ptr<PVBaseImpl> pv)
     size_t enumNumber(0);
     for(enumerationStrings_t::const_iterator scanStrings(enumerations.begin()), endScan(enumerations.end()); scanStrings != endScan; ++scanStrings)
     {
-        dbEntry << "    field(" << epicsEnumNames[enumNumber] << "VL, " << enumNumber << ")" << std::endl;
-        dbEntry << "    field(" << epicsEnumNames[enumNumber] << "ST, \"" << *scanStrings << "\")" << std::endl;
+        std::ostringstream enumValue;
+        enumValue << enumNumber;
+        record.addField(std::string(epicsEnumNames[enumNumber]) + "VL", enumValue.str());
+        record.addField(std::string(epicsEnumNames[enumNumber]) + "ST", *scanStrings);
         enumNumber++;
     }
 
-    dbEntry << "}" << std::endl << std::endl;
-    dbEntry.flush();
+    // A reused reason is already linked to its records
+    if(!reused)
+    {
+        m_records.push_back(record);
+    }
+
+    // Add the waveform with the statistics of the PV's reason
+    double statisticsScanSeconds(0);
+    if(dynamic_cast<EpicsStatisticsPV*>(pv.get()) == 0 &&
+       m_pEpicsFactory->getPvStatsRecordsSettings(externalName, &statisticsScanSeconds))
+    {
+        const EpicsPvStatistics* pStatistics;
+        {
+            std::lock_guard<std::mutex> lock(m_registrationLock);
+            pStatistics = &m_reasons[reason]->m_statistics;
+        }
+
+        std::shared_ptr<EpicsStatisticsPV> statisticsPV(new EpicsStatisticsPV(pv->getComponentName() + "_stats", *pStatistics));
+        statisticsPV->setScanType(scanType_t::periodic, statisticsScanSeconds);
+        statisticsPV->setMaxElements(EpicsStatisticsPV::numElements);
+        statisticsPV->setDescription("Statistics of " + externalName);
+        statisticsPV->setParent(pv->getParent(), pv->getNodeLevel());
+        statisticsPV->initialize(*m_pEpicsFactory);
 
+        std::lock_guard<std::mutex> lock(m_registrationLock);
+        m_statisticsPVs[pv.get()] = statisticsPV;
+    }
 
     PVActionImpl* actionPV = dynamic_cast<PVActionImpl*>(pv.get());
     if(actionPV)
@@ -266,149 +718,1146 @@ void EpicsInterfaceImpl::registerPV(std::shared_ptr<PVBaseImpl> pv)
 
         actionPV->setAcknowledgePV(feedback);
 
+        {
+            std::lock_guard<std::mutex> lock(m_registrationLock);
+            m_feedbackPVs[pv.get()] = fb;
+        }
+
+        if(reused)
+        {
+            return;
+        }
+
         //Add FLNK field for feedback record
-        dbEntry << "record(longin, \"" << feedbackExternalName.str() << "\") {" << std::endl;
-        dbEntry << "    field(FLNK, \"" << calculationExternalName.str() << "\")" << std::endl;
-        dbEntry << "}" << std::endl << std::endl;
+        recordDefinition_t feedbackRecord("longin", feedbackExternalName.str());
+        feedbackRecord.addField("FLNK", calculationExternalName.str());
+        m_records.push_back(feedbackRecord);
 
         //Build calcout record
-        dbEntry << "record(calcout, \"" << calculationExternalName.str() << "\") {" << std::endl;
-        dbEntry << "    field(DESC, \"Calculation for" << externalName << "\")" << std::endl;
-        dbEntry << "    field(SCAN, \"Passive\")" << std::endl;
-        dbEntry << "    field(INPA, \"" << feedbackExternalName.str() << "\")" << std::endl;
-        dbEntry << "    field(CALC, \"A\")" << std::endl;
-        dbEntry << "    field(OOPT, \"Every Time\")" << std::endl;
-        dbEntry << "    field(OUT, \"" << externalName << "\")" << std::endl;
-        dbEntry << "}" << std::endl << std::endl;
-
-        dbEntry.flush();
+        recordDefinition_t calculationRecord("calcout", calculationExternalName.str());
+        calculationRecord.addField("DESC", "Calculation for" + externalName);
+        calculationRecord.addField("SCAN", "Passive");
+        calculationRecord.addField("INPA", feedbackExternalName.str());
+        calculationRecord.addField("CALC", "A");
+        calculationRecord.addField("OOPT", "Every Time");
+        calculationRecord.addField("OUT", externalName);
+        m_records.push_back(calculationRecord);
     }
-
-    m_autogeneratedDB += dbEntry.str();
 }
 
+/*
+ * Deregister a PV. Its reason and records are kept for a PV registered
+ *  later with the same name
+ *
+ **********************************************************************/
 void EpicsInterfaceImpl::deregisterPV(std::shared_ptr<PVBaseImpl> pv)
 {
-    // TODO
-}
+    reasonEntry_t* pEntry(0);
+    std::shared_ptr<PVBaseImpl> pFeedback;
+    std::shared_ptr<PVBaseImpl> pStatisticsPV;
+    {
+        std::lock_guard<std::mutex> lock(m_registrationLock);
+        pvToReason_t::iterator findReason = m_pvToReason.find(pv.get());
+        if(findReason == m_pvToReason.end())
+        {
+            return;
+        }
+        pEntry = m_reasons[findReason->second].get();
+        m_pvToReason.erase(findReason);
 
+        feedbackPVs_t::iterator findFeedback = m_feedbackPVs.find(pv.get());
+        if(findFeedback != m_feedbackPVs.end())
+        {
+            pFeedback = findFeedback->second;
+            m_feedbackPVs.erase(findFeedback);
+        }
 
-/*
- * Called after the registration of the PVs has been performed
- *
- *************************************************************/
-void EpicsInterfaceImpl::registrationTerminated()
-{
-    char tmpBuffer[L_tmpnam];
+        feedbackPVs_t::iterator findStatistics = m_statisticsPVs.find(pv.get());
+        if(findStatistics != m_statisticsPVs.end())
+        {
+            pStatisticsPV = findStatistics->second;
+            m_statisticsPVs.erase(findStatistics);
+        }
+
+        pEntry->m_registered = false;
+        pEntry->m_releasePending = true;
+    }
 
-    std::string tmpFileName(tmpnam_r(tmpBuffer));
+    // Remove the PV from the snapshot before it is released: a PV allocated
+    //  later at the same address must not be routed to this reason, which
+    //  may meanwhile be given to the PV that replaces this one
+    publishReasons();
 
-    std::string fileName(tmpFileName);
-    std::ofstream outputStream(fileName.c_str());
-    outputStream << m_autogeneratedDB;
-    outputStream.flush();
+    // New reads, writes and pushes are refused. The PV is released by the
+    //  last call in progress: when the PV is deregistered from one of its
+    //  own calls (e.g. a write that destroys the device) the release is
+    //  left to that call, otherwise wait for it
+    std::shared_ptr<PVBaseImpl> pReleasedPV;
+    {
+        std::unique_lock<std::mutex> lock(m_registrationLock);
+        if(pEntry->m_activeCalls == 0)
+        {
+            releaseEntry(*pEntry, &pReleasedPV);
+        }
+        else if(!reasonGuard_t::isHeldByThisThread(pEntry))
+        {
+            m_releasedCondition.wait(lock, [pEntry]{ return !pEntry->m_releasePending; });
+        }
+    }
+    pReleasedPV.reset();
 
-    std::string command("dbLoadDatabase ");
-    command += tmpFileName;
-    iocshCmd(command.c_str());
+    if(pFeedback.get() != 0)
+    {
+        deregisterPV(pFeedback);
+    }
+    if(pStatisticsPV.get() != 0)
+    {
+        deregisterPV(pStatisticsPV);
+    }
 }
 
 
-void EpicsInterfaceImpl::push(const PVBaseImpl& pv, const timespec& timestamp, const std::int32_t& value)
+/*
+ * Assign a reason to a PV
+ *
+ *************************/
+size_t EpicsInterfaceImpl::allocateReason(const std::shared_ptr<PVBaseImpl>& pv, bool* pReused)
 {
-    pushOneValue<epicsInt32, asynInt32Interrupt>(pv, timestamp, (epicsInt32)value, asynStdInterfaces.int32InterruptPvt);
-}
+    std::string name(pv->getFullNameFromPort());
 
-void EpicsInterfaceImpl::push(const PVBaseImpl& pv, const timespec& timestamp, const double& value)
+    std::lock_guard<std::mutex> lock(m_registrationLock);
+
+    // The reason of a deregistered PV is free once its last call has
+    //  released the PV
+    size_t reason;
+    nameToReason_t::const_iterator findName = m_nameToReason.find(name);
+    if(findName != m_nameToReason.end() && m_reasons[findName->second]->m_pPV.get() == 0)
+    {
+        reason = findName->second;
+        *pReused = true;
+    }
+    else
+    {
+        reason = m_reasons.size();
+        m_reasons.push_back(std::unique_ptr<reasonEntry_t>(new reasonEntry_t(name)));
+
+        // The readers use the histograms without acquiring the reason: they
+        //  are allocated before the entry is published and then kept
+        if(m_pEpicsFactory->hasLatencyHistograms(pv->getFullExternalName()))
+        {
+            m_reasons.back()->m_pLatency.reset(new EpicsLatencyHistograms);
+        }
+
+        // With duplicated names the first PV wins
+        m_nameToReason.insert(std::make_pair(name, reason));
+        *pReused = false;
+    }
+
+    reasonEntry_t& entry(*m_reasons[reason]);
+    entry.m_pPV = pv;
+#ifdef NDS3_EXTENDED_DATA_TYPES
+    entry.m_unsignedElements = (pv->getDataType() == dataType_t::dataUint16Array);
+#endif
+
+    pushFilterSettings_t filterSettings;
+    if(m_pEpicsFactory->getPushFilterSettings(pv->getFullExternalName(), &filterSettings))
+    {
+        entry.m_pPushFilter.reset(new EpicsPushFilter(filterSettings));
+    }
+
+    double cacheMaxAge(0);
+    if(m_pEpicsFactory->getValueCacheSettings(pv->getFullExternalName(), &cacheMaxAge))
+    {
+        entry.m_pValueCache.reset(new EpicsValueCache(cacheMaxAge));
+    }
+
+    m_pvToReason[pv.get()] = reason;
+
+    // The readers see the entry's members once the flag is set
+    entry.m_registered = true;
+
+    return reason;
+}
+
+
+/*
+ * Publish a new snapshot of the reasons. The old snapshot is deleted once
+ *  its readers are gone
+ *
+ *************************************************************************/
+void EpicsInterfaceImpl::publishReasons()
 {
-    pushOneValue<epicsFloat64, asynFloat64Interrupt>(pv, timestamp, (epicsFloat64)value, asynStdInterfaces.float64InterruptPvt);
+    std::lock_guard<std::mutex> lock(m_registrationLock);
+
+    std::unique_ptr<reasonTable_t> pTable(new reasonTable_t);
+    pTable->m_entries.reserve(m_reasons.size());
+    for(std::vector<std::unique_ptr<reasonEntry_t> >::const_iterator scanReasons(m_reasons.begin()), endReasons(m_reasons.end());
+        scanReasons != endReasons;
+        ++scanReasons)
+    {
+        pTable->m_entries.push_back(scanReasons->get());
+    }
+    pTable->m_pvToReason = m_pvToReason;
+
+    // The dispatcher must know the reasons before they are pushed
+    if(m_pPushDispatcher.get() != 0)
+    {
+        m_pPushDispatcher->setNumReasons(m_reasons.size());
+    }
+
+    m_reasonTable.publish(std::move(pTable));
+}
+
+
+/*
+ * Protect a reason's PV from the deregistration
+ *
+ ***********************************************/
+EpicsInterfaceImpl::reasonEntry_t* EpicsInterfaceImpl::acquireReason(size_t reason) const
+{
+    return acquireEntry(getPublishedEntry(reason));
+}
+
+
+EpicsInterfaceImpl::reasonEntry_t* EpicsInterfaceImpl::acquireReason(const PVBaseImpl& pv, size_t* pReason) const
+{
+    reasonEntry_t* pEntry(0);
+    {
+        EpicsSnapshot<reasonTable_t>::reader_t table(m_reasonTable);
+        if(table.get() == 0)
+        {
+            return 0;
+        }
+        pvToReason_t::const_iterator findReason = table->m_pvToReason.find(&pv);
+        if(findReason == table->m_pvToReason.end())
+        {
+            return 0;
+        }
+        *pReason = findReason->second;
+        pEntry = table->m_entries[findReason->second];
+    }
+    return acquireEntry(pEntry);
 }
 
-void EpicsInterfaceImpl::push(const PVBaseImpl& pv, const timespec& timestamp, const std::vector<std::int32_t> & value)
-{
-    pushArray<epicsInt32, asynInt32ArrayInterrupt>(pv, timestamp, (epicsInt32*)value.data(), value.size(), asynStdInterfaces.int32ArrayInterruptPvt);
-}
 
-void EpicsInterfaceImpl::push(const PVBaseImpl& pv, const timespec& timestamp, const std::vector<double> & value)
-{
-    pushArray<epicsFloat64, asynFloat64ArrayInterrupt>(pv, timestamp, (epicsFloat64*)value.data(), value.size(), asynStdInterfaces.float64ArrayInterruptPvt);
-}
+EpicsInterfaceImpl::reasonEntry_t* EpicsInterfaceImpl::acquireEntry(reasonEntry_t* pEntry) const
+{
+    if(pEntry == 0)
+    {
+        return 0;
+    }
+
+    // deregisterPV() clears the flag and then the PV is released when
+    //  m_activeCalls drops to zero: both use sequentially consistent operations
+    ++pEntry->m_activeCalls;
+    if(!pEntry->m_registered)
+    {
+        releaseCall(pEntry);
+        return 0;
+    }
+    return pEntry;
+}
+
+
+/*
+ * Terminate a call on a reason. The last call on a deregistered PV
+ *  releases it
+ *
+ ******************************************************************/
+void EpicsInterfaceImpl::releaseCall(reasonEntry_t* pEntry) const
+{
+    if(--pEntry->m_activeCalls != 0 || pEntry->m_registered)
+    {
+        return;
+    }
+
+    std::shared_ptr<PVBaseImpl> pReleasedPV;
+    {
+        std::lock_guard<std::mutex> lock(m_registrationLock);
+        if(pEntry->m_releasePending && pEntry->m_activeCalls == 0)
+        {
+            releaseEntry(*pEntry, &pReleasedPV);
+        }
+    }
+}
+
+
+void EpicsInterfaceImpl::releaseEntry(reasonEntry_t& entry, std::shared_ptr<PVBaseImpl>* pPV) const
+{
+    pPV->swap(entry.m_pPV);
+    entry.m_pPushFilter.reset();
+    entry.m_pValueCache.reset();
+    entry.m_releasePending = false;
+    m_releasedCondition.notify_all();
+}
+
+
+thread_local EpicsInterfaceImpl::reasonGuard_t* EpicsInterfaceImpl::reasonGuard_t::m_pLastGuard(0);
+
+bool EpicsInterfaceImpl::reasonGuard_t::isHeldByThisThread(const reasonEntry_t* pEntry)
+{
+    for(const reasonGuard_t* pGuard(m_pLastGuard); pGuard != 0; pGuard = pGuard->m_pPrevious)
+    {
+        if(pGuard->m_pEntry == pEntry)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+/*
+ * Called after the registration of the PVs has been performed
+ *
+ *************************************************************/
+void EpicsInterfaceImpl::registrationTerminated()
+{
+    publishReasons();
+
+    if(m_pEpicsFactory->isIocInitialized())
+    {
+        // EPICS doesn't support the creation of records after iocInit: only
+        //  the PVs that took over the reason of a deregistered PV have records
+        for(records_t::const_iterator scanRecords(m_records.begin()), endRecords(m_records.end());
+            scanRecords != endRecords;
+            ++scanRecords)
+        {
+            errlogSevPrintf(errlogMinor, "Cannot create the record %s after iocInit: restart the IOC to access it\n", scanRecords->m_name.c_str());
+        }
+        m_records.clear();
+
+        m_pEpicsFactory->processPendingRecords();
+        return;
+    }
+
+    timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    m_numRecords += m_records.size();
+    m_recordsFromCache = loadOrCreateRecords();
+    m_records.clear();
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    m_recordsCreationSeconds += (double)(end.tv_sec - start.tv_sec) + (double)(end.tv_nsec - start.tv_nsec) / 1.0e9;
+}
+
+
+/*
+ * Load the records from the cache or create them
+ *
+ ************************************************/
+bool EpicsInterfaceImpl::loadOrCreateRecords()
+{
+    const std::string& cacheDirectory(m_pEpicsFactory->getDatabaseCacheDirectory());
+    if(cacheDirectory.empty())
+    {
+        createRecords();
+        return false;
+    }
+
+    // Load the database generated by a previous run if the records didn't
+    //  change, otherwise create the records and update the cache
+    std::string fileName(cacheDirectory + "/" + getPortName() + ".db");
+    std::uint64_t hash(hashRecords());
+    std::uint64_t cachedHash;
+    if(readDatabaseHash(fileName, &cachedHash) && cachedHash == hash)
+    {
+        if(dbLoadDatabase(fileName.c_str(), 0, 0) == 0)
+        {
+            return true;
+        }
+        errlogSevPrintf(errlogMinor, "Cannot load the cached database %s, creating the records\n", fileName.c_str());
+    }
+
+    createRecords();
+    writeDatabase(fileName, hash);
+    return false;
+}
+
+
+/*
+ * Create the records in process: no db file has to be written and parsed
+ *
+ ************************************************************************/
+void EpicsInterfaceImpl::createRecords()
+{
+    DBENTRY entry;
+    dbInitEntry(pdbbase, &entry);
+    try
+    {
+        for(records_t::const_iterator scanRecords(m_records.begin()), endRecords(m_records.end());
+            scanRecords != endRecords;
+            ++scanRecords)
+        {
+            createRecord(&entry, *scanRecords);
+        }
+    }
+    catch(...)
+    {
+        dbFinishEntry(&entry);
+        throw;
+    }
+    dbFinishEntry(&entry);
+}
+
+
+/*
+ * Create one record with the dbStatic API
+ *
+ *****************************************/
+void EpicsInterfaceImpl::createRecord(DBENTRY* pEntry, const recordDefinition_t& record)
+{
+    if(dbFindRecordType(pEntry, record.m_recordType.c_str()) != 0)
+    {
+        throw std::runtime_error("Record type " + record.m_recordType + " not found while creating the record " + record.m_name);
+    }
+
+    // A record defined twice (e.g. the feedback of the actions) is merged
+    //  with the previous definition, as dbLoadDatabase does
+    if(dbFindRecord(pEntry, record.m_name.c_str()) != 0 && dbCreateRecord(pEntry, record.m_name.c_str()) != 0)
+    {
+        throw std::runtime_error("Cannot create the record " + record.m_name);
+    }
+
+    for(recordDefinition_t::fields_t::const_iterator scanFields(record.m_fields.begin()), endFields(record.m_fields.end());
+        scanFields != endFields;
+        ++scanFields)
+    {
+        // Like dbLoadDatabase, report the invalid fields and continue
+        if(dbFindField(pEntry, scanFields->first.c_str()) != 0)
+        {
+            errlogSevPrintf(errlogMinor, "Record %s: field %s not found\n", record.m_name.c_str(), scanFields->first.c_str());
+            continue;
+        }
+        if(dbPutString(pEntry, scanFields->second.c_str()) != 0)
+        {
+            errlogSevPrintf(errlogMinor, "Record %s: cannot set field %s to \"%s\"\n",
+                            record.m_name.c_str(), scanFields->first.c_str(), scanFields->second.c_str());
+        }
+    }
+}
+
+
+/*
+ * FNV-1a hash of the record definitions
+ *
+ ***************************************/
+static void hashString(const std::string& string, std::uint64_t* pHash)
+{
+    // The terminator separates consecutive strings
+    for(const char* pCharacter(string.c_str()), *pEnd(pCharacter + string.size() + 1); pCharacter != pEnd; ++pCharacter)
+    {
+        *pHash ^= (unsigned char)*pCharacter;
+        *pHash *= 1099511628211ull;
+    }
+}
+
+std::uint64_t EpicsInterfaceImpl::hashRecords() const
+{
+    std::uint64_t hash(14695981039346656037ull);
+    for(records_t::const_iterator scanRecords(m_records.begin()), endRecords(m_records.end());
+        scanRecords != endRecords;
+        ++scanRecords)
+    {
+        hashString(scanRecords->m_recordType, &hash);
+        hashString(scanRecords->m_name, &hash);
+        for(recordDefinition_t::fields_t::const_iterator scanFields(scanRecords->m_fields.begin()), endFields(scanRecords->m_fields.end());
+            scanFields != endFields;
+            ++scanFields)
+        {
+            hashString(scanFields->first, &hash);
+            hashString(scanFields->second, &hash);
+        }
+        hashString("}", &hash);
+    }
+    return hash;
+}
+
+
+/*
+ * The cached databases start with a comment that contains their hash
+ *
+ ********************************************************************/
+static const char databaseHashHeader[] = "# nds3 records hash ";
+
+bool EpicsInterfaceImpl::readDatabaseHash(const std::string& fileName, std::uint64_t* pHash)
+{
+    std::ifstream inputStream(fileName.c_str());
+    std::string header;
+    if(!std::getline(inputStream, header) || header.compare(0, sizeof(databaseHashHeader) - 1, databaseHashHeader) != 0)
+    {
+        return false;
+    }
+
+    std::istringstream hashStream(header.substr(sizeof(databaseHashHeader) - 1));
+    hashStream >> std::hex >> *pHash;
+    return !hashStream.fail();
+}
+
+
+/*
+ * Write a string field value, escaping the characters that dbLoadDatabase
+ *  would interpret
+ *
+ *************************************************************************/
+static void writeQuoted(std::ostream& outputStream, const std::string& value)
+{
+    outputStream << '"';
+    for(std::string::const_iterator scanCharacters(value.begin()), endCharacters(value.end()); scanCharacters != endCharacters; ++scanCharacters)
+    {
+        if(*scanCharacters == '"' || *scanCharacters == '\\')
+        {
+            outputStream << '\\';
+        }
+        outputStream << *scanCharacters;
+    }
+    outputStream << '"';
+}
+
+void EpicsInterfaceImpl::writeDatabase(const std::string& fileName, std::uint64_t hash) const
+{
+    std::string temporaryFileName(fileName + ".tmp");
+    {
+        std::ofstream outputStream(temporaryFileName.c_str());
+        outputStream << databaseHashHeader << std::hex << hash << std::dec << std::endl;
+        outputStream << "# Generated for the port " << getPortName() << ": do not edit" << std::endl << std::endl;
+
+        for(records_t::const_iterator scanRecords(m_records.begin()), endRecords(m_records.end());
+            scanRecords != endRecords;
+            ++scanRecords)
+        {
+            outputStream << "record(" << scanRecords->m_recordType << ", ";
+            writeQuoted(outputStream, scanRecords->m_name);
+            outputStream << ") {" << std::endl;
+            for(recordDefinition_t::fields_t::const_iterator scanFields(scanRecords->m_fields.begin()), endFields(scanRecords->m_fields.end());
+                scanFields != endFields;
+                ++scanFields)
+            {
+                outputStream << "    field(" << scanFields->first << ", ";
+                writeQuoted(outputStream, scanFields->second);
+                outputStream << ")" << std::endl;
+            }
+            outputStream << "}" << std::endl << std::endl;
+        }
+
+        outputStream.flush();
+        if(outputStream.fail())
+        {
+            errlogSevPrintf(errlogMinor, "Cannot write the database cache %s\n", temporaryFileName.c_str());
+            ::remove(temporaryFileName.c_str());
+            return;
+        }
+    }
+
+    if(::rename(temporaryFileName.c_str(), fileName.c_str()) != 0)
+    {
+        errlogSevPrintf(errlogMinor, "Cannot write the database cache %s\n", fileName.c_str());
+        ::remove(temporaryFileName.c_str());
+    }
+}
+
+
+/*
+ * Constructor
+ *
+ *************/
+EpicsInterfaceImpl::recordDefinition_t::recordDefinition_t(const std::string& recordType, const std::string& name):
+    m_recordType(recordType), m_name(name)
+{
+}
+
+
+void EpicsInterfaceImpl::recordDefinition_t::addField(const std::string& field, const std::string& value)
+{
+    m_fields.push_back(std::make_pair(field, value));
+}
+
+
+void EpicsInterfaceImpl::push(const PVBaseImpl& pv, const timespec& timestamp, const std::int32_t& value)
+{
+    pushValue(pv, timestamp, value);
+}
+
+void EpicsInterfaceImpl::push(const PVBaseImpl& pv, const timespec& timestamp, const double& value)
+{
+    pushValue(pv, timestamp, value);
+}
+
+void EpicsInterfaceImpl::push(const PVBaseImpl& pv, const timespec& timestamp, const std::vector<std::int32_t> & value)
+{
+    pushValue(pv, timestamp, value);
+}
+
+void EpicsInterfaceImpl::push(const PVBaseImpl& pv, const timespec& timestamp, const std::vector<double> & value)
+{
+    pushValue(pv, timestamp, value);
+}
+
+void EpicsInterfaceImpl::push(const PVBaseImpl& pv, const timespec& timestamp, const std::string& value)
+{
+    pushValue(pv, timestamp, value);
+}
+
+void EpicsInterfaceImpl::push(const PVBaseImpl& pv, const timespec& timestamp, const std::vector<std::int8_t> & value)
+{
+    pushValue(pv, timestamp, value);
+}
+
+void EpicsInterfaceImpl::push(const PVBaseImpl& pv, const timespec& timestamp, const std::vector<std::uint8_t> & value)
+{
+    pushValue(pv, timestamp, value);
+}
+
+#ifdef NDS3_EXTENDED_DATA_TYPES
+void EpicsInterfaceImpl::push(const PVBaseImpl& pv, const timespec& timestamp, const std::vector<std::int16_t> & value)
+{
+    pushValue(pv, timestamp, value);
+}
+
+void EpicsInterfaceImpl::push(const PVBaseImpl& pv, const timespec& timestamp, const std::vector<std::uint16_t> & value)
+{
+    pushValue(pv, timestamp, value);
+}
+
+void EpicsInterfaceImpl::push(const PVBaseImpl& pv, const timespec& timestamp, const std::vector<float> & value)
+{
+    pushValue(pv, timestamp, value);
+}
+
+void EpicsInterfaceImpl::push(const PVBaseImpl& pv, const timespec& timestamp, const std::int64_t& value)
+{
+    pushValue(pv, timestamp, value);
+}
+
+void EpicsInterfaceImpl::push(const PVBaseImpl& pv, const timespec& timestamp, const std::vector<std::int64_t> & value)
+{
+    pushValue(pv, timestamp, value);
+}
+#endif
+
+
+/*
+ * Push a value to the asyn interface selected by the types table
+ *
+ ****************************************************************/
+template<typename T>
+void EpicsInterfaceImpl::pushValue(const PVBaseImpl& pv, const timespec& timestamp, const T& value)
+{
+    typedef typeTraits_t<T> traits_t;
+    pushOneValue<typename traits_t::asyn_t>(traits_t::getHook(*this), pv, timestamp, (typename traits_t::asyn_t)value);
+}
+
+template<typename T>
+void EpicsInterfaceImpl::pushValue(const PVBaseImpl& pv, const timespec& timestamp, const std::vector<T>& value)
+{
+    typedef typeTraits_t<std::vector<T> > traits_t;
+    static_assert(sizeof(typename traits_t::asyn_t) == sizeof(T), "The asyn interface must have the same element size");
+    pushArray<typename traits_t::asyn_t>(traits_t::getHook(*this), pv, timestamp, (const typename traits_t::asyn_t*)value.data(), value.size());
+}
+
+void EpicsInterfaceImpl::pushValue(const PVBaseImpl& pv, const timespec& timestamp, const std::string& value)
+{
+    typedef typeTraits_t<std::string> traits_t;
+    pushArray<traits_t::asyn_t>(traits_t::getHook(*this), pv, timestamp, (const traits_t::asyn_t*)value.data(), value.size());
+}
+
+
+/*
+ * Check a pushed scalar with the push filter. The int64 values are compared
+ *  exactly, the other types are exact as doubles
+ *
+ ***************************************************************************/
+template<typename T>
+static bool acceptPushedValue(EpicsPushFilter& filter, const T& value)
+{
+    return filter.acceptValue((double)value);
+}
+
+static bool acceptPushedValue(EpicsPushFilter& filter, const std::int64_t& value)
+{
+    return filter.acceptValue(value);
+}
+
+
+/*
+ * Push a scalar value to EPICS
+ *
+ ******************************/
+template<typename T, typename hook_t>
+void EpicsInterfaceImpl::pushOneValue(hook_t& hook, const PVBaseImpl& pv, const timespec& timestamp, const T& value)
+{
+    size_t reason(0);
+    reasonGuard_t entry(*this, acquireReason(pv, &reason));
+    if(entry.get() == 0)
+    {
+        return;
+    }
+
+    std::uint64_t pushNanoseconds(EpicsPvStatistics::getNanoseconds());
+    timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    recordAcquisitionLatency(*entry.get(), timestamp, now);
+
+    entry->m_statistics.countPush(sizeof(T));
+
+    EpicsValueCache* pCache = entry->m_pValueCache.get();
+    if(pCache != 0)
+    {
+        pCache->storeValue(timestamp, value);
+    }
+
+    EpicsPushFilter* pFilter = entry->m_pPushFilter.get();
+    if(pFilter != 0 && !acceptPushedValue(*pFilter, value))
+    {
+        return;
+    }
+
+    if(m_pPushDispatcher.get() != 0)
+    {
+        queuedPush_t push;
+        push.m_deliver = &EpicsInterfaceImpl::deliverQueuedValue<T, hook_t>;
+        push.m_pHook = &hook;
+        push.m_reason = reason;
+        push.m_timestamp = timestamp;
+        push.m_pushNanoseconds = pushNanoseconds;
+        push.setScalar(value);
+        m_pPushDispatcher->enqueue(push);
+        return;
+    }
+
+    deliverOneValue(hook, reason, timestamp, value, pushNanoseconds);
+}
+
+
+/*
+ * Push an array to EPICS
+ *
+ ************************/
+template<typename T, typename hook_t>
+void EpicsInterfaceImpl::pushArray(hook_t& hook, const PVBaseImpl& pv, const timespec& timestamp, const T* pValue, size_t numElements,
+                                   std::shared_ptr<const void> pOwner)
+{
+    size_t reason(0);
+    reasonGuard_t entry(*this, acquireReason(pv, &reason));
+    if(entry.get() == 0)
+    {
+        return;
+    }
+
+    std::uint64_t pushNanoseconds(EpicsPvStatistics::getNanoseconds());
+    timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    recordAcquisitionLatency(*entry.get(), timestamp, now);
+
+    entry->m_statistics.countPush(numElements * sizeof(T));
+
+    // Unless the driver shares the array it owns pValue only for the
+    //  duration of the push: the cache and the push queue share the same copy
+    EpicsValueCache* pCache = entry->m_pValueCache.get();
+    if(pCache != 0)
+    {
+        if(pOwner.get() == 0)
+        {
+            std::shared_ptr<std::vector<T> > pCopy(new std::vector<T>(pValue, pValue + numElements));
+            pValue = pCopy->data();
+            pOwner = pCopy;
+        }
+        pCache->storeArray<T>(timestamp, pOwner, pValue, numElements);
+    }
+
+    EpicsPushFilter* pFilter = entry->m_pPushFilter.get();
+    if(pFilter != 0 && !pFilter->acceptArray())
+    {
+        return;
+    }
+
+    if(m_pPushDispatcher.get() != 0)
+    {
+        if(pOwner.get() == 0)
+        {
+            std::shared_ptr<std::vector<T> > pCopy(new std::vector<T>(pValue, pValue + numElements));
+            pValue = pCopy->data();
+            pOwner = pCopy;
+        }
+
+        queuedPush_t push;
+        push.m_deliver = &EpicsInterfaceImpl::deliverQueuedArray<T, hook_t>;
+        push.m_pHook = &hook;
+        push.m_reason = reason;
+        push.m_timestamp = timestamp;
+        push.m_pushNanoseconds = pushNanoseconds;
+        push.m_pArrayData = pValue;
+        push.m_numElements = numElements;
+        push.m_pArray = pOwner;
+        m_pPushDispatcher->enqueue(push);
+        return;
+    }
+
+    deliverArray(hook, reason, timestamp, pValue, numElements, pOwner, pushNanoseconds);
+}
+
+
+/*
+ * Push an array owned by the driver
+ *
+ ***********************************/
+template<typename T>
+void EpicsInterfaceImpl::pushSharedArray(const PVBaseImpl& pv, const timespec& timestamp, const std::shared_ptr<const std::vector<T> >& pArray)
+{
+    typedef typeTraits_t<std::vector<T> > traits_t;
+    static_assert(sizeof(typename traits_t::asyn_t) == sizeof(T), "The asyn interface must have the same element size");
+    pushArray<typename traits_t::asyn_t>(traits_t::getHook(*this), pv, timestamp, (const typename traits_t::asyn_t*)pArray->data(), pArray->size(), pArray);
+}
+
+template void EpicsInterfaceImpl::pushSharedArray<std::int8_t>(const PVBaseImpl&, const timespec&, const std::shared_ptr<const std::vector<std::int8_t> >&);
+template void EpicsInterfaceImpl::pushSharedArray<std::uint8_t>(const PVBaseImpl&, const timespec&, const std::shared_ptr<const std::vector<std::uint8_t> >&);
+template void EpicsInterfaceImpl::pushSharedArray<std::int32_t>(const PVBaseImpl&, const timespec&, const std::shared_ptr<const std::vector<std::int32_t> >&);
+template void EpicsInterfaceImpl::pushSharedArray<double>(const PVBaseImpl&, const timespec&, const std::shared_ptr<const std::vector<double> >&);
+#ifdef NDS3_EXTENDED_DATA_TYPES
+template void EpicsInterfaceImpl::pushSharedArray<std::int16_t>(const PVBaseImpl&, const timespec&, const std::shared_ptr<const std::vector<std::int16_t> >&);
+template void EpicsInterfaceImpl::pushSharedArray<std::uint16_t>(const PVBaseImpl&, const timespec&, const std::shared_ptr<const std::vector<std::uint16_t> >&);
+template void EpicsInterfaceImpl::pushSharedArray<float>(const PVBaseImpl&, const timespec&, const std::shared_ptr<const std::vector<float> >&);
+template void EpicsInterfaceImpl::pushSharedArray<std::int64_t>(const PVBaseImpl&, const timespec&, const std::shared_ptr<const std::vector<std::int64_t> >&);
+#endif
+
+
+/*
+ * Take a reference to the subscribers of a reason for a delivery and link
+ *  the delivery in the hook. The subscribers lock must be held
+ *
+ **************************************************************************/
+template<typename hook_t>
+void EpicsInterfaceImpl::startDelivery(hook_t& hook, size_t reason, typename hook_t::delivery_t* pDelivery)
+{
+    if(reason >= hook.m_subscribers.size() || hook.m_subscribers[reason].get() == 0)
+    {
+        return;
+    }
+    pDelivery->m_pSubscribers = hook.m_subscribers[reason];
+    pDelivery->m_thread = std::this_thread::get_id();
+    pDelivery->m_pNext = hook.m_pDeliveries;
+    if(hook.m_pDeliveries != 0)
+    {
+        hook.m_pDeliveries->m_pPrevious = pDelivery;
+    }
+    hook.m_pDeliveries = pDelivery;
+}
+
+template<typename hook_t>
+void EpicsInterfaceImpl::endDelivery(hook_t& hook, typename hook_t::delivery_t* pDelivery)
+{
+    if(pDelivery->m_pSubscribers.get() == 0)
+    {
+        return;
+    }
+    if(pDelivery->m_pPrevious != 0)
+    {
+        pDelivery->m_pPrevious->m_pNext = pDelivery->m_pNext;
+    }
+    else
+    {
+        hook.m_pDeliveries = pDelivery->m_pNext;
+    }
+    if(pDelivery->m_pNext != 0)
+    {
+        pDelivery->m_pNext->m_pPrevious = pDelivery->m_pPrevious;
+    }
+    if(hook.m_waitingCancels != 0)
+    {
+        hook.m_deliveryDone.notify_all();
+    }
+}
+
+template<typename hook_t>
+EpicsInterfaceImpl::deliveryGuard_t<hook_t>::deliveryGuard_t(hook_t& hook, size_t reason): m_hook(hook)
+{
+    std::lock_guard<std::mutex> lock(m_hook.m_lock);
+    startDelivery(m_hook, reason, &m_delivery);
+}
+
+template<typename hook_t>
+EpicsInterfaceImpl::deliveryGuard_t<hook_t>::~deliveryGuard_t()
+{
+    if(m_delivery.m_pSubscribers.get() == 0)
+    {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(m_hook.m_lock);
+    endDelivery(m_hook, &m_delivery);
+}
+
+
+/*
+ * Deliver a scalar value to the subscribers of the reason
+ *
+ *********************************************************/
+template<typename T, typename hook_t>
+void EpicsInterfaceImpl::deliverOneValue(hook_t& hook, size_t reason, const timespec& timestamp, const T& value, std::uint64_t pushNanoseconds)
+{
+    deliveryGuard_t<hook_t> delivery(hook, reason);
+    if(!delivery.hasSubscribers())
+    {
+        return;
+    }
+
+    size_t callbacks(callSubscribers(delivery.get(), convertUnixTimeToEpicsTime(timestamp), value));
+    countDelivery(reason, callbacks, pushNanoseconds);
+}
+
+
+/*
+ * Call the interrupt callbacks of a scalar, skipping the subscribers
+ *  cancelled by the callbacks
+ *
+ *******************************************************************/
+template<typename T, typename delivery_t>
+size_t EpicsInterfaceImpl::callSubscribers(const delivery_t& delivery, const epicsTimeStamp& timestamp, const T& value)
+{
+    size_t callbacks(0);
+    for(size_t scanSubscribers(0), endSubscribers(delivery.m_pSubscribers->size()); scanSubscribers != endSubscribers; ++scanSubscribers)
+    {
+        auto pInterrupt = (*delivery.m_pSubscribers)[scanSubscribers];
+        if(!delivery.m_cancelled.empty() &&
+           std::find(delivery.m_cancelled.begin(), delivery.m_cancelled.end(), pInterrupt) != delivery.m_cancelled.end())
+        {
+            continue;
+        }
+        pInterrupt->pasynUser->timestamp = timestamp;
+        pInterrupt->pasynUser->auxStatus = asynSuccess;
+        pInterrupt->callback(pInterrupt->userPvt, pInterrupt->pasynUser, value);
+        ++callbacks;
+    }
+    return callbacks;
+}
+
+
+/*
+ * Deliver an array to the subscribers of the reason
+ *
+ ***************************************************/
+template<typename T, typename hook_t>
+void EpicsInterfaceImpl::deliverArray(hook_t& hook, size_t reason, const timespec& timestamp, const T* pValue, size_t numElements,
+                                      const std::shared_ptr<const void>& pOwner, std::uint64_t pushNanoseconds)
+{
+    size_t callbacks(deliverSharedArray(reason, timestamp, pValue, numElements, pOwner));
+
+    {
+        deliveryGuard_t<hook_t> delivery(hook, reason);
+        if(delivery.hasSubscribers())
+        {
+            const typename hook_t::delivery_t& subscribers(delivery.get());
+            epicsTimeStamp epicsTimestamp(convertUnixTimeToEpicsTime(timestamp));
+
+            for(size_t scanSubscribers(0), endSubscribers(subscribers.m_pSubscribers->size()); scanSubscribers != endSubscribers; ++scanSubscribers)
+            {
+                typename hook_t::interrupt_t* pInterrupt = (*subscribers.m_pSubscribers)[scanSubscribers];
+                if(!subscribers.m_cancelled.empty() &&
+                   std::find(subscribers.m_cancelled.begin(), subscribers.m_cancelled.end(), pInterrupt) != subscribers.m_cancelled.end())
+                {
+                    continue;
+                }
+                pInterrupt->pasynUser->timestamp = epicsTimestamp;
+                pInterrupt->pasynUser->auxStatus = asynSuccess;
+                pInterrupt->callback(pInterrupt->userPvt, pInterrupt->pasynUser, (T*)pValue, numElements);
+                ++callbacks;
+            }
+        }
+    }
+
+    countDelivery(reason, callbacks, pushNanoseconds);
+}
+
+
+/*
+ * Deliver an array by reference to the genericPointer subscribers
+ *
+ *****************************************************************/
+template<typename T>
+size_t EpicsInterfaceImpl::deliverSharedArray(size_t reason, const timespec& timestamp, const T* pValue, size_t numElements,
+                                              std::shared_ptr<const void> pOwner)
+{
+    deliveryGuard_t<genericPointerHook_t> delivery(m_genericPointerHook, reason);
+    if(!delivery.hasSubscribers())
+    {
+        return 0;
+    }
+
+    // The subscribers may keep a reference: the array must be owned
+    if(pOwner.get() == 0)
+    {
+        std::shared_ptr<std::vector<T> > pCopy(new std::vector<T>(pValue, pValue + numElements));
+        pValue = pCopy->data();
+        pOwner = pCopy;
+    }
+
+    EpicsSharedArray sharedArray;
+    sharedArray.m_pOwner = pOwner;
+    sharedArray.m_pData = pValue;
+    sharedArray.m_numElements = numElements;
+    sharedArray.m_pElementType = &typeid(T);
+    sharedArray.m_timestamp = timestamp;
+
+    return callSubscribers(delivery.get(), convertUnixTimeToEpicsTime(timestamp), (void*)&sharedArray);
+}
+
+
+/*
+ * Push a batch of values
+ *
+ ************************/
+void EpicsInterfaceImpl::pushBatch(const EpicsPushBatch& batch)
+{
+    pushBatchValues<epicsInt32>(m_int32Hook, batch.getInt32Values());
+    pushBatchValues<epicsFloat64>(m_float64Hook, batch.getFloat64Values());
+}
+
+
+/*
+ * Push the values of a batch that go to the same asyn interface
+ *
+ ***************************************************************/
+template<typename T, typename hook_t, typename batchValue_t>
+void EpicsInterfaceImpl::pushBatchValues(hook_t& hook, const std::vector<batchValue_t>& values)
+{
+    if(values.empty())
+    {
+        return;
+    }
+
+    if(m_pPushDispatcher.get() != 0)
+    {
+        for(typename std::vector<batchValue_t>::const_iterator scanValues(values.begin()), endValues(values.end());
+            scanValues != endValues;
+            ++scanValues)
+        {
+            pushOneValue(hook, *(scanValues->m_pPV), scanValues->m_timestamp, (T)scanValues->m_value);
+        }
+        return;
+    }
+
+    // The values of the batch are pushed together
+    std::uint64_t pushNanoseconds(EpicsPvStatistics::getNanoseconds());
+    timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+
+    // The buffers are kept by the thread for the next batch. A batch pushed
+    //  by a callback uses its own buffers
+    struct batchBuffers_t
+    {
+        std::vector<size_t> m_accepted; ///< Indexes of the values to deliver
+        std::vector<size_t> m_reasons;
+        std::vector<typename hook_t::delivery_t> m_deliveries;
+    };
+    static thread_local std::unique_ptr<batchBuffers_t> pThreadBuffers;
+    std::unique_ptr<batchBuffers_t> pBuffers(std::move(pThreadBuffers));
+    if(pBuffers.get() == 0)
+    {
+        pBuffers.reset(new batchBuffers_t);
+    }
+    std::vector<size_t>& accepted(pBuffers->m_accepted);
+    std::vector<size_t>& reasons(pBuffers->m_reasons);
+    std::vector<typename hook_t::delivery_t>& deliveries(pBuffers->m_deliveries);
+    accepted.clear();
+    reasons.clear();
+    deliveries.clear();
+
+    // Update the PVs' state as push() does and select the values to deliver
+    for(size_t scanValues(0), endValues(values.size()); scanValues != endValues; ++scanValues)
+    {
+        const batchValue_t& value(values[scanValues]);
+        size_t reason(0);
+        reasonGuard_t entry(*this, acquireReason(*(value.m_pPV), &reason));
+        if(entry.get() == 0)
+        {
+            continue;
+        }
+
+        recordAcquisitionLatency(*entry.get(), value.m_timestamp, now);
+        entry->m_statistics.countPush(sizeof(T));
+
+        EpicsValueCache* pCache = entry->m_pValueCache.get();
+        if(pCache != 0)
+        {
+            pCache->storeValue(value.m_timestamp, (T)value.m_value);
+        }
+
+        EpicsPushFilter* pFilter = entry->m_pPushFilter.get();
+        if(pFilter != 0 && !pFilter->acceptValue((double)value.m_value))
+        {
+            continue;
+        }
 
-void EpicsInterfaceImpl::push(const PVBaseImpl& pv, const timespec& timestamp, const std::string& value)
-{
-    pushArray<epicsInt8, asynInt8ArrayInterrupt>(pv, timestamp, (epicsInt8*)value.data(), value.size(), asynStdInterfaces.int8ArrayInterruptPvt);
-}
+        accepted.push_back(scanValues);
+        reasons.push_back(reason);
+    }
 
-void EpicsInterfaceImpl::push(const PVBaseImpl& pv, const timespec& timestamp, const std::vector<std::int8_t> & value)
-{
-    pushArray<epicsInt8, asynInt8ArrayInterrupt>(pv, timestamp, (epicsInt8*)value.data(), value.size(), asynStdInterfaces.int8ArrayInterruptPvt);
-}
+    // Take the subscribers lock once to reference the subscribers of all
+    //  the values, and once to terminate the deliveries
+    deliveries.resize(accepted.size());
+    {
+        std::lock_guard<std::mutex> lock(hook.m_lock);
+        for(size_t scanDeliveries(0), endDeliveries(deliveries.size()); scanDeliveries != endDeliveries; ++scanDeliveries)
+        {
+            startDelivery(hook, reasons[scanDeliveries], &deliveries[scanDeliveries]);
+        }
+    }
 
-void EpicsInterfaceImpl::push(const PVBaseImpl& pv, const timespec& timestamp, const std::vector<std::uint8_t> & value)
-{
-    pushArray<epicsInt8, asynInt8ArrayInterrupt>(pv, timestamp, (epicsInt8*)value.data(), value.size(), asynStdInterfaces.int8ArrayInterruptPvt);
-}
+    timespec lastTimestamp{0, 0};
+    epicsTimeStamp epicsTimestamp{0, 0};
 
+    for(size_t scanDeliveries(0), endDeliveries(deliveries.size()); scanDeliveries != endDeliveries; ++scanDeliveries)
+    {
+        const typename hook_t::delivery_t& delivery(deliveries[scanDeliveries]);
+        if(delivery.m_pSubscribers.get() == 0 || delivery.m_pSubscribers->empty())
+        {
+            continue;
+        }
 
-/*
- * Push a scalar value to EPICS
- *
- ******************************/
-template<typename T, typename interruptType>
-void EpicsInterfaceImpl::pushOneValue(const PVBaseImpl& pv, const timespec& timestamp, const T& value, void* interruptPvt)
-{
-    int reason = m_pvNameToReason[pv.getFullNameFromPort()];
+        // The values of a batch usually share the timestamp: convert it only when it changes
+        const batchValue_t& value(values[accepted[scanDeliveries]]);
+        if(value.m_timestamp.tv_sec != lastTimestamp.tv_sec || value.m_timestamp.tv_nsec != lastTimestamp.tv_nsec)
+        {
+            epicsTimestamp = convertUnixTimeToEpicsTime(value.m_timestamp);
+            lastTimestamp = value.m_timestamp;
+        }
 
-    ELLLIST       *pclientList;
-    int            addr;
+        size_t callbacks(callSubscribers(delivery, epicsTimestamp, (T)value.m_value));
+        countDelivery(reasons[scanDeliveries], callbacks, pushNanoseconds);
+    }
 
-    pasynManager->interruptStart(interruptPvt, &pclientList);
+    {
+        std::lock_guard<std::mutex> lock(hook.m_lock);
+        for(size_t scanDeliveries(0), endDeliveries(deliveries.size()); scanDeliveries != endDeliveries; ++scanDeliveries)
+        {
+            endDelivery(hook, &deliveries[scanDeliveries]);
+        }
+    }
 
-    interruptNode* pnode = (interruptNode *)ellFirst(pclientList);
-    while (pnode)
-      {
-        interruptType *pInterrupt = (interruptType *)pnode->drvPvt;
-        pInterrupt->pasynUser->timestamp = convertUnixTimeToEpicsTime(timestamp);
-        pasynManager->getAddr(pInterrupt->pasynUser, &addr);
-        if ((pInterrupt->pasynUser->reason == reason) && (0 == addr))
-          {
-            pInterrupt->pasynUser->auxStatus = asynSuccess;
-            pInterrupt->callback(pInterrupt->userPvt, pInterrupt->pasynUser, value);
-          }
-        pnode = (interruptNode *)ellNext(&pnode->node);
-      }
-    pasynManager->interruptEnd(interruptPvt);
+    deliveries.clear();
+    if(pThreadBuffers.get() == 0)
+    {
+        pThreadBuffers = std::move(pBuffers);
+    }
 }
 
 
 /*
- * Push an array to EPICS
+ * Called by the push dispatcher to deliver the queued values
  *
- ************************/
-template<typename T, typename interruptType>
-void EpicsInterfaceImpl::pushArray(const PVBaseImpl& pv, const timespec& timestamp, const T* pValue, size_t numElements, void* interruptPvt)
+ ************************************************************/
+template<typename T, typename hook_t>
+void EpicsInterfaceImpl::deliverQueuedValue(EpicsInterfaceImpl* pInterface, const queuedPush_t& push)
 {
-    int reason = m_pvNameToReason[pv.getFullNameFromPort()];
-
-    ELLLIST       *pclientList;
-    int            addr;
-
-    pasynManager->interruptStart(interruptPvt, &pclientList);
+    pInterface->deliverOneValue(*(hook_t*)push.m_pHook, push.m_reason, push.m_timestamp, push.getScalar<T>(), push.m_pushNanoseconds);
+}
 
-    interruptNode* pnode = (interruptNode *)ellFirst(pclientList);
-    while (pnode)
-      {
-        interruptType *pInterrupt = (interruptType *)pnode->drvPvt; // TODO: remember the last used pointer
-        pInterrupt->pasynUser->timestamp = convertUnixTimeToEpicsTime(timestamp);
-        pasynManager->getAddr(pInterrupt->pasynUser, &addr);
-        if ((pInterrupt->pasynUser->reason == reason) && (0 == addr))
-          {
-            pInterrupt->pasynUser->auxStatus = asynSuccess;
-            pInterrupt->callback(pInterrupt->userPvt, pInterrupt->pasynUser, (T*)pValue, numElements);
-          }
-        pnode = (interruptNode *)ellNext(&pnode->node);
-      }
-    pasynManager->interruptEnd(interruptPvt);
+template<typename T, typename hook_t>
+void EpicsInterfaceImpl::deliverQueuedArray(EpicsInterfaceImpl* pInterface, const queuedPush_t& push)
+{
+    pInterface->deliverArray(*(hook_t*)push.m_pHook, push.m_reason, push.m_timestamp, (const T*)push.m_pArrayData, push.m_numElements, push.m_pArray,
+                             push.m_pushNanoseconds);
 }
 
 /*
@@ -418,11 +1867,17 @@ void EpicsInterfaceImpl::pushArray(const PVBaseImpl& pv, const timespec& timesta
 template<typename T>
 asynStatus EpicsInterfaceImpl::writeOneValue(asynUser* pasynUser, const T& value)
 {
+    std::uint64_t startNanoseconds(EpicsPvStatistics::getNanoseconds());
     timespec timestamp = convertEpicsTimeToUnixTime(pasynUser->timestamp);
 
     try
     {
-        m_pvs[pasynUser->reason]->write(timestamp, value);
+        reasonGuard_t entry(*this, acquireReason(pasynUser->reason));
+        if(entry.get() == 0)
+        {
+            throw std::runtime_error(notRegisteredError);
+        }
+        entry->m_pPV->write(timestamp, value);
         pasynUser->auxStatus = asynSuccess;
     }
     catch(std::runtime_error& e)
@@ -433,6 +1888,7 @@ asynStatus EpicsInterfaceImpl::writeOneValue(asynUser* pasynUser, const T& value
         pasynUser->errorMessageSize = errorAndSize.second;
     }
 
+    countRequest(pasynUser, startNanoseconds, sizeof(T), true);
     return (asynStatus)pasynUser->auxStatus;
 }
 
@@ -444,10 +1900,23 @@ asynStatus EpicsInterfaceImpl::writeOneValue(asynUser* pasynUser, const T& value
 template<typename T>
 asynStatus EpicsInterfaceImpl::readOneValue(asynUser* pasynUser, T* pValue)
 {
+    std::uint64_t startNanoseconds(EpicsPvStatistics::getNanoseconds());
     try
     {
         timespec timestamp = convertEpicsTimeToUnixTime(pasynUser->timestamp);
-        m_pvs[pasynUser->reason]->read(&timestamp, pValue);
+
+        // Serve the read from the last pushed value when it is fresh enough
+        reasonGuard_t entry(*this, acquireReason(pasynUser->reason));
+        if(entry.get() == 0)
+        {
+            throw std::runtime_error(notRegisteredError);
+        }
+
+        EpicsValueCache* pCache = entry->m_pValueCache.get();
+        if(pCache == 0 || !pCache->getValue(&timestamp, pValue))
+        {
+            entry->m_pPV->read(&timestamp, pValue);
+        }
         pasynUser->timestamp = convertUnixTimeToEpicsTime(timestamp);
     }
     catch(std::runtime_error& e)
@@ -458,6 +1927,7 @@ asynStatus EpicsInterfaceImpl::readOneValue(asynUser* pasynUser, T* pValue)
         pasynUser->errorMessageSize = errorAndSize.second;
     }
 
+    countRequest(pasynUser, startNanoseconds, sizeof(T), false);
     return (asynStatus)pasynUser->auxStatus;
 
 }
@@ -466,23 +1936,30 @@ asynStatus EpicsInterfaceImpl::readOneValue(asynUser* pasynUser, T* pValue)
  * Called to read an array from a PV
  *
  ***********************************/
-template<typename T>
+template<typename T, typename unsignedElement_t>
 asynStatus EpicsInterfaceImpl::readArray(asynUser *pasynUser, T* pValue, size_t nElements, size_t *nIn)
 {
+    static_assert(sizeof(T) == sizeof(unsignedElement_t), "The PV and the asyn interface must have the same element size");
+
+    std::uint64_t startNanoseconds(EpicsPvStatistics::getNanoseconds());
     try
     {
         timespec timestamp = convertEpicsTimeToUnixTime(pasynUser->timestamp);
 
-        std::vector<T> vector(nElements);
-        m_pvs[pasynUser->reason]->read(&timestamp, &vector);
-
-        if(vector.size() > nElements)
+        reasonGuard_t entry(*this, acquireReason(pasynUser->reason));
+        if(entry.get() == 0)
         {
-            vector.resize(nElements);
+            throw std::runtime_error(notRegisteredError);
         }
-        *nIn = vector.size();
 
-        ::memcpy(pValue, vector.data(), vector.size() * sizeof(T));
+        if(entry->m_unsignedElements)
+        {
+            readPVArray<T, unsignedElement_t>(*entry.get(), &timestamp, pValue, nElements, nIn);
+        }
+        else
+        {
+            readPVArray<T, T>(*entry.get(), &timestamp, pValue, nElements, nIn);
+        }
 
         pasynUser->timestamp = convertUnixTimeToEpicsTime(timestamp);
         pasynUser->auxStatus = asynSuccess;
@@ -495,25 +1972,78 @@ asynStatus EpicsInterfaceImpl::readArray(asynUser *pasynUser, T* pValue, size_t
         pasynUser->errorMessage = (char*)errorAndSize.first;
         pasynUser->errorMessageSize = errorAndSize.second;
     }
+
+    countRequest(pasynUser, startNanoseconds, pasynUser->auxStatus == asynSuccess ? *nIn * sizeof(T) : 0, false);
     return (asynStatus)pasynUser->auxStatus;
 }
 
 
+template<typename T, typename pvElement_t>
+void EpicsInterfaceImpl::readPVArray(const reasonEntry_t& entry, timespec* pTimestamp, T* pValue, size_t nElements, size_t *nIn)
+{
+    const PVBaseImpl* pPV = entry.m_pPV.get();
+    const EpicsArrayReader<pvElement_t>* pArrayReader = dynamic_cast<const EpicsArrayReader<pvElement_t>*>(pPV);
+    EpicsValueCache* pCache = entry.m_pValueCache.get();
+    if(pCache != 0 && pCache->getArray(pTimestamp, pValue, nElements, nIn))
+    {
+        // Served from the last pushed array
+    }
+    else if(pArrayReader != 0)
+    {
+        // The PV fills the record's buffer directly
+        *nIn = std::min(pArrayReader->readArray(pTimestamp, (pvElement_t*)pValue, nElements), nElements);
+    }
+    else
+    {
+        // Fall back to the vector interface. The small arrays reuse the
+        //  vector of the thread, the large ones are not kept after the call
+        static thread_local std::vector<pvElement_t> reusedVector;
+        std::vector<pvElement_t> largeVector;
+        std::vector<pvElement_t>& vector(nElements * sizeof(pvElement_t) <= maxReusedVectorBytes ? reusedVector : largeVector);
+        vector.resize(nElements);
+        pPV->read(pTimestamp, &vector);
+
+        *nIn = std::min(vector.size(), nElements);
+
+        ::memcpy(pValue, vector.data(), *nIn * sizeof(T));
+
+        // The PV may have grown the vector
+        if(reusedVector.capacity() * sizeof(pvElement_t) > maxReusedVectorBytes)
+        {
+            std::vector<pvElement_t>().swap(reusedVector);
+        }
+    }
+}
+
+
 /*
  * Called to write an array into a PV
  *
  ************************************/
-template<typename T>
+template<typename T, typename unsignedElement_t>
 asynStatus EpicsInterfaceImpl::writeArray(asynUser *pasynUser, T* pValue, size_t nElements)
 {
-    timespec timestamp = convertEpicsTimeToUnixTime(pasynUser->timestamp);
+    static_assert(sizeof(T) == sizeof(unsignedElement_t), "The PV and the asyn interface must have the same element size");
 
-    std::vector<T> vector(nElements);
-    ::memcpy(vector.data(), pValue, vector.size() * sizeof(T));
+    std::uint64_t startNanoseconds(EpicsPvStatistics::getNanoseconds());
+    timespec timestamp = convertEpicsTimeToUnixTime(pasynUser->timestamp);
 
     try
     {
-        m_pvs[pasynUser->reason]->write(timestamp, vector);
+        reasonGuard_t entry(*this, acquireReason(pasynUser->reason));
+        if(entry.get() == 0)
+        {
+            throw std::runtime_error(notRegisteredError);
+        }
+
+        if(entry->m_unsignedElements)
+        {
+            writePVArray<T, unsignedElement_t>(*entry.get(), timestamp, pValue, nElements);
+        }
+        else
+        {
+            writePVArray<T, T>(*entry.get(), timestamp, pValue, nElements);
+        }
         pasynUser->auxStatus = asynSuccess;
     }
     catch(std::runtime_error& e)
@@ -524,10 +2054,130 @@ asynStatus EpicsInterfaceImpl::writeArray(asynUser *pasynUser, T* pValue, size_t
         pasynUser->errorMessageSize = errorAndSize.second;
     }
 
+    countRequest(pasynUser, startNanoseconds, nElements * sizeof(T), true);
     return (asynStatus)pasynUser->auxStatus;
 }
 
 
+template<typename T, typename pvElement_t>
+void EpicsInterfaceImpl::writePVArray(const reasonEntry_t& entry, const timespec& timestamp, T* pValue, size_t nElements)
+{
+    PVBaseImpl* pPV = entry.m_pPV.get();
+    EpicsArrayWriter<pvElement_t>* pArrayWriter = dynamic_cast<EpicsArrayWriter<pvElement_t>*>(pPV);
+    if(pArrayWriter != 0)
+    {
+        // The PV reads the record's buffer directly
+        pArrayWriter->writeArray(timestamp, (const pvElement_t*)pValue, nElements);
+    }
+    else
+    {
+        // Fall back to the vector interface. The small arrays reuse the
+        //  vector of the thread, the large ones are not kept after the call
+        if(nElements * sizeof(pvElement_t) <= maxReusedVectorBytes)
+        {
+            static thread_local std::vector<pvElement_t> reusedVector;
+            reusedVector.assign((const pvElement_t*)pValue, (const pvElement_t*)pValue + nElements);
+            pPV->write(timestamp, reusedVector);
+        }
+        else
+        {
+            std::vector<pvElement_t> largeVector((const pvElement_t*)pValue, (const pvElement_t*)pValue + nElements);
+            pPV->write(timestamp, largeVector);
+        }
+    }
+}
+
+
+/*
+ * Update the statistics of the PV that served a read or a write
+ *
+ ***************************************************************/
+void EpicsInterfaceImpl::countRequest(asynUser* pasynUser, std::uint64_t startNanoseconds, size_t bytes, bool write)
+{
+    reasonEntry_t* pEntry(getPublishedEntry((size_t)pasynUser->reason));
+    if(pEntry == 0)
+    {
+        return;
+    }
+    if(pasynUser->auxStatus != asynSuccess)
+    {
+        pEntry->m_statistics.countError();
+        return;
+    }
+
+    std::uint64_t nanoseconds(EpicsPvStatistics::getNanoseconds() - startNanoseconds);
+    EpicsLatencyHistograms* pLatency(pEntry->m_pLatency.get());
+    if(write)
+    {
+        pEntry->m_statistics.countWrite(nanoseconds, bytes);
+        m_latency.m_writeService.record(nanoseconds);
+        if(pLatency != 0)
+        {
+            pLatency->m_writeService.record(nanoseconds);
+        }
+    }
+    else
+    {
+        pEntry->m_statistics.countRead(nanoseconds, bytes);
+        m_latency.m_readService.record(nanoseconds);
+        if(pLatency != 0)
+        {
+            pLatency->m_readService.record(nanoseconds);
+        }
+    }
+}
+
+
+/*
+ * Return the entry of a reason, without acquiring it: the entries are
+ *  never deleted
+ *
+ *************************************************************************/
+EpicsInterfaceImpl::reasonEntry_t* EpicsInterfaceImpl::getPublishedEntry(size_t reason) const
+{
+    EpicsSnapshot<reasonTable_t>::reader_t table(m_reasonTable);
+    if(table.get() == 0 || reason >= table->m_entries.size())
+    {
+        return 0;
+    }
+    return table->m_entries[reason];
+}
+
+
+void EpicsInterfaceImpl::countDelivery(size_t reason, size_t callbacks, std::uint64_t pushNanoseconds)
+{
+    if(callbacks == 0)
+    {
+        return;
+    }
+    reasonEntry_t* pEntry(getPublishedEntry(reason));
+    if(pEntry == 0)
+    {
+        return;
+    }
+    pEntry->m_statistics.countCallbacks(callbacks);
+
+    std::uint64_t nanoseconds(EpicsPvStatistics::getNanoseconds() - pushNanoseconds);
+    m_latency.m_pushToCallbacks.record(nanoseconds);
+    EpicsLatencyHistograms* pLatency(pEntry->m_pLatency.get());
+    if(pLatency != 0)
+    {
+        pLatency->m_pushToCallbacks.record(nanoseconds);
+    }
+}
+
+
+void EpicsInterfaceImpl::recordAcquisitionLatency(const reasonEntry_t& entry, const timespec& timestamp, const timespec& now)
+{
+    m_latency.recordAcquisition(timestamp, now);
+    EpicsLatencyHistograms* pLatency(entry.m_pLatency.get());
+    if(pLatency != 0)
+    {
+        pLatency->recordAcquisition(timestamp, now);
+    }
+}
+
+
 /*********************************************************
  *
  * OVERWRITTEN METHODS FROm asynPortDriver
@@ -594,21 +2244,243 @@ asynStatus EpicsInterfaceImpl::writeFloat64Array(asynUser *pasynUser, epicsFloat
     return writeArray<double>(pasynUser, (double*)pValue, nElements);
 }
 
+#ifdef NDS3_EXTENDED_DATA_TYPES
+asynStatus EpicsInterfaceImpl::readInt16Array(asynUser *pasynUser, epicsInt16* pValue,
+                                              size_t nElements, size_t *nIn)
+{
+    // The USHORT waveforms use the Int16 interface too
+    return readArray<std::int16_t, std::uint16_t>(pasynUser, (std::int16_t*)pValue, nElements, nIn);
+}
+
+asynStatus EpicsInterfaceImpl::writeInt16Array(asynUser *pasynUser, epicsInt16* pValue,
+                                               size_t nElements)
+{
+    return writeArray<std::int16_t, std::uint16_t>(pasynUser, (std::int16_t*)pValue, nElements);
+}
+
+asynStatus EpicsInterfaceImpl::readFloat32Array(asynUser *pasynUser, epicsFloat32* pValue,
+                                              size_t nElements, size_t *nIn)
+{
+    return readArray<float>(pasynUser, (float*)pValue, nElements, nIn);
+}
+
+asynStatus EpicsInterfaceImpl::writeFloat32Array(asynUser *pasynUser, epicsFloat32* pValue,
+                                               size_t nElements)
+{
+    return writeArray<float>(pasynUser, (float*)pValue, nElements);
+}
+
+asynStatus EpicsInterfaceImpl::readInt64(asynUser *pasynUser, epicsInt64 *pValue)
+{
+    return readOneValue<std::int64_t>(pasynUser, (std::int64_t*)pValue);
+}
+
+asynStatus EpicsInterfaceImpl::writeInt64(asynUser *pasynUser, epicsInt64 value)
+{
+    return writeOneValue<std::int64_t>(pasynUser, (std::int64_t)value);
+}
+
+asynStatus EpicsInterfaceImpl::readInt64Array(asynUser *pasynUser, epicsInt64* pValue,
+                                              size_t nElements, size_t *nIn)
+{
+    return readArray<std::int64_t>(pasynUser, (std::int64_t*)pValue, nElements, nIn);
+}
+
+asynStatus EpicsInterfaceImpl::writeInt64Array(asynUser *pasynUser, epicsInt64* pValue,
+                                               size_t nElements)
+{
+    return writeArray<std::int64_t>(pasynUser, (std::int64_t*)pValue, nElements);
+}
+#endif
+
 
 
 asynStatus EpicsInterfaceImpl::drvUserCreate(asynUser *pasynUser, const char *drvInfo,
                                  const char **pptypeName, size_t *psize)
 {
-    for(size_t scanReasons(0), endReasons(m_pvs.size()); scanReasons != endReasons; ++scanReasons)
+    timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    asynStatus status(asynError);
+    {
+        std::lock_guard<std::mutex> lock(m_registrationLock);
+        nameToReason_t::const_iterator findReason = m_nameToReason.find(drvInfo);
+        if(findReason != m_nameToReason.end())
+        {
+            pasynUser->reason = findReason->second;
+            pasynUser->userData = m_reasons[findReason->second]->m_pPV.get();
+            status = asynSuccess;
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    m_drvUserCreateCalls.fetch_add(1, std::memory_order_relaxed);
+    m_drvUserCreateNanoseconds.fetch_add((std::uint64_t)((end.tv_sec - start.tv_sec) * 1000000000LL + (end.tv_nsec - start.tv_nsec)), std::memory_order_relaxed);
+
+    return status;
+}
+
+
+/*
+ * Print the initialization times (ndsInitReport)
+ *
+ ************************************************/
+void EpicsInterfaceImpl::initReport(FILE* fp) const
+{
+    std::lock_guard<std::mutex> lock(m_registrationLock);
+    fprintf(fp, "%s: %zu PVs, %zu records %s in %.3f s, %llu links resolved in %.3f s\n",
+            portName,
+            m_reasons.size(),
+            m_numRecords,
+            m_recordsFromCache ? "loaded from the cache" : "created",
+            m_recordsCreationSeconds,
+            (unsigned long long)m_drvUserCreateCalls.load(std::memory_order_relaxed),
+            (double)m_drvUserCreateNanoseconds.load(std::memory_order_relaxed) / 1.0e9);
+}
+
+
+/*
+ * Collect the statistics of the PVs (ndsPvStats)
+ *
+ ************************************************/
+void EpicsInterfaceImpl::collectStatistics(pvStatisticsList_t* pStatistics) const
+{
+    std::lock_guard<std::mutex> lock(m_registrationLock);
+    for(size_t scanReasons(0), endReasons(m_reasons.size()); scanReasons != endReasons; ++scanReasons)
+    {
+        pvStatistics_t statistics;
+        statistics.m_portName = portName;
+        statistics.m_pvName = m_reasons[scanReasons]->m_name;
+        statistics.m_statistics = m_reasons[scanReasons]->m_statistics.getSnapshot();
+        pStatistics->push_back(statistics);
+    }
+}
+
+
+/*
+ * Print the latency histograms (ndsLatencyReport)
+ *
+ *************************************************/
+void EpicsInterfaceImpl::latencyReport(FILE* fp) const
+{
+    m_latency.report(fp, std::string("Port ") + portName);
+
+    std::lock_guard<std::mutex> lock(m_registrationLock);
+    for(size_t scanReasons(0), endReasons(m_reasons.size()); scanReasons != endReasons; ++scanReasons)
+    {
+        const EpicsLatencyHistograms* pLatency(m_reasons[scanReasons]->m_pLatency.get());
+        if(pLatency != 0)
+        {
+            pLatency->report(fp, "  PV " + m_reasons[scanReasons]->m_name);
+        }
+    }
+}
+
+
+/*
+ * Clear the latency histograms (ndsLatencyReset)
+ *
+ ************************************************/
+void EpicsInterfaceImpl::resetLatency()
+{
+    m_latency.reset();
+
+    std::lock_guard<std::mutex> lock(m_registrationLock);
+    for(size_t scanReasons(0), endReasons(m_reasons.size()); scanReasons != endReasons; ++scanReasons)
+    {
+        EpicsLatencyHistograms* pLatency(m_reasons[scanReasons]->m_pLatency.get());
+        if(pLatency != 0)
+        {
+            pLatency->reset();
+        }
+    }
+}
+
+
+/*
+ * Print the status of the port (asynReport)
+ *
+ *******************************************/
+void EpicsInterfaceImpl::report(FILE* fp, int details)
+{
+    asynPortDriver::report(fp, details);
+
+    std::lock_guard<std::mutex> lock(m_registrationLock);
+
+    fprintf(fp, "    Registered PVs: %zu, reasons: %zu\n", m_pvToReason.size(), m_reasons.size());
+    if(!m_shardPorts.empty())
+    {
+        fprintf(fp, "    Shards: %zu (%s", m_shardPorts.size() + 1, portName);
+        for(size_t scanShards(0), endShards(m_shardPorts.size()); scanShards != endShards; ++scanShards)
+        {
+            fprintf(fp, ", %s", m_shardPorts[scanShards]->portName);
+        }
+        fprintf(fp, ")\n");
+    }
+    if(m_pSynchronousPort.get() != 0)
+    {
+        fprintf(fp, "    Synchronous port for the non-blocking PVs: %s\n", m_pSynchronousPort->portName);
+    }
+    if(m_pPushDispatcher.get() != 0)
+    {
+        m_pPushDispatcher->report(fp);
+    }
+
+    // Reads served by the value caches
+    std::uint64_t totalHits(0), totalMisses(0);
+    size_t numCaches(0);
+    for(size_t scanReasons(0), endReasons(m_reasons.size()); scanReasons != endReasons; ++scanReasons)
+    {
+        const EpicsValueCache* pCache(m_reasons[scanReasons]->m_pValueCache.get());
+        if(pCache != 0)
+        {
+            ++numCaches;
+            totalHits += pCache->getHits();
+            totalMisses += pCache->getMisses();
+        }
+    }
+    if(numCaches != 0)
+    {
+        fprintf(fp, "    Value caches: %zu, hits %llu, misses %llu\n", numCaches, (unsigned long long)totalHits, (unsigned long long)totalMisses);
+        for(size_t scanReasons(0), endReasons(m_reasons.size()); details > 1 && scanReasons != endReasons; ++scanReasons)
+        {
+            const EpicsValueCache* pCache(m_reasons[scanReasons]->m_pValueCache.get());
+            if(pCache != 0)
+            {
+                fprintf(fp, "      %s: hits %llu, misses %llu\n",
+                        m_reasons[scanReasons]->m_pPV->getFullExternalName().c_str(),
+                        (unsigned long long)pCache->getHits(),
+                        (unsigned long long)pCache->getMisses());
+            }
+        }
+    }
+
+    // Values suppressed by the push filters
+    std::uint64_t totalSuppressed(0);
+    size_t numFilters(0);
+    for(size_t scanReasons(0), endReasons(m_reasons.size()); scanReasons != endReasons; ++scanReasons)
+    {
+        const EpicsPushFilter* pFilter(m_reasons[scanReasons]->m_pPushFilter.get());
+        if(pFilter != 0)
+        {
+            ++numFilters;
+            totalSuppressed += pFilter->getSuppressed();
+        }
+    }
+    if(numFilters != 0)
     {
-        if(m_pvs[scanReasons]->getFullNameFromPort() == drvInfo)
+        fprintf(fp, "    Push filters: %zu, suppressed values %llu\n", numFilters, (unsigned long long)totalSuppressed);
+        for(size_t scanReasons(0), endReasons(m_reasons.size()); details > 1 && scanReasons != endReasons; ++scanReasons)
         {
-            pasynUser->reason = scanReasons;
-            pasynUser->userData = m_pvs[scanReasons].get();
-            return asynSuccess;
+            const EpicsPushFilter* pFilter(m_reasons[scanReasons]->m_pPushFilter.get());
+            if(pFilter != 0)
+            {
+                fprintf(fp, "      %s: suppressed %llu\n",
+                        m_reasons[scanReasons]->m_pPV->getFullExternalName().c_str(),
+                        (unsigned long long)pFilter->getSuppressed());
+            }
         }
     }
-    return asynError;
 }
 
 
@@ -675,6 +2547,7 @@ epicsTimeStamp EpicsInterfaceImpl::convertUnixTimeToEpicsTime(const timespec& ti
  ***********************************************/
 EpicsInterfaceImpl::errorAndSize_t EpicsInterfaceImpl::getErrorString(const std::string& error)
 {
+    std::lock_guard<std::mutex> lock(m_errorMessagesLock);
     std::pair<std::set<std::string>::const_iterator, bool> elementInsertion = m_errorMessages.insert(error);
     return errorAndSize_t((*elementInsertion.first).c_str(), (*elementInsertion.first).size());
 }
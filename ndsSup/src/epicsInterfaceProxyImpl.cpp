@@ -0,0 +1,150 @@
+/*
+ * EPICS support for NDS3
+ *
+ * Copyright (c) 2015 Cosylab d.d.
+ *
+ * For more information about the license please refer to the license.txt
+ * file included in the distribution.
+ */
+
+/**
+ * @file epicsInterfaceProxyImpl.cpp
+ *
+ * Interface given to the NDS ports, forwards the calls to the persistent
+ *  EpicsInterfaceImpl of the port.
+ *
+ */
+
+#include <vector>
+
+#include "nds3/impl/epicsInterfaceProxyImpl.h"
+#include "nds3/impl/epicsInterfaceImpl.h"
+
+namespace nds
+{
+
+/*
+ * Constructor
+ *
+ *************/
+EpicsInterfaceProxyImpl::EpicsInterfaceProxyImpl(EpicsInterfaceImpl* pInterface): m_pInterface(pInterface)
+{
+}
+
+
+/*
+ * Destructor: the PVs of a destroyed port stop being served
+ *
+ ***********************************************************/
+EpicsInterfaceProxyImpl::~EpicsInterfaceProxyImpl()
+{
+    std::vector<std::shared_ptr<PVBaseImpl> > pvs;
+    {
+        std::lock_guard<std::mutex> lock(m_pvsLock);
+        for(pvs_t::const_iterator scanPVs(m_pvs.begin()), endPVs(m_pvs.end()); scanPVs != endPVs; ++scanPVs)
+        {
+            pvs.push_back(scanPVs->second);
+        }
+        m_pvs.clear();
+    }
+
+    for(std::vector<std::shared_ptr<PVBaseImpl> >::const_iterator scanPVs(pvs.begin()), endPVs(pvs.end()); scanPVs != endPVs; ++scanPVs)
+    {
+        m_pInterface->deregisterPV(*scanPVs);
+    }
+}
+
+
+void EpicsInterfaceProxyImpl::registerPV(std::shared_ptr<PVBaseImpl> pv)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_pvsLock);
+        m_pvs[pv.get()] = pv;
+    }
+    m_pInterface->registerPV(pv);
+}
+
+
+void EpicsInterfaceProxyImpl::deregisterPV(std::shared_ptr<PVBaseImpl> pv)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_pvsLock);
+        m_pvs.erase(pv.get());
+    }
+    m_pInterface->deregisterPV(pv);
+}
+
+
+void EpicsInterfaceProxyImpl::registrationTerminated()
+{
+    m_pInterface->registrationTerminated();
+}
+
+
+/*
+ * Forward the pushed values
+ *
+ ***************************/
+void EpicsInterfaceProxyImpl::push(const PVBaseImpl& pv, const timespec& timestamp, const std::int32_t& value)
+{
+    m_pInterface->push(pv, timestamp, value);
+}
+
+void EpicsInterfaceProxyImpl::push(const PVBaseImpl& pv, const timespec& timestamp, const double& value)
+{
+    m_pInterface->push(pv, timestamp, value);
+}
+
+void EpicsInterfaceProxyImpl::push(const PVBaseImpl& pv, const timespec& timestamp, const std::vector<std::int8_t> & value)
+{
+    m_pInterface->push(pv, timestamp, value);
+}
+
+void EpicsInterfaceProxyImpl::push(const PVBaseImpl& pv, const timespec& timestamp, const std::vector<std::uint8_t> & value)
+{
+    m_pInterface->push(pv, timestamp, value);
+}
+
+void EpicsInterfaceProxyImpl::push(const PVBaseImpl& pv, const timespec& timestamp, const std::vector<std::int32_t> & value)
+{
+    m_pInterface->push(pv, timestamp, value);
+}
+
+void EpicsInterfaceProxyImpl::push(const PVBaseImpl& pv, const timespec& timestamp, const std::vector<double> & value)
+{
+    m_pInterface->push(pv, timestamp, value);
+}
+
+void EpicsInterfaceProxyImpl::push(const PVBaseImpl& pv, const timespec& timestamp, const std::string& value)
+{
+    m_pInterface->push(pv, timestamp, value);
+}
+
+#ifdef NDS3_EXTENDED_DATA_TYPES
+void EpicsInterfaceProxyImpl::push(const PVBaseImpl& pv, const timespec& timestamp, const std::vector<std::int16_t> & value)
+{
+    m_pInterface->push(pv, timestamp, value);
+}
+
+void EpicsInterfaceProxyImpl::push(const PVBaseImpl& pv, const timespec& timestamp, const std::vector<std::uint16_t> & value)
+{
+    m_pInterface->push(pv, timestamp, value);
+}
+
+void EpicsInterfaceProxyImpl::push(const PVBaseImpl& pv, const timespec& timestamp, const std::vector<float> & value)
+{
+    m_pInterface->push(pv, timestamp, value);
+}
+
+void EpicsInterfaceProxyImpl::push(const PVBaseImpl& pv, const timespec& timestamp, const std::int64_t& value)
+{
+    m_pInterface->push(pv, timestamp, value);
+}
+
+void EpicsInterfaceProxyImpl::push(const PVBaseImpl& pv, const timespec& timestamp, const std::vector<std::int64_t> & value)
+{
+    m_pInterface->push(pv, timestamp, value);
+}
+#endif
+
+}
@@ -0,0 +1,152 @@
+/*
+ * EPICS support for NDS3
+ *
+ * Copyright (c) 2015 Cosylab d.d.
+ *
+ * For more information about the license please refer to the license.txt
+ * file included in the distribution.
+ */
+
+/**
+ * @file epicsLatencyHistogram.cpp
+ *
+ * Fixed memory latency histograms.
+ *
+ */
+
+#include <algorithm>
+
+#include "nds3/impl/epicsLatencyHistogram.h"
+
+namespace nds
+{
+
+const size_t EpicsLatencyHistogram::subBucketBits;
+const size_t EpicsLatencyHistogram::subBuckets;
+const size_t EpicsLatencyHistogram::numGroups;
+const size_t EpicsLatencyHistogram::numBuckets;
+
+EpicsLatencyHistogram::EpicsLatencyHistogram()
+{
+    reset();
+}
+
+
+void EpicsLatencyHistogram::reset()
+{
+    for(size_t scanBuckets(0); scanBuckets != numBuckets; ++scanBuckets)
+    {
+        m_buckets[scanBuckets].store(0, std::memory_order_relaxed);
+    }
+    m_sumNanoseconds.store(0, std::memory_order_relaxed);
+    m_maxNanoseconds.store(0, std::memory_order_relaxed);
+}
+
+
+void EpicsLatencyHistogram::merge(const EpicsLatencyHistogram& other)
+{
+    for(size_t scanBuckets(0); scanBuckets != numBuckets; ++scanBuckets)
+    {
+        m_buckets[scanBuckets].fetch_add(other.m_buckets[scanBuckets].load(std::memory_order_relaxed), std::memory_order_relaxed);
+    }
+    m_sumNanoseconds.fetch_add(other.m_sumNanoseconds.load(std::memory_order_relaxed), std::memory_order_relaxed);
+
+    std::uint64_t otherMaxNanoseconds(other.m_maxNanoseconds.load(std::memory_order_relaxed));
+    std::uint64_t maxNanoseconds(m_maxNanoseconds.load(std::memory_order_relaxed));
+    while(otherMaxNanoseconds > maxNanoseconds &&
+          !m_maxNanoseconds.compare_exchange_weak(maxNanoseconds, otherMaxNanoseconds, std::memory_order_relaxed))
+    {
+    }
+}
+
+
+std::uint64_t EpicsLatencyHistogram::getBucketUpperBound(size_t bucket)
+{
+    size_t group(bucket / subBuckets);
+    std::uint64_t subBucket(bucket % subBuckets);
+    if(group == 0)
+    {
+        return subBucket;
+    }
+    std::uint64_t lowerBound((subBuckets + subBucket) << (group - 1));
+    return lowerBound + ((std::uint64_t)1 << (group - 1)) - 1;
+}
+
+
+/*
+ * Compute the percentiles from a copy of the buckets
+ *
+ ****************************************************/
+void EpicsLatencyHistogram::getSummary(latencySummary_t* pSummary) const
+{
+    std::uint64_t buckets[numBuckets];
+    std::uint64_t count(0);
+    for(size_t scanBuckets(0); scanBuckets != numBuckets; ++scanBuckets)
+    {
+        buckets[scanBuckets] = m_buckets[scanBuckets].load(std::memory_order_relaxed);
+        count += buckets[scanBuckets];
+    }
+
+    pSummary->m_count = count;
+    pSummary->m_maxNanoseconds = m_maxNanoseconds.load(std::memory_order_relaxed);
+    pSummary->m_meanNanoseconds = count == 0 ? 0.0 : (double)m_sumNanoseconds.load(std::memory_order_relaxed) / (double)count;
+
+    static const double quantiles[] = {0.5, 0.9, 0.99, 0.999};
+    std::uint64_t* percentiles[] = {&pSummary->m_p50Nanoseconds, &pSummary->m_p90Nanoseconds,
+                                    &pSummary->m_p99Nanoseconds, &pSummary->m_p999Nanoseconds};
+
+    size_t bucket(0);
+    std::uint64_t cumulated(0);
+    for(size_t scanQuantiles(0); scanQuantiles != sizeof(quantiles) / sizeof(quantiles[0]); ++scanQuantiles)
+    {
+        if(count == 0)
+        {
+            *percentiles[scanQuantiles] = 0;
+            continue;
+        }
+
+        // Rank of the percentile, starting from 1
+        std::uint64_t rank((std::uint64_t)(quantiles[scanQuantiles] * (double)count + 0.999999));
+        rank = std::max(rank, (std::uint64_t)1);
+        while(bucket != numBuckets - 1 && cumulated + buckets[bucket] < rank)
+        {
+            cumulated += buckets[bucket++];
+        }
+        *percentiles[scanQuantiles] = std::min(getBucketUpperBound(bucket), pSummary->m_maxNanoseconds);
+    }
+}
+
+
+void EpicsLatencyHistograms::reset()
+{
+    m_acquisitionToPush.reset();
+    m_pushToCallbacks.reset();
+    m_readService.reset();
+    m_writeService.reset();
+}
+
+
+void EpicsLatencyHistograms::report(FILE* pFile, const std::string& name) const
+{
+    static const char* titles[] = {"acquisition to push", "push to callbacks", "read service", "write service"};
+    const EpicsLatencyHistogram* histograms[] = {&m_acquisitionToPush, &m_pushToCallbacks, &m_readService, &m_writeService};
+
+    fprintf(pFile, "%s\n", name.c_str());
+    fprintf(pFile, "    %-20s %12s %10s %10s %10s %10s %10s %10s\n", "latency (us)", "count", "mean", "p50", "p90", "p99", "p99.9", "max");
+    for(size_t scanHistograms(0); scanHistograms != sizeof(histograms) / sizeof(histograms[0]); ++scanHistograms)
+    {
+        latencySummary_t summary;
+        histograms[scanHistograms]->getSummary(&summary);
+        fprintf(pFile, "    %-20s %12llu %10.1f %10.1f %10.1f %10.1f %10.1f %10.1f\n",
+                titles[scanHistograms],
+                (unsigned long long)summary.m_count,
+                summary.m_meanNanoseconds / 1000.0,
+                (double)summary.m_p50Nanoseconds / 1000.0,
+                (double)summary.m_p90Nanoseconds / 1000.0,
+                (double)summary.m_p99Nanoseconds / 1000.0,
+                (double)summary.m_p999Nanoseconds / 1000.0,
+                (double)summary.m_maxNanoseconds / 1000.0);
+    }
+}
+
+}
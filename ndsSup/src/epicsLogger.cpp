@@ -0,0 +1,294 @@
+/*
+ * EPICS support for NDS3
+ *
+ * Copyright (c) 2015 Cosylab d.d.
+ *
+ * For more information about the license please refer to the license.txt
+ * file included in the distribution.
+ */
+
+/**
+ * @file epicsLogger.cpp
+ *
+ * Forwards the log messages to errlog from a background thread.
+ *
+ */
+
+#include <functional>
+#include <stdexcept>
+#include <cstring>
+
+#include <errlog.h>
+#include <epicsExit.h>
+
+#include "nds3/impl/epicsLogger.h"
+
+namespace nds
+{
+
+/*
+ * Constructor
+ *
+ *************/
+EpicsLogger::EpicsLogger(FactoryBaseImpl* pFactory, size_t capacity):
+    m_queue(capacity),
+    m_messagesPerSecond(100),
+    m_burst(100),
+    m_running(true),
+    m_forwarderSleeping(false),
+    m_queuedMessages(0),
+    m_forwardedMessages(0),
+    m_droppedMessages(0),
+    m_suppressedMessages(0),
+    m_truncatedMessages(0),
+    m_reportedDropped(0)
+{
+    m_forwarderEvent = epicsEventCreate(epicsEventEmpty);
+    if(m_forwarderEvent == 0)
+    {
+        throw std::runtime_error("Cannot allocate an EPICS event");
+    }
+
+    m_pThread.reset(new EpicsThread(pFactory, "ndsLogger", std::bind(&EpicsLogger::forwardMessages, this)));
+
+    // Don't lose the messages logged just before the IOC exits
+    epicsAtExit(&EpicsLogger::atExit, this);
+}
+
+
+/*
+ * Destructor. Stops the background thread
+ *
+ *****************************************/
+EpicsLogger::~EpicsLogger()
+{
+    m_running.store(false);
+    epicsEventSignal(m_forwarderEvent);
+    m_pThread->join();
+
+    epicsEventDestroy(m_forwarderEvent);
+}
+
+
+void EpicsLogger::setRateLimit(double messagesPerSecond, double burst)
+{
+    m_messagesPerSecond.store(messagesPerSecond);
+    m_burst.store(burst < 1 ? 1 : burst);
+}
+
+
+/*
+ * Token bucket of the source
+ *
+ ****************************/
+bool EpicsLogger::acceptMessage(logRateLimiter_t* pSource)
+{
+    const double messagesPerSecond(m_messagesPerSecond.load(std::memory_order_relaxed));
+    if(messagesPerSecond <= 0)
+    {
+        return true;
+    }
+    const double burst(m_burst.load(std::memory_order_relaxed));
+
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    if(pSource->m_tokens < 0)
+    {
+        pSource->m_tokens = burst;
+    }
+    else
+    {
+        double elapsedSeconds = (double)(now.tv_sec - pSource->m_lastRefill.tv_sec) +
+                (double)(now.tv_nsec - pSource->m_lastRefill.tv_nsec) / 1.0e9;
+        pSource->m_tokens += elapsedSeconds * messagesPerSecond;
+        if(pSource->m_tokens > burst)
+        {
+            pSource->m_tokens = burst;
+        }
+    }
+    pSource->m_lastRefill = now;
+
+    if(pSource->m_tokens < 1)
+    {
+        return false;
+    }
+    pSource->m_tokens -= 1;
+    return true;
+}
+
+
+/*
+ * Copy a message into the queue
+ *
+ *******************************/
+void EpicsLogger::log(logRateLimiter_t* pSource, logLevel_t logLevel, const char* pText, size_t length)
+{
+    if(!acceptMessage(pSource))
+    {
+        ++pSource->m_suppressed;
+        m_suppressedMessages.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    logMessage_t message;
+    message.m_logLevel = logLevel;
+    message.m_suppressedBefore = pSource->m_suppressed;
+    if(length > maxMessageLength)
+    {
+        // Keep the beginning of the message and mark the truncation
+        static const char truncated[] = "...\n";
+        message.m_length = maxMessageLength;
+        ::memcpy(message.m_text, pText, maxMessageLength - sizeof(truncated) + 1);
+        ::memcpy(message.m_text + maxMessageLength - sizeof(truncated) + 1, truncated, sizeof(truncated) - 1);
+        m_truncatedMessages.fetch_add(1, std::memory_order_relaxed);
+    }
+    else
+    {
+        message.m_length = length;
+        ::memcpy(message.m_text, pText, length);
+    }
+    message.m_text[message.m_length] = 0;
+
+    if(!m_queue.tryPush(message))
+    {
+        // Reported globally by reportDropped() and with the source's next message
+        ++pSource->m_suppressed;
+        m_droppedMessages.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    pSource->m_suppressed = 0;
+    m_queuedMessages.fetch_add(1, std::memory_order_relaxed);
+
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if(m_forwarderSleeping.exchange(false))
+    {
+        epicsEventSignal(m_forwarderEvent);
+    }
+}
+
+
+/*
+ * Background thread
+ *
+ *******************/
+void EpicsLogger::forwardMessages()
+{
+    logMessage_t message;
+
+    while(m_running.load())
+    {
+        bool forwarded(false);
+        while(m_queue.tryPop(message))
+        {
+            forward(message);
+            forwarded = true;
+        }
+        reportDropped();
+
+        if(!forwarded)
+        {
+            // Tell the producers that we are going to sleep, then check again
+            //  for messages that arrived in the meantime.
+            m_forwarderSleeping.store(true);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if(m_queue.size() != 0 || !m_running.load())
+            {
+                m_forwarderSleeping.store(false);
+                continue;
+            }
+            epicsEventWaitWithTimeout(m_forwarderEvent, 0.5);
+            m_forwarderSleeping.store(false);
+        }
+    }
+
+    flush();
+}
+
+
+void EpicsLogger::flush()
+{
+    logMessage_t message;
+    while(m_queue.tryPop(message))
+    {
+        forward(message);
+    }
+    reportDropped();
+}
+
+
+/*
+ * Pass a message to errlog
+ *
+ **************************/
+void EpicsLogger::forward(const logMessage_t& message)
+{
+    errlogSevEnum severity;
+    switch(message.m_logLevel)
+    {
+    case logLevel_t::warning:
+        severity = errlogMinor;
+        break;
+    case logLevel_t::error:
+        severity = errlogMajor;
+        break;
+    default:
+        severity = errlogInfo;
+    }
+
+    if(message.m_suppressedBefore != 0)
+    {
+        errlogSevPrintf(severity, "Suppressed %llu messages of the following source (rate limit or full queue)\n",
+                        (unsigned long long)message.m_suppressedBefore);
+    }
+    errlogSevPrintf(severity, "%s", message.m_text);
+    m_forwardedMessages.fetch_add(1, std::memory_order_relaxed);
+}
+
+
+/*
+ * Log the number of messages dropped since the last report
+ *
+ **********************************************************/
+void EpicsLogger::reportDropped()
+{
+    std::uint64_t dropped(m_droppedMessages.load(std::memory_order_relaxed));
+    std::uint64_t reported(m_reportedDropped.exchange(dropped));
+    if(dropped > reported)
+    {
+        errlogSevPrintf(errlogMinor, "Log queue full: dropped %llu messages\n", (unsigned long long)(dropped - reported));
+    }
+}
+
+
+void EpicsLogger::atExit(void* pParameter)
+{
+    ((EpicsLogger*)pParameter)->flush();
+}
+
+
+/*
+ * Print the counters (ndsLogReport)
+ *
+ ***********************************/
+void EpicsLogger::report(FILE* pFile) const
+{
+    double messagesPerSecond(m_messagesPerSecond.load());
+    if(messagesPerSecond > 0)
+    {
+        fprintf(pFile, "Rate limit: %g messages/s per source, burst %g\n", messagesPerSecond, m_burst.load());
+    }
+    else
+    {
+        fprintf(pFile, "Rate limit: disabled\n");
+    }
+    fprintf(pFile, "Queue: %zu/%zu messages\n", m_queue.size(), m_queue.capacity());
+    fprintf(pFile, "Queued: %llu, forwarded: %llu, dropped (queue full): %llu, suppressed (rate limit): %llu, truncated: %llu\n",
+            (unsigned long long)m_queuedMessages.load(),
+            (unsigned long long)m_forwardedMessages.load(),
+            (unsigned long long)m_droppedMessages.load(),
+            (unsigned long long)m_suppressedMessages.load(),
+            (unsigned long long)m_truncatedMessages.load());
+}
+
+}
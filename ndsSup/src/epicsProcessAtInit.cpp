@@ -0,0 +1,160 @@
+/*
+ * EPICS support for NDS3
+ *
+ * Copyright (c) 2015 Cosylab d.d.
+ *
+ * For more information about the license please refer to the license.txt
+ * file included in the distribution.
+ */
+
+/**
+ * @file epicsProcessAtInit.cpp
+ *
+ * Processing of the records of the PVs declared with processAtInit.
+ *
+ */
+
+#include <ctime>
+
+#include <dbAccess.h>
+#include <dbCommon.h>
+#include <epicsTypes.h>
+#include <errlog.h>
+
+#include "nds3/impl/epicsProcessAtInit.h"
+
+namespace nds
+{
+
+/*
+ * Constructor
+ *
+ *************/
+EpicsProcessAtInit::EpicsProcessAtInit(): m_pendingRequests(0), m_allDone(epicsEventMustCreate(epicsEventEmpty))
+{
+}
+
+
+/*
+ * Destructor
+ *
+ ************/
+EpicsProcessAtInit::~EpicsProcessAtInit()
+{
+    epicsEventDestroy(m_allDone);
+}
+
+
+void EpicsProcessAtInit::addRecord(const std::string& recordName)
+{
+    m_recordNames.push_back(recordName);
+}
+
+
+/*
+ * Process all the records
+ *
+ *************************/
+void EpicsProcessAtInit::process(bool parallel)
+{
+    if(m_recordNames.empty())
+    {
+        return;
+    }
+
+    timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    // Resolve the PROC fields of the records. The vector is not resized
+    //  after this point: the callback queues keep pointers to its elements
+    std::vector<request_t> requests;
+    requests.reserve(m_recordNames.size());
+    size_t notFound(0);
+    for(std::vector<std::string>::const_iterator scanNames(m_recordNames.begin()), endNames(m_recordNames.end());
+        scanNames != endNames;
+        ++scanNames)
+    {
+        requests.push_back(request_t());
+        if(dbNameToAddr((*scanNames + ".PROC").c_str(), &requests.back().m_procAddress) != 0)
+        {
+            errlogSevPrintf(errlogMinor, "Cannot process the record %s at init: record not found\n", scanNames->c_str());
+            requests.pop_back();
+            ++notFound;
+            continue;
+        }
+        requests.back().m_pOwner = this;
+    }
+
+    // The additional request is released after all the others have been
+    //  queued, so the event is signalled only once
+    m_pendingRequests = 1;
+    size_t queued(0);
+    for(std::vector<request_t>::iterator scanRequests(requests.begin()), endRequests(requests.end());
+        scanRequests != endRequests;
+        ++scanRequests)
+    {
+        if(parallel)
+        {
+            callbackSetCallback(processCallback, &scanRequests->m_callback);
+            callbackSetPriority(priorityMedium, &scanRequests->m_callback);
+            callbackSetUser(&(*scanRequests), &scanRequests->m_callback);
+            ++m_pendingRequests;
+            if(callbackRequest(&scanRequests->m_callback) == 0)
+            {
+                ++queued;
+                continue;
+            }
+
+            // Queue full: process the record here
+            --m_pendingRequests;
+        }
+        processRecord(&scanRequests->m_procAddress);
+    }
+    requestDone();
+    epicsEventMustWait(m_allDone);
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double seconds((double)(end.tv_sec - start.tv_sec) + (double)(end.tv_nsec - start.tv_nsec) / 1.0e9);
+    errlogSevPrintf(errlogInfo, "Processed %zu records at init in %.3f s (%zu through the callback queues, %zu not found)\n",
+                    requests.size(), seconds, queued, notFound);
+
+    m_recordNames.clear();
+}
+
+
+/*
+ * Write the PROC field as dbpf does: if the record is still completing a
+ *  previous processing (PACT set) then dbPutField sets RPRO, so the
+ *  record is processed again instead of ignoring the request
+ *
+ **************************************************************************/
+void EpicsProcessAtInit::processRecord(DBADDR* pProcAddress)
+{
+    epicsUInt8 one(1);
+    if(dbPutField(pProcAddress, DBR_UCHAR, &one, 1) != 0)
+    {
+        errlogSevPrintf(errlogMinor, "Cannot process the record %s at init\n", pProcAddress->precord->name);
+    }
+}
+
+
+void EpicsProcessAtInit::processCallback(CALLBACK* pCallback)
+{
+    void* pUser;
+    callbackGetUser(pUser, pCallback);
+    request_t* pRequest(static_cast<request_t*>(pUser));
+
+    processRecord(&pRequest->m_procAddress);
+    pRequest->m_pOwner->requestDone();
+}
+
+
+void EpicsProcessAtInit::requestDone()
+{
+    if(m_pendingRequests.fetch_sub(1) == 1)
+    {
+        epicsEventSignal(m_allDone);
+    }
+}
+
+}
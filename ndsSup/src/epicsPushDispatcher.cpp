@@ -0,0 +1,362 @@
+/*
+ * EPICS support for NDS3
+ *
+ * Copyright (c) 2015 Cosylab d.d.
+ *
+ * For more information about the license please refer to the license.txt
+ * file included in the distribution.
+ */
+
+/**
+ * @file epicsPushDispatcher.cpp
+ *
+ * Contains the queue and the thread that deliver the pushed values to EPICS
+ *  when the push queue is enabled on a port.
+ *
+ */
+
+#include <stdexcept>
+#include <functional>
+
+#include "nds3/impl/epicsPushDispatcher.h"
+#include "nds3/impl/epicsFactoryImpl.h"
+#include "nds3/impl/epicsThread.h"
+
+namespace nds
+{
+
+/*
+ * Maximum number of values delivered before checking the latest values
+ *  and waking up the blocked producers
+ *
+ ***********************************************************************/
+static const size_t dispatchBatchSize(256);
+
+/*
+ * Constructor
+ *
+ *************/
+EpicsPushDispatcher::EpicsPushDispatcher(EpicsFactoryImpl* pFactory, EpicsInterfaceImpl* pInterface, const std::string& portName,
+                                         size_t queueSize, pushQueueOverflow_t overflowPolicy):
+    m_pInterface(pInterface),
+    m_overflowPolicy(overflowPolicy),
+    m_queue(queueSize),
+    m_numPendingLatest(0),
+    m_running(true),
+    m_dispatcherSleeping(false),
+    m_waitingProducers(0),
+    m_queuedValues(0),
+    m_droppedValues(0),
+    m_deliveryErrors(0),
+    m_maxDepth(0)
+{
+    m_dispatcherEvent = epicsEventCreate(epicsEventEmpty);
+    m_spaceEvent = epicsEventCreate(epicsEventEmpty);
+    if(m_dispatcherEvent == 0 || m_spaceEvent == 0)
+    {
+        throw std::runtime_error("Cannot allocate an EPICS event");
+    }
+
+    m_pThread.reset(new EpicsThread(pFactory, portName + "-push", std::bind(&EpicsPushDispatcher::dispatch, this)));
+}
+
+
+/*
+ * Destructor. Stops the dispatcher thread
+ *
+ *****************************************/
+EpicsPushDispatcher::~EpicsPushDispatcher()
+{
+    m_running.store(false);
+    epicsEventSignal(m_dispatcherEvent);
+    m_pThread->join();
+
+    epicsEventDestroy(m_dispatcherEvent);
+    epicsEventDestroy(m_spaceEvent);
+}
+
+
+/*
+ * Allocate the latest values for the new reasons.
+ *
+ * Called during the registration of the PVs, before they push data.
+ *
+ *******************************************************************/
+void EpicsPushDispatcher::setNumReasons(size_t numReasons)
+{
+    if(m_latestValuesIndex.isPublished() && m_latestValues.size() >= numReasons)
+    {
+        return;
+    }
+
+    while(m_latestValues.size() < numReasons)
+    {
+        m_latestValues.push_back(std::unique_ptr<latestValue_t>(new latestValue_t));
+    }
+
+    // Publish a new index: the existing one is deleted once the producers
+    //  don't use it anymore
+    std::unique_ptr<latestValuesIndex_t> pIndex(new latestValuesIndex_t);
+    pIndex->reserve(m_latestValues.size());
+    for(std::vector<std::unique_ptr<latestValue_t> >::const_iterator scanValues(m_latestValues.begin()), endValues(m_latestValues.end());
+        scanValues != endValues;
+        ++scanValues)
+    {
+        pIndex->push_back(scanValues->get());
+    }
+    m_latestValuesIndex.publish(std::move(pIndex));
+}
+
+
+EpicsPushDispatcher::latestValue_t& EpicsPushDispatcher::getLatestValue(size_t reason) const
+{
+    EpicsSnapshot<latestValuesIndex_t>::reader_t index(m_latestValuesIndex);
+    return *(*index.get())[reason];
+}
+
+
+/*
+ * Queue a value. Called by push() on the drivers' threads
+ *
+ *********************************************************/
+void EpicsPushDispatcher::enqueue(queuedPush_t& push)
+{
+    switch(m_overflowPolicy)
+    {
+    case pushQueueOverflow_t::block:
+        while(!m_queue.tryPush(push))
+        {
+            ++m_waitingProducers;
+            epicsEventWaitWithTimeout(m_spaceEvent, 0.01);
+            --m_waitingProducers;
+        }
+        break;
+
+    case pushQueueOverflow_t::dropOldest:
+        while(!m_queue.tryPush(push))
+        {
+            queuedPush_t oldest;
+            if(m_queue.tryPop(oldest))
+            {
+                ++m_droppedValues;
+            }
+        }
+        break;
+
+    case pushQueueOverflow_t::keepLatest:
+        {
+            latestValue_t& latestValue(getLatestValue(push.m_reason));
+
+            // Once a PV has a pending latest value all its new values replace it,
+            //  so they are not delivered before older values.
+            {
+                std::lock_guard<std::mutex> lock(latestValue.m_lock);
+                if(latestValue.m_pending)
+                {
+                    latestValue.m_push = std::move(push);
+                    ++m_droppedValues;
+                    return;
+                }
+            }
+
+            if(m_queue.tryPush(push))
+            {
+                break;
+            }
+
+            std::lock_guard<std::mutex> lock(latestValue.m_lock);
+            if(latestValue.m_pending)
+            {
+                ++m_droppedValues;
+            }
+            else
+            {
+                latestValue.m_pending = true;
+                latestValue.m_enqueuePosition = m_queue.getEnqueuePosition();
+
+                std::lock_guard<std::mutex> lockPending(m_pendingLatestLock);
+                m_pendingLatest.push_back(push.m_reason);
+                ++m_numPendingLatest;
+            }
+            latestValue.m_push = std::move(push);
+            wakeDispatcher();
+            return;
+        }
+    }
+
+    ++m_queuedValues;
+    wakeDispatcher();
+}
+
+
+/*
+ * Wake up the dispatcher thread if it is waiting for data
+ *
+ *********************************************************/
+void EpicsPushDispatcher::wakeDispatcher()
+{
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if(m_dispatcherSleeping.exchange(false))
+    {
+        epicsEventSignal(m_dispatcherEvent);
+    }
+}
+
+
+/*
+ * Dispatcher thread
+ *
+ *******************/
+void EpicsPushDispatcher::dispatch()
+{
+    queuedPush_t push;
+
+    while(m_running.load())
+    {
+        size_t depth(m_queue.size());
+        if(depth > m_maxDepth.load(std::memory_order_relaxed))
+        {
+            m_maxDepth.store(depth, std::memory_order_relaxed);
+        }
+
+        size_t delivered(0);
+        while(delivered != dispatchBatchSize && m_queue.tryPop(push))
+        {
+            deliver(push);
+            ++delivered;
+        }
+
+        if(delivered != 0 && m_waitingProducers.load() != 0)
+        {
+            epicsEventSignal(m_spaceEvent);
+        }
+
+        if(m_numPendingLatest.load() != 0)
+        {
+            deliverLatestValues();
+        }
+
+        if(delivered == 0)
+        {
+            // Tell the producers that we are going to sleep, then check again
+            //  for data that arrived in the meantime.
+            m_dispatcherSleeping.store(true);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if(m_queue.size() != 0 || m_numPendingLatest.load() != 0 || !m_running.load())
+            {
+                m_dispatcherSleeping.store(false);
+                continue;
+            }
+            epicsEventWaitWithTimeout(m_dispatcherEvent, 0.1);
+            m_dispatcherSleeping.store(false);
+        }
+    }
+
+    // Deliver what is left in the queue, then the latest values that
+    //  didn't fit in it
+    while(m_queue.size() != 0 || m_numPendingLatest.load() != 0)
+    {
+        while(m_queue.tryPop(push))
+        {
+            deliver(push);
+        }
+        if(m_numPendingLatest.load() != 0)
+        {
+            deliverLatestValues();
+        }
+    }
+}
+
+
+/*
+ * Deliver one value to the asyn subscribers and release its data.
+ *
+ * An exception thrown while delivering a value must not terminate the
+ *  dispatcher thread: it is counted and the next values are delivered
+ *
+ ***********************************************************************/
+void EpicsPushDispatcher::deliver(queuedPush_t& push)
+{
+    try
+    {
+        push.m_deliver(m_pInterface, push);
+    }
+    catch(const std::exception&)
+    {
+        ++m_deliveryErrors;
+    }
+    catch(...)
+    {
+        ++m_deliveryErrors;
+    }
+    push.m_pArray.reset();
+}
+
+
+/*
+ * Deliver the latest values that didn't fit in the queue, once the values
+ *  queued before them have been delivered
+ *
+ *************************************************************************/
+void EpicsPushDispatcher::deliverLatestValues()
+{
+    std::vector<size_t> pendingLatest;
+    {
+        std::lock_guard<std::mutex> lockPending(m_pendingLatestLock);
+        pendingLatest.swap(m_pendingLatest);
+    }
+
+    size_t dequeuePosition(m_queue.getDequeuePosition());
+    std::vector<size_t> stillPending;
+
+    for(std::vector<size_t>::const_iterator scanReasons(pendingLatest.begin()), endReasons(pendingLatest.end());
+        scanReasons != endReasons;
+        ++scanReasons)
+    {
+        latestValue_t& latestValue(getLatestValue(*scanReasons));
+        queuedPush_t push;
+        {
+            std::lock_guard<std::mutex> lock(latestValue.m_lock);
+            if(latestValue.m_enqueuePosition > dequeuePosition)
+            {
+                stillPending.push_back(*scanReasons);
+                continue;
+            }
+            push = std::move(latestValue.m_push);
+            latestValue.m_pending = false;
+        }
+        --m_numPendingLatest;
+        deliver(push);
+    }
+
+    if(!stillPending.empty())
+    {
+        std::lock_guard<std::mutex> lockPending(m_pendingLatestLock);
+        m_pendingLatest.insert(m_pendingLatest.end(), stillPending.begin(), stillPending.end());
+    }
+}
+
+
+std::uint64_t EpicsPushDispatcher::getDroppedValues() const
+{
+    return m_droppedValues.load();
+}
+
+
+/*
+ * Print the status of the queue (called by asynReport)
+ *
+ ******************************************************/
+void EpicsPushDispatcher::report(FILE* pFile) const
+{
+    static const char* policyNames[] = {"block", "dropOldest", "keepLatest"};
+
+    fprintf(pFile, "    Push queue: capacity %zu, overflow policy %s\n", m_queue.capacity(), policyNames[(size_t)m_overflowPolicy]);
+    fprintf(pFile, "      depth %zu, max depth %zu\n", m_queue.size(), m_maxDepth.load());
+    fprintf(pFile, "      queued %llu, dropped %llu, delivery errors %llu\n",
+            (unsigned long long)m_queuedValues.load(),
+            (unsigned long long)m_droppedValues.load(),
+            (unsigned long long)m_deliveryErrors.load());
+}
+
+}
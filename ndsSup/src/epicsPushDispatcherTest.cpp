@@ -0,0 +1,264 @@
+/*
+ * EPICS support for NDS3
+ *
+ * Copyright (c) 2015 Cosylab d.d.
+ *
+ * For more information about the license please refer to the license.txt
+ * file included in the distribution.
+ */
+
+/**
+ * @file epicsPushDispatcherTest.cpp
+ *
+ * Checks the overflow policies of the push queue and the delivery of the
+ *  queued values on shutdown, run with "make runtests".
+ *
+ */
+
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <utility>
+
+#include <epicsThread.h>
+#include <epicsEvent.h>
+#include <epicsUnitTest.h>
+#include <testMain.h>
+
+#include "nds3/impl/epicsPushDispatcher.h"
+
+/*
+ * Records the delivered values. The delivery of the first value waits
+ *  until the test opens the gate, so the test can fill the queue
+ *
+ *********************************************************************/
+typedef std::pair<size_t, int> delivered_t; ///< Reason and value
+
+static std::mutex deliveredLock;
+static std::vector<delivered_t> delivered;
+static epicsEventId deliveryStarted;
+static epicsEventId gate;
+
+static void deliverValue(nds::EpicsInterfaceImpl* /* pInterface */, const nds::queuedPush_t& push)
+{
+    bool first;
+    {
+        std::lock_guard<std::mutex> lock(deliveredLock);
+        first = delivered.empty();
+        delivered.push_back(delivered_t(push.m_reason, push.getScalar<int>()));
+    }
+    if(first)
+    {
+        epicsEventSignal(deliveryStarted);
+        epicsEventWait(gate);
+    }
+}
+
+static void resetDelivered()
+{
+    std::lock_guard<std::mutex> lock(deliveredLock);
+    delivered.clear();
+}
+
+static std::vector<delivered_t> getDelivered()
+{
+    std::lock_guard<std::mutex> lock(deliveredLock);
+    return delivered;
+}
+
+static void enqueue(nds::EpicsPushDispatcher& dispatcher, size_t reason, int value)
+{
+    nds::queuedPush_t push;
+    push.m_deliver = &deliverValue;
+    push.m_reason = reason;
+    push.setScalar(value);
+    dispatcher.enqueue(push);
+}
+
+/*
+ * Wait until the dispatcher has taken the first value and is blocked
+ *  delivering it: the queue is then empty
+ *
+ ********************************************************************/
+static void blockDispatcher(nds::EpicsPushDispatcher& dispatcher, size_t reason)
+{
+    resetDelivered();
+    enqueue(dispatcher, reason, 0);
+    epicsEventWait(deliveryStarted);
+}
+
+static void waitDelivered(size_t numValues)
+{
+    for(size_t retries(0); getDelivered().size() < numValues && retries != 500; ++retries)
+    {
+        epicsThreadSleep(0.01);
+    }
+}
+
+static std::vector<delivered_t> makeExpected(const int* pValues, size_t numValues, size_t reason)
+{
+    std::vector<delivered_t> expected;
+    for(size_t scanValues(0); scanValues != numValues; ++scanValues)
+    {
+        expected.push_back(delivered_t(reason, pValues[scanValues]));
+    }
+    return expected;
+}
+
+/*
+ * dropOldest: the values that don't fit replace the oldest queued ones
+ *
+ **********************************************************************/
+static void testDropOldest()
+{
+    nds::EpicsPushDispatcher dispatcher(0, 0, "dropOldest", 4, nds::pushQueueOverflow_t::dropOldest);
+    blockDispatcher(dispatcher, 0);
+
+    for(int value(1); value != 7; ++value)
+    {
+        enqueue(dispatcher, 0, value);
+    }
+    testOk(dispatcher.getDroppedValues() == 2, "dropOldest: 2 values dropped");
+
+    epicsEventSignal(gate);
+    static const int expectedValues[] = {0, 3, 4, 5, 6};
+    std::vector<delivered_t> expected(makeExpected(expectedValues, 5, 0));
+    waitDelivered(expected.size());
+    testOk(getDelivered() == expected, "dropOldest: the newest values are delivered in order");
+}
+
+/*
+ * block: the producer waits for the dispatcher and nothing is dropped
+ *
+ *********************************************************************/
+struct producer_t
+{
+    nds::EpicsPushDispatcher* m_pDispatcher;
+    int m_numValues;
+    epicsEventId m_done;
+};
+
+static void producerThread(void* pParameter)
+{
+    producer_t* pProducer((producer_t*)pParameter);
+    for(int value(1); value <= pProducer->m_numValues; ++value)
+    {
+        enqueue(*pProducer->m_pDispatcher, 0, value);
+    }
+    epicsEventSignal(pProducer->m_done);
+}
+
+static void testBlock()
+{
+    nds::EpicsPushDispatcher dispatcher(0, 0, "block", 4, nds::pushQueueOverflow_t::block);
+    blockDispatcher(dispatcher, 0);
+
+    producer_t producer;
+    producer.m_pDispatcher = &dispatcher;
+    producer.m_numValues = 6;
+    producer.m_done = epicsEventCreate(epicsEventEmpty);
+    epicsThreadCreate("producer", epicsThreadPriorityMedium, epicsThreadGetStackSize(epicsThreadStackSmall), producerThread, &producer);
+
+    testOk(epicsEventWaitWithTimeout(producer.m_done, 0.2) == epicsEventWaitTimeout, "block: the producer waits when the queue is full");
+
+    epicsEventSignal(gate);
+    testOk(epicsEventWaitWithTimeout(producer.m_done, 5.0) == epicsEventOK, "block: the producer resumes when the queue has space");
+    epicsEventDestroy(producer.m_done);
+
+    static const int expectedValues[] = {0, 1, 2, 3, 4, 5, 6};
+    std::vector<delivered_t> expected(makeExpected(expectedValues, 7, 0));
+    waitDelivered(expected.size());
+    testOk(getDelivered() == expected, "block: all the values are delivered in order");
+    testOk(dispatcher.getDroppedValues() == 0, "block: no value dropped");
+}
+
+/*
+ * keepLatest: the latest value of each PV that didn't fit is delivered
+ *  after the values queued before it
+ *
+ **********************************************************************/
+static void testKeepLatest()
+{
+    nds::EpicsPushDispatcher dispatcher(0, 0, "keepLatest", 4, nds::pushQueueOverflow_t::keepLatest);
+    dispatcher.setNumReasons(2);
+    blockDispatcher(dispatcher, 0);
+
+    // Fill the queue, then overflow on both PVs
+    enqueue(dispatcher, 0, 1);
+    enqueue(dispatcher, 1, 1);
+    enqueue(dispatcher, 0, 2);
+    enqueue(dispatcher, 1, 2);
+    enqueue(dispatcher, 0, 3);
+    enqueue(dispatcher, 0, 4);
+    enqueue(dispatcher, 1, 3);
+    enqueue(dispatcher, 0, 5);
+    testOk(dispatcher.getDroppedValues() == 2, "keepLatest: 2 values overwritten");
+
+    epicsEventSignal(gate);
+    std::vector<delivered_t> expected;
+    expected.push_back(delivered_t(0, 0));
+    expected.push_back(delivered_t(0, 1));
+    expected.push_back(delivered_t(1, 1));
+    expected.push_back(delivered_t(0, 2));
+    expected.push_back(delivered_t(1, 2));
+    expected.push_back(delivered_t(0, 5));
+    expected.push_back(delivered_t(1, 3));
+    waitDelivered(expected.size());
+    testOk(getDelivered() == expected, "keepLatest: the latest values are delivered after the queued ones");
+
+    // The queue has space again
+    enqueue(dispatcher, 1, 4);
+    expected.push_back(delivered_t(1, 4));
+    waitDelivered(expected.size());
+    testOk(getDelivered() == expected, "keepLatest: the next values are queued again");
+}
+
+/*
+ * Destruction: the queued values and the latest values are delivered
+ *  before the dispatcher thread exits
+ *
+ *********************************************************************/
+static void openGateLater(void* /* pParameter */)
+{
+    epicsThreadSleep(0.2);
+    epicsEventSignal(gate);
+}
+
+static void testShutdown()
+{
+    {
+        nds::EpicsPushDispatcher dispatcher(0, 0, "shutdown", 4, nds::pushQueueOverflow_t::keepLatest);
+        dispatcher.setNumReasons(1);
+        blockDispatcher(dispatcher, 0);
+
+        for(int value(1); value != 8; ++value)
+        {
+            enqueue(dispatcher, 0, value);
+        }
+        testOk(dispatcher.getDroppedValues() == 2, "Shutdown: 2 values overwritten");
+
+        // The destructor stops the dispatcher while it is still delivering
+        epicsThreadCreate("openGate", epicsThreadPriorityMedium, epicsThreadGetStackSize(epicsThreadStackSmall), openGateLater, 0);
+    }
+
+    static const int expectedValues[] = {0, 1, 2, 3, 4, 7};
+    testOk(getDelivered() == makeExpected(expectedValues, 6, 0), "Shutdown: the queued and the latest values are delivered");
+}
+
+MAIN(epicsPushDispatcherTest)
+{
+    testPlan(11);
+
+    deliveryStarted = epicsEventCreate(epicsEventEmpty);
+    gate = epicsEventCreate(epicsEventEmpty);
+
+    testDropOldest();
+    testBlock();
+    testKeepLatest();
+    testShutdown();
+
+    epicsEventDestroy(gate);
+    epicsEventDestroy(deliveryStarted);
+
+    return testDone();
+}
@@ -0,0 +1,183 @@
+/*
+ * EPICS support for NDS3
+ *
+ * Copyright (c) 2015 Cosylab d.d.
+ *
+ * For more information about the license please refer to the license.txt
+ * file included in the distribution.
+ */
+
+/**
+ * @file epicsPushFilter.cpp
+ *
+ * Deadband and rate limiting of the pushed values.
+ *
+ */
+
+#include <cmath>
+
+#include "nds3/impl/epicsPushFilter.h"
+
+namespace nds
+{
+
+EpicsPushFilter::EpicsPushFilter(const pushFilterSettings_t& settings):
+    m_settings(settings), m_delivered(false), m_lastValue(0), m_lastInteger(0), m_suppressed(0)
+{
+    m_lastTime.tv_sec = 0;
+    m_lastTime.tv_nsec = 0;
+}
+
+
+/*
+ * Check a scalar against the deadbands and the rate limit
+ *
+ *********************************************************/
+bool EpicsPushFilter::acceptValue(double value)
+{
+    timespec now;
+    if(m_settings.m_minIntervalSeconds > 0)
+    {
+        clock_gettime(CLOCK_MONOTONIC, &now);
+    }
+
+    std::lock_guard<std::mutex> lock(m_lock);
+
+    if(!checkScalar(std::isnan(value) == std::isnan(m_lastValue),
+                    value == m_lastValue || std::isnan(value),
+                    std::fabs(value - m_lastValue),
+                    m_lastValue,
+                    now))
+    {
+        return false;
+    }
+    m_lastValue = value;
+    return true;
+}
+
+
+/*
+ * Check an integer scalar, comparing it exactly with the last value
+ *
+ *******************************************************************/
+bool EpicsPushFilter::acceptValue(std::int64_t value)
+{
+    timespec now;
+    if(m_settings.m_minIntervalSeconds > 0)
+    {
+        clock_gettime(CLOCK_MONOTONIC, &now);
+    }
+
+    std::lock_guard<std::mutex> lock(m_lock);
+
+    // The difference is computed without overflow, then converted
+    std::uint64_t change(value >= m_lastInteger ?
+                             (std::uint64_t)value - (std::uint64_t)m_lastInteger :
+                             (std::uint64_t)m_lastInteger - (std::uint64_t)value);
+    if(!checkScalar(true, change == 0, (double)change, (double)m_lastInteger, now))
+    {
+        return false;
+    }
+    m_lastInteger = value;
+    return true;
+}
+
+
+/*
+ * Apply the deadbands, onChange and the rate limit to a scalar
+ *
+ **************************************************************/
+bool EpicsPushFilter::checkScalar(bool comparable, bool unchanged, double change, double lastValue, const timespec& now)
+{
+    if(m_delivered)
+    {
+        bool suppress(false);
+
+        if(comparable)
+        {
+            if(m_settings.m_onChange && unchanged)
+            {
+                suppress = true;
+            }
+            if(m_settings.m_absoluteDeadband > 0 && change <= m_settings.m_absoluteDeadband)
+            {
+                suppress = true;
+            }
+            if(m_settings.m_relativeDeadband > 0 && change <= m_settings.m_relativeDeadband * std::fabs(lastValue))
+            {
+                suppress = true;
+            }
+        }
+
+        if(!suppress && m_settings.m_minIntervalSeconds > 0 && !checkInterval(now))
+        {
+            suppress = true;
+        }
+
+        if(suppress)
+        {
+            m_suppressed.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+    }
+
+    m_delivered = true;
+    if(m_settings.m_minIntervalSeconds > 0)
+    {
+        m_lastTime = now;
+    }
+    return true;
+}
+
+
+/*
+ * Check an array against the rate limit
+ *
+ ***************************************/
+bool EpicsPushFilter::acceptArray()
+{
+    if(m_settings.m_minIntervalSeconds <= 0)
+    {
+        return true;
+    }
+
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    std::lock_guard<std::mutex> lock(m_lock);
+
+    if(m_delivered && !checkInterval(now))
+    {
+        m_suppressed.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    m_delivered = true;
+    m_lastTime = now;
+    return true;
+}
+
+
+/*
+ * Returns true if enough time elapsed since the last delivered value
+ *
+ ********************************************************************/
+bool EpicsPushFilter::checkInterval(const timespec& now) const
+{
+    double elapsed((double)(now.tv_sec - m_lastTime.tv_sec) + (double)(now.tv_nsec - m_lastTime.tv_nsec) / 1.0e9);
+    return elapsed >= m_settings.m_minIntervalSeconds;
+}
+
+
+std::uint64_t EpicsPushFilter::getSuppressed() const
+{
+    return m_suppressed.load(std::memory_order_relaxed);
+}
+
+
+const pushFilterSettings_t& EpicsPushFilter::getSettings() const
+{
+    return m_settings;
+}
+
+}
@@ -0,0 +1,137 @@
+/*
+ * EPICS support for NDS3
+ *
+ * Copyright (c) 2015 Cosylab d.d.
+ *
+ * For more information about the license please refer to the license.txt
+ * file included in the distribution.
+ */
+
+/**
+ * @file epicsPushFilterTest.cpp
+ *
+ * Checks the deadbands, onChange and the rate limit applied by
+ *  ndsSetPushFilter, run with "make runtests".
+ *
+ */
+
+#include <cmath>
+#include <limits>
+
+#include <epicsThread.h>
+#include <epicsUnitTest.h>
+#include <testMain.h>
+
+#include "nds3/impl/epicsPushFilter.h"
+
+static const double notANumber(std::numeric_limits<double>::quiet_NaN());
+
+static void testAbsoluteDeadband()
+{
+    nds::pushFilterSettings_t settings;
+    settings.m_absoluteDeadband = 0.5;
+    nds::EpicsPushFilter filter(settings);
+
+    testOk(filter.acceptValue(1.0), "Deadband: the first value is delivered");
+    testOk(!filter.acceptValue(1.3), "Deadband: a change smaller than the deadband is suppressed");
+    testOk(!filter.acceptValue(1.5), "Deadband: a change equal to the deadband is suppressed");
+    testOk(filter.acceptValue(1.6), "Deadband: a change larger than the deadband is delivered");
+    testOk(!filter.acceptValue(1.2), "Deadband: the change is measured from the last delivered value");
+    testOk(filter.acceptValue(1.0), "Deadband: a negative change larger than the deadband is delivered");
+    testOk(filter.getSuppressed() == 3, "Deadband: 3 values suppressed");
+}
+
+static void testRelativeDeadband()
+{
+    nds::pushFilterSettings_t settings;
+    settings.m_relativeDeadband = 0.1;
+    nds::EpicsPushFilter filter(settings);
+
+    testOk(filter.acceptValue(100.0), "Relative deadband: the first value is delivered");
+    testOk(!filter.acceptValue(109.0), "Relative deadband: a change of 9% is suppressed");
+    testOk(filter.acceptValue(111.0), "Relative deadband: a change of 11% is delivered");
+    testOk(!filter.acceptValue(101.0), "Relative deadband: the change is relative to the last delivered value");
+
+    nds::EpicsPushFilter zeroFilter(settings);
+    testOk(zeroFilter.acceptValue(0.0), "Relative deadband from 0: the first value is delivered");
+    testOk(!zeroFilter.acceptValue(0.0), "Relative deadband from 0: the same value is suppressed");
+    testOk(zeroFilter.acceptValue(1.0e-300), "Relative deadband from 0: any change is delivered");
+}
+
+static void testNotANumber()
+{
+    nds::pushFilterSettings_t deadbandSettings;
+    deadbandSettings.m_absoluteDeadband = 1.0;
+    nds::EpicsPushFilter deadbandFilter(deadbandSettings);
+
+    testOk(deadbandFilter.acceptValue(1.0), "NaN with deadband: the first value is delivered");
+    testOk(deadbandFilter.acceptValue(notANumber), "NaN with deadband: a number followed by NaN is delivered");
+    testOk(deadbandFilter.acceptValue(notANumber), "NaN with deadband: NaN followed by NaN is delivered");
+    testOk(deadbandFilter.acceptValue(1.0), "NaN with deadband: NaN followed by a number is delivered");
+
+    nds::pushFilterSettings_t onChangeSettings;
+    onChangeSettings.m_onChange = true;
+    nds::EpicsPushFilter onChangeFilter(onChangeSettings);
+
+    testOk(onChangeFilter.acceptValue(notANumber), "NaN with onChange: the first value is delivered");
+    testOk(!onChangeFilter.acceptValue(notANumber), "NaN with onChange: NaN followed by NaN is suppressed");
+    testOk(onChangeFilter.acceptValue(2.0), "NaN with onChange: NaN followed by a number is delivered");
+    testOk(onChangeFilter.acceptValue(notANumber), "NaN with onChange: a number followed by NaN is delivered");
+}
+
+static void testOnChange()
+{
+    nds::pushFilterSettings_t settings;
+    settings.m_onChange = true;
+    nds::EpicsPushFilter filter(settings);
+
+    testOk(filter.acceptValue(3.0), "onChange: the first value is delivered");
+    testOk(!filter.acceptValue(3.0), "onChange: the same value is suppressed");
+    testOk(filter.acceptValue(3.5), "onChange: a different value is delivered");
+    testOk(filter.getSuppressed() == 1, "onChange: 1 value suppressed");
+
+    // Consecutive int64 values above 2^53 are the same double
+    nds::EpicsPushFilter integerFilter(settings);
+    std::int64_t counter((std::int64_t)1 << 60);
+    testOk(integerFilter.acceptValue(counter), "onChange int64: the first value is delivered");
+    testOk(!integerFilter.acceptValue(counter), "onChange int64: the same value is suppressed");
+    testOk(integerFilter.acceptValue(counter + 1), "onChange int64: the next value above 2^53 is delivered");
+}
+
+static void testMinInterval()
+{
+    nds::pushFilterSettings_t settings;
+    settings.m_minIntervalSeconds = 0.2;
+
+    nds::EpicsPushFilter scalarFilter(settings);
+    testOk(scalarFilter.acceptValue(1.0), "minInterval: the first scalar is delivered");
+    testOk(!scalarFilter.acceptValue(2.0), "minInterval: a scalar pushed immediately after is suppressed");
+
+    nds::EpicsPushFilter arrayFilter(settings);
+    testOk(arrayFilter.acceptArray(), "minInterval: the first array is delivered");
+    testOk(!arrayFilter.acceptArray(), "minInterval: an array pushed immediately after is suppressed");
+
+    epicsThreadSleep(0.3);
+    testOk(scalarFilter.acceptValue(3.0), "minInterval: a scalar pushed after the interval is delivered");
+    testOk(arrayFilter.acceptArray(), "minInterval: an array pushed after the interval is delivered");
+
+    // Only the rate limit applies to the arrays
+    nds::pushFilterSettings_t deadbandSettings;
+    deadbandSettings.m_absoluteDeadband = 10;
+    deadbandSettings.m_onChange = true;
+    nds::EpicsPushFilter deadbandFilter(deadbandSettings);
+    testOk(deadbandFilter.acceptArray() && deadbandFilter.acceptArray(), "Arrays are not checked against the deadbands");
+}
+
+MAIN(epicsPushFilterTest)
+{
+    testPlan(36);
+
+    testAbsoluteDeadband();
+    testRelativeDeadband();
+    testNotANumber();
+    testOnChange();
+    testMinInterval();
+
+    return testDone();
+}
@@ -0,0 +1,42 @@
+/*
+ * EPICS support for NDS3
+ *
+ * Copyright (c) 2015 Cosylab d.d.
+ *
+ * For more information about the license please refer to the license.txt
+ * file included in the distribution.
+ */
+
+/**
+ * @file epicsPvStatistics.cpp
+ *
+ * Counters of the operations on the PVs.
+ *
+ */
+
+#include "nds3/impl/epicsPvStatistics.h"
+
+namespace nds
+{
+
+EpicsPvStatistics::EpicsPvStatistics():
+    m_pushes(0), m_callbacks(0), m_reads(0), m_writes(0), m_readNanoseconds(0), m_writeNanoseconds(0), m_errors(0), m_bytes(0)
+{
+}
+
+
+pvStatisticsSnapshot_t EpicsPvStatistics::getSnapshot() const
+{
+    pvStatisticsSnapshot_t snapshot;
+    snapshot.m_pushes = m_pushes.load(std::memory_order_relaxed);
+    snapshot.m_callbacks = m_callbacks.load(std::memory_order_relaxed);
+    snapshot.m_reads = m_reads.load(std::memory_order_relaxed);
+    snapshot.m_writes = m_writes.load(std::memory_order_relaxed);
+    snapshot.m_readNanoseconds = m_readNanoseconds.load(std::memory_order_relaxed);
+    snapshot.m_writeNanoseconds = m_writeNanoseconds.load(std::memory_order_relaxed);
+    snapshot.m_errors = m_errors.load(std::memory_order_relaxed);
+    snapshot.m_bytes = m_bytes.load(std::memory_order_relaxed);
+    return snapshot;
+}
+
+}
@@ -0,0 +1,178 @@
+/*
+ * EPICS support for NDS3
+ *
+ * Copyright (c) 2015 Cosylab d.d.
+ *
+ * For more information about the license please refer to the license.txt
+ * file included in the distribution.
+ */
+
+/**
+ * @file epicsReregistrationTest.cpp
+ *
+ * Destroys and re-creates a device while the IOC is running and checks that
+ *  the values pushed by the new device reach the right records, run with
+ *  "make runtests".
+ *
+ */
+
+#include <string>
+#include <vector>
+#include <sstream>
+#include <cstdint>
+#include <time.h>
+
+#include <nds3/nds3.h>
+
+#include <epicsThread.h>
+#include <dbAccess.h>
+#include <dbUnitTest.h>
+#include <iocsh.h>
+#include <epicsUnitTest.h>
+#include <testMain.h>
+
+extern "C" int epicsReregistrationTest_registerRecordDeviceDriver(struct dbBase* pdbbase);
+
+/*
+ * Device with a few scalar PVs pushed by the test
+ *
+ *************************************************/
+class ReregistrationTestDevice;
+
+static ReregistrationTestDevice* pDevice(0); ///< The device created by ndsCreateDevice
+
+static const size_t numPVs(4);
+
+class ReregistrationTestDevice
+{
+public:
+    ReregistrationTestDevice(nds::Factory& factory, const std::string& deviceName, const nds::namedParameters_t& /* parameters */):
+        m_root(deviceName)
+    {
+        for(size_t scanPVs(0); scanPVs != numPVs; ++scanPVs)
+        {
+            std::ostringstream name;
+            name << "Value-" << scanPVs;
+            m_pvs.push_back(m_root.addChild(nds::PVDelegateIn<std::int32_t>(name.str(), [](timespec* pTimestamp, std::int32_t* pValue)
+            {
+                clock_gettime(CLOCK_REALTIME, pTimestamp);
+                *pValue = 0;
+            })));
+            m_pvs.back().setScanType(nds::scanType_t::interrupt);
+        }
+        m_root.initialize(this, factory);
+        pDevice = this;
+    }
+
+    ~ReregistrationTestDevice()
+    {
+        pDevice = 0;
+    }
+
+    /**
+     * @brief Push firstValue to the first PV, firstValue + 1 to the second...
+     */
+    void push(std::int32_t firstValue)
+    {
+        timespec timestamp;
+        clock_gettime(CLOCK_REALTIME, &timestamp);
+        for(size_t scanPVs(0); scanPVs != numPVs; ++scanPVs)
+        {
+            m_pvs[scanPVs].push(timestamp, firstValue + (std::int32_t)scanPVs);
+        }
+    }
+
+    std::string getRecordName(size_t pvNumber) const
+    {
+        return m_pvs[pvNumber].getFullExternalName();
+    }
+
+private:
+    nds::Port m_root;
+    std::vector<nds::PVDelegateIn<std::int32_t> > m_pvs;
+};
+
+NDS_DEFINE_DRIVER(reregistrationTest, ReregistrationTestDevice);
+
+/*
+ * The records are processed by the I/O Intr scan: wait for the value
+ *
+ ********************************************************************/
+static bool waitValue(const std::string& recordName, std::int32_t expectedValue)
+{
+    DBADDR address;
+    if(dbNameToAddr(recordName.c_str(), &address) != 0)
+    {
+        return false;
+    }
+
+    for(size_t retries(0); retries != 500; ++retries)
+    {
+        epicsInt32 value(0);
+        long options(0);
+        long numElements(1);
+        dbScanLock(address.precord);
+        long status(dbGetField(&address, DBR_LONG, &value, &options, &numElements, 0));
+        dbScanUnlock(address.precord);
+        if(status == 0 && value == expectedValue)
+        {
+            return true;
+        }
+        epicsThreadSleep(0.01);
+    }
+    return false;
+}
+
+static void testPushes(const char* description, std::int32_t firstValue)
+{
+    if(pDevice == 0)
+    {
+        testFail("%s: the device exists", description);
+        return;
+    }
+    testPass("%s: the device exists", description);
+
+    pDevice->push(firstValue);
+
+    bool routed(true);
+    for(size_t scanPVs(0); scanPVs != numPVs; ++scanPVs)
+    {
+        routed = waitValue(pDevice->getRecordName(scanPVs), firstValue + (std::int32_t)scanPVs) && routed;
+    }
+    testOk(routed, "%s: each value reaches the record of its PV", description);
+}
+
+MAIN(epicsReregistrationTest)
+{
+    testPlan(11);
+
+    testdbPrepare();
+    testdbReadDatabase("epicsReregistrationTest.dbd", 0, 0);
+    epicsReregistrationTest_registerRecordDeviceDriver(pdbbase);
+
+    iocshCmd("ndsCreateDevice(reregistrationTest, DEV)");
+
+    testIocInitOk();
+
+    testPushes("Device created before iocInit", 100);
+
+    // The PVs of the new device are likely allocated at the addresses freed
+    //  by the previous one, not necessarily by the PV with the same name
+    for(std::int32_t scanCycles(1); scanCycles != 4; ++scanCycles)
+    {
+        iocshCmd("ndsDestroyDevice(DEV)");
+        testOk(pDevice == 0, "Cycle %d: the device is destroyed", (int)scanCycles);
+        iocshCmd("ndsCreateDevice(reregistrationTest, DEV)");
+
+        std::ostringstream description;
+        description << "Cycle " << scanCycles << ", device re-created";
+        testPushes(description.str().c_str(), 100 * (scanCycles + 1));
+    }
+
+    iocshCmd("ndsDestroyDevice(DEV)");
+
+    testIocShutdownOk();
+    testdbCleanup();
+
+    return testDone();
+}
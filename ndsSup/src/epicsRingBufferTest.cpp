@@ -0,0 +1,208 @@
+/*
+ * EPICS support for NDS3
+ *
+ * Copyright (c) 2015 Cosylab d.d.
+ *
+ * For more information about the license please refer to the license.txt
+ * file included in the distribution.
+ */
+
+/**
+ * @file epicsRingBufferTest.cpp
+ *
+ * Checks the lock-free queue used by the push queue and by the logger,
+ *  run with "make runtests".
+ *
+ */
+
+#include <atomic>
+#include <memory>
+#include <cstdint>
+
+#include <epicsThread.h>
+#include <epicsEvent.h>
+#include <epicsUnitTest.h>
+#include <testMain.h>
+
+#include "nds3/impl/epicsRingBuffer.h"
+
+static void testCapacity()
+{
+    nds::EpicsRingBuffer<int> oneItem(1);
+    testOk(oneItem.capacity() == 2, "The capacity is at least 2");
+
+    nds::EpicsRingBuffer<int> fiveItems(5);
+    testOk(fiveItems.capacity() == 8, "The capacity is rounded up to a power of 2");
+
+    nds::EpicsRingBuffer<int> eightItems(8);
+    testOk(eightItems.capacity() == 8, "A power of 2 is kept");
+}
+
+/*
+ * Several laps around a small queue, keeping it partially full
+ *
+ **************************************************************/
+static void testWrapAround()
+{
+    nds::EpicsRingBuffer<int> queue(4);
+
+    bool ordered(true);
+    int pushed(0);
+    int popped(0);
+    for(int lap(0); lap != 10; ++lap)
+    {
+        for(int scanPush(0); scanPush != 3; ++scanPush)
+        {
+            int item(pushed++);
+            ordered = ordered && queue.tryPush(item);
+        }
+        for(int scanPop(0); scanPop != 3; ++scanPop)
+        {
+            int item(-1);
+            ordered = ordered && queue.tryPop(item) && item == popped++;
+        }
+    }
+    testOk(ordered, "The items are popped in order across 10 laps");
+    testOk(queue.getEnqueuePosition() == 30 && queue.getDequeuePosition() == 30, "The positions count the pushed and popped items");
+    testOk(queue.size() == 0, "The queue is empty");
+
+    int item(-1);
+    testOk(!queue.tryPop(item) && item == -1, "Popping from an empty queue fails");
+}
+
+/*
+ * The queue rejects the items when full and accepts them again when an
+ *  item is popped
+ *
+ **********************************************************************/
+static void testFull()
+{
+    nds::EpicsRingBuffer<std::shared_ptr<int> > queue(4);
+
+    bool accepted(true);
+    for(int scanItems(0); scanItems != 4; ++scanItems)
+    {
+        std::shared_ptr<int> pItem(new int(scanItems));
+        accepted = accepted && queue.tryPush(pItem) && pItem.get() == 0;
+    }
+    testOk(accepted, "The queue accepts and moves capacity() items");
+    testOk(queue.size() == 4, "The queue holds 4 items");
+
+    std::shared_ptr<int> pRejected(new int(4));
+    testOk(!queue.tryPush(pRejected), "A full queue rejects the item");
+    testOk(pRejected.get() != 0 && *pRejected == 4, "A rejected item is not moved");
+
+    std::shared_ptr<int> pOldest;
+    testOk(queue.tryPop(pOldest) && *pOldest == 0, "The oldest item is popped first");
+    testOk(queue.tryPush(pRejected), "The queue accepts an item after a pop");
+
+    bool ordered(true);
+    for(int expected(1); expected != 5; ++expected)
+    {
+        std::shared_ptr<int> pItem;
+        ordered = ordered && queue.tryPop(pItem) && *pItem == expected;
+    }
+    testOk(ordered, "The items are popped in order after the queue was full");
+}
+
+/*
+ * Several producers and consumers: every item is popped exactly once
+ *
+ ********************************************************************/
+static const size_t numProducers(2);
+static const size_t numConsumers(2);
+static const size_t itemsPerProducer(20000);
+
+struct concurrentTest_t
+{
+    concurrentTest_t(): m_queue(64), m_running(numProducers + numConsumers), m_popped(0), m_sum(0), m_nextProducer(0)
+    {
+        m_done = epicsEventCreate(epicsEventEmpty);
+    }
+
+    ~concurrentTest_t()
+    {
+        epicsEventDestroy(m_done);
+    }
+
+    nds::EpicsRingBuffer<std::uint64_t> m_queue;
+    std::atomic<size_t> m_running;
+    std::atomic<size_t> m_popped;
+    std::atomic<std::uint64_t> m_sum;
+    std::atomic<size_t> m_nextProducer;
+    epicsEventId m_done;
+};
+
+static void threadDone(concurrentTest_t* pTest)
+{
+    if(--pTest->m_running == 0)
+    {
+        epicsEventSignal(pTest->m_done);
+    }
+}
+
+static void producerThread(void* pParameter)
+{
+    concurrentTest_t* pTest((concurrentTest_t*)pParameter);
+    std::uint64_t first((pTest->m_nextProducer++) * itemsPerProducer + 1);
+    for(std::uint64_t item(first); item != first + itemsPerProducer; ++item)
+    {
+        std::uint64_t pushItem(item);
+        while(!pTest->m_queue.tryPush(pushItem))
+        {
+            epicsThreadSleep(0);
+        }
+    }
+    threadDone(pTest);
+}
+
+static void consumerThread(void* pParameter)
+{
+    concurrentTest_t* pTest((concurrentTest_t*)pParameter);
+    while(pTest->m_popped.load() != numProducers * itemsPerProducer)
+    {
+        std::uint64_t item;
+        if(pTest->m_queue.tryPop(item))
+        {
+            pTest->m_sum += item;
+            ++pTest->m_popped;
+        }
+        else
+        {
+            epicsThreadSleep(0);
+        }
+    }
+    threadDone(pTest);
+}
+
+static void testConcurrent()
+{
+    concurrentTest_t test;
+
+    for(size_t scanThreads(0); scanThreads != numProducers + numConsumers; ++scanThreads)
+    {
+        epicsThreadCreate(scanThreads < numProducers ? "producer" : "consumer",
+                          epicsThreadPriorityMedium,
+                          epicsThreadGetStackSize(epicsThreadStackSmall),
+                          scanThreads < numProducers ? producerThread : consumerThread,
+                          &test);
+    }
+    epicsEventWait(test.m_done);
+
+    std::uint64_t numItems(numProducers * itemsPerProducer);
+    testOk(test.m_popped.load() == numItems, "%zu producers and %zu consumers: all the items popped", numProducers, numConsumers);
+    testOk(test.m_sum.load() == numItems * (numItems + 1) / 2, "%zu producers and %zu consumers: each item popped once", numProducers, numConsumers);
+    testOk(test.m_queue.size() == 0, "%zu producers and %zu consumers: the queue is empty", numProducers, numConsumers);
+}
+
+MAIN(epicsRingBufferTest)
+{
+    testPlan(17);
+
+    testCapacity();
+    testWrapAround();
+    testFull();
+    testConcurrent();
+
+    return testDone();
+}
@@ -0,0 +1,105 @@
+/*
+ * EPICS support for NDS3
+ *
+ * Copyright (c) 2015 Cosylab d.d.
+ *
+ * For more information about the license please refer to the license.txt
+ * file included in the distribution.
+ */
+
+/**
+ * @file epicsSnapshotTest.cpp
+ *
+ * Checks that a snapshot is deleted only after its readers are gone,
+ *  run with "make runtests".
+ *
+ */
+
+#include <atomic>
+#include <memory>
+
+#include <epicsThread.h>
+#include <epicsEvent.h>
+#include <epicsUnitTest.h>
+#include <testMain.h>
+
+#include "nds3/impl/epicsSnapshot.h"
+
+/*
+ * A snapshot that counts its deletions
+ *
+ **************************************/
+static std::atomic<int> deletedSnapshots(0);
+
+struct countedSnapshot_t
+{
+    countedSnapshot_t(int value): m_value(value)
+    {
+    }
+
+    ~countedSnapshot_t()
+    {
+        ++deletedSnapshots;
+    }
+
+    int m_value;
+};
+
+typedef nds::EpicsSnapshot<countedSnapshot_t> snapshot_t;
+
+/*
+ * Publishes a snapshot from another thread
+ *
+ ******************************************/
+struct publisher_t
+{
+    snapshot_t* m_pSnapshot;
+    int m_value;
+    epicsEventId m_done;
+};
+
+static void publisherThread(void* pParameter)
+{
+    publisher_t* pPublisher((publisher_t*)pParameter);
+    pPublisher->m_pSnapshot->publish(std::unique_ptr<const countedSnapshot_t>(new countedSnapshot_t(pPublisher->m_value)));
+    epicsEventSignal(pPublisher->m_done);
+}
+
+MAIN(epicsSnapshotTest)
+{
+    testPlan(10);
+
+    {
+        snapshot_t snapshot;
+        testOk(!snapshot.isPublished(), "No snapshot published at construction");
+        {
+            snapshot_t::reader_t reader(snapshot);
+            testOk(reader.get() == 0, "A reader gets NULL before the first snapshot");
+        }
+
+        snapshot.publish(std::unique_ptr<const countedSnapshot_t>(new countedSnapshot_t(1)));
+        testOk(snapshot.isPublished(), "The snapshot is published");
+
+        publisher_t publisher;
+        publisher.m_pSnapshot = &snapshot;
+        publisher.m_value = 2;
+        publisher.m_done = epicsEventCreate(epicsEventEmpty);
+        {
+            snapshot_t::reader_t oldReader(snapshot);
+            testOk(oldReader->m_value == 1, "A reader gets the published snapshot");
+
+            epicsThreadCreate("publisher", epicsThreadPriorityMedium, epicsThreadGetStackSize(epicsThreadStackSmall), publisherThread, &publisher);
+            testOk(epicsEventWaitWithTimeout(publisher.m_done, 0.2) == epicsEventWaitTimeout, "publish() waits for the reader of the replaced snapshot");
+            testOk(deletedSnapshots.load() == 0 && oldReader->m_value == 1, "The replaced snapshot is kept while it is read");
+
+            snapshot_t::reader_t newReader(snapshot);
+            testOk(newReader->m_value == 2, "A new reader gets the new snapshot while publish() waits");
+        }
+        testOk(epicsEventWaitWithTimeout(publisher.m_done, 5.0) == epicsEventOK, "publish() returns when the readers are gone");
+        testOk(deletedSnapshots.load() == 1, "The replaced snapshot is deleted");
+        epicsEventDestroy(publisher.m_done);
+    }
+    testOk(deletedSnapshots.load() == 2, "The last snapshot is deleted with the container");
+
+    return testDone();
+}
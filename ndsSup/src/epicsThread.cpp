@@ -7,13 +7,16 @@
  * file included in the distribution.
  */
 
+#include <errlog.h>
+
 #include "nds3/impl/epicsThread.h"
 
 namespace nds
 {
 
-EpicsThread::EpicsThread(FactoryBaseImpl *pImpl, const std::string &name, threadFunction_t function):
-    ThreadBaseImpl(pImpl, name), m_function(function)
+EpicsThread::EpicsThread(FactoryBaseImpl *pImpl, const std::string &name, threadFunction_t function,
+                         const threadPolicySettings_t& settings):
+    ThreadBaseImpl(pImpl, name), m_function(function), m_settings(settings)
 {
     m_threadStartedEventId = epicsEventCreate(epicsEventEmpty);
     if(m_threadStartedEventId == 0)
@@ -23,8 +26,8 @@ EpicsThread::EpicsThread(FactoryBaseImpl *pImpl, const std::string &name, thread
 
     m_threadId = epicsThreadCreate(
                 name.c_str(),
-                epicsThreadPriorityMedium,
-                epicsThreadGetStackSize(epicsThreadStackSmall),
+                m_settings.m_priority,
+                m_settings.m_stackSize == 0 ? epicsThreadGetStackSize(epicsThreadStackSmall) : (unsigned int)m_settings.m_stackSize,
                 EpicsThread::process,
                 this);
 
@@ -51,6 +54,18 @@ void EpicsThread::process(void *param)
 
     std::lock_guard<std::mutex> lockRunning(pThread->m_running);
 
+    if(pThread->m_settings.m_policy != schedulingPolicy_t::other || !pThread->m_settings.m_cpus.empty())
+    {
+        try
+        {
+            applyThreadPolicy(epicsThreadGetIdSelf(), pThread->m_settings);
+        }
+        catch(const std::runtime_error& e)
+        {
+            errlogSevPrintf(errlogMinor, "Thread %s: %s\n", epicsThreadGetNameSelf(), e.what());
+        }
+    }
+
     epicsEventSignal(pThread->m_threadStartedEventId);
 
     pThread->m_function();
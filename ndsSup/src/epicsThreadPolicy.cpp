@@ -0,0 +1,170 @@
+/*
+ * EPICS support for NDS3
+ *
+ * Copyright (c) 2015 Cosylab d.d.
+ *
+ * For more information about the license please refer to the license.txt
+ * file included in the distribution.
+ */
+
+/**
+ * @file epicsThreadPolicy.cpp
+ *
+ * Priority, scheduling policy and CPU affinity of the threads.
+ *
+ */
+
+#include <sstream>
+#include <stdexcept>
+#include <cstring>
+#include <cstdlib>
+#include <cerrno>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include "nds3/impl/epicsThreadPolicy.h"
+
+namespace nds
+{
+
+/*
+ * Apply the settings to a running thread
+ *
+ ****************************************/
+void applyThreadPolicy(epicsThreadId threadId, const threadPolicySettings_t& settings)
+{
+    epicsThreadSetPriority(threadId, settings.m_priority);
+
+#if defined(__linux__)
+    pthread_t posixThread(epicsThreadGetPosixThreadId(threadId));
+
+    if(settings.m_policy != schedulingPolicy_t::other)
+    {
+        int policy(settings.m_policy == schedulingPolicy_t::fifo ? SCHED_FIFO : SCHED_RR);
+        sched_param parameters;
+        ::memset(&parameters, 0, sizeof(parameters));
+        parameters.sched_priority = (int)settings.m_priority;
+        if(parameters.sched_priority < sched_get_priority_min(policy))
+        {
+            parameters.sched_priority = sched_get_priority_min(policy);
+        }
+        if(parameters.sched_priority > sched_get_priority_max(policy))
+        {
+            parameters.sched_priority = sched_get_priority_max(policy);
+        }
+        int error(pthread_setschedparam(posixThread, policy, &parameters));
+        if(error != 0)
+        {
+            throw std::runtime_error(std::string("Cannot set the real-time scheduling policy: ") + ::strerror(error));
+        }
+    }
+
+    if(!settings.m_cpus.empty())
+    {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        for(std::set<unsigned int>::const_iterator scanCpus(settings.m_cpus.begin()), endCpus(settings.m_cpus.end());
+            scanCpus != endCpus;
+            ++scanCpus)
+        {
+            if(*scanCpus >= CPU_SETSIZE)
+            {
+                throw std::runtime_error("CPU number out of range");
+            }
+            CPU_SET(*scanCpus, &cpus);
+        }
+        int error(pthread_setaffinity_np(posixThread, sizeof(cpus), &cpus));
+        if(error != 0)
+        {
+            throw std::runtime_error(std::string("Cannot set the CPU affinity: ") + ::strerror(error));
+        }
+    }
+#else
+    if(settings.m_policy != schedulingPolicy_t::other || !settings.m_cpus.empty())
+    {
+        throw std::runtime_error("The scheduling policy and the CPU affinity are supported only on Linux");
+    }
+#endif
+}
+
+
+schedulingPolicy_t parseSchedulingPolicy(const std::string& policy)
+{
+    if(policy == "other")
+    {
+        return schedulingPolicy_t::other;
+    }
+    if(policy == "fifo")
+    {
+        return schedulingPolicy_t::fifo;
+    }
+    if(policy == "rr")
+    {
+        return schedulingPolicy_t::roundRobin;
+    }
+    throw std::runtime_error("Unknown scheduling policy " + policy + ". Use other, fifo or rr");
+}
+
+
+/*
+ * Parse a CPU number, ending at the returned position
+ *
+ *****************************************************/
+static const char* parseCpu(const char* text, unsigned int* pCpu)
+{
+    if(*text < '0' || *text > '9')
+    {
+        return 0;
+    }
+    char* pEnd(0);
+    errno = 0;
+    unsigned long cpu(strtoul(text, &pEnd, 10));
+    if(errno != 0 || cpu > 65535)
+    {
+        return 0;
+    }
+    *pCpu = (unsigned int)cpu;
+    return pEnd;
+}
+
+
+/*
+ * Parse a list of CPUs and CPU ranges separated by commas
+ *
+ *********************************************************/
+std::set<unsigned int> parseCpuList(const std::string& cpuList)
+{
+    std::set<unsigned int> cpus;
+
+    std::istringstream listStream(cpuList);
+    std::string range;
+    while(std::getline(listStream, range, ','))
+    {
+        unsigned int first(0), last(0);
+        const char* pEnd(parseCpu(range.c_str(), &first));
+        last = first;
+        if(pEnd != 0 && *pEnd == '-')
+        {
+            pEnd = parseCpu(pEnd + 1, &last);
+        }
+        if(pEnd == 0 || *pEnd != 0 || last < first)
+        {
+            throw std::runtime_error("Invalid CPU list " + cpuList + ". Use a list of CPUs and ranges, e.g. 0,2-3");
+        }
+        for(unsigned int cpu(first); cpu <= last; ++cpu)
+        {
+            cpus.insert(cpu);
+        }
+    }
+
+    if(cpus.empty())
+    {
+        throw std::runtime_error("The CPU list is empty");
+    }
+    return cpus;
+}
+
+}
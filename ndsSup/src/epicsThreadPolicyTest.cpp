@@ -0,0 +1,82 @@
+/*
+ * EPICS support for NDS3
+ *
+ * Copyright (c) 2015 Cosylab d.d.
+ *
+ * For more information about the license please refer to the license.txt
+ * file included in the distribution.
+ */
+
+/**
+ * @file epicsThreadPolicyTest.cpp
+ *
+ * Checks the parsing of the CPU lists used by ndsSetThreadPolicy and ndsBench,
+ *  run with "make runtests".
+ *
+ */
+
+#include <set>
+#include <stdexcept>
+#include <string>
+
+#include <epicsUnitTest.h>
+#include <testMain.h>
+
+#include "nds3/impl/epicsThreadPolicy.h"
+
+static void testCpuList(const std::string& cpuList, const std::set<unsigned int>& expected)
+{
+    try
+    {
+        testOk(nds::parseCpuList(cpuList) == expected, "CPU list \"%s\"", cpuList.c_str());
+    }
+    catch(const std::runtime_error& e)
+    {
+        testFail("CPU list \"%s\" rejected: %s", cpuList.c_str(), e.what());
+    }
+}
+
+static void testInvalidCpuList(const std::string& cpuList)
+{
+    try
+    {
+        nds::parseCpuList(cpuList);
+        testFail("Invalid CPU list \"%s\" accepted", cpuList.c_str());
+    }
+    catch(const std::runtime_error&)
+    {
+        testPass("Invalid CPU list \"%s\" rejected", cpuList.c_str());
+    }
+}
+
+MAIN(epicsThreadPolicyTest)
+{
+    testPlan(12);
+
+    std::set<unsigned int> cpus;
+    cpus.insert(0);
+    testCpuList("0", cpus);
+
+    cpus.clear();
+    cpus.insert(3);
+    testCpuList("3", cpus);
+
+    cpus.clear();
+    cpus.insert(2);
+    cpus.insert(3);
+    testCpuList("2-3", cpus);
+
+    cpus.insert(0);
+    testCpuList("0,2-3", cpus);
+
+    testInvalidCpuList("");
+    testInvalidCpuList("a");
+    testInvalidCpuList("-1");
+    testInvalidCpuList("3-");
+    testInvalidCpuList("3-2");
+    testInvalidCpuList("1,,2");
+    testInvalidCpuList("1 ");
+    testInvalidCpuList("0,2-3x");
+
+    return testDone();
+}
@@ -0,0 +1,339 @@
+/*
+ * EPICS support for NDS3
+ *
+ * Copyright (c) 2015 Cosylab d.d.
+ *
+ * For more information about the license please refer to the license.txt
+ * file included in the distribution.
+ */
+
+/**
+ * @file epicsThreadPool.cpp
+ *
+ * Reusable threads that execute the functions passed to runInThread().
+ *
+ */
+
+#include <sstream>
+#include <stdexcept>
+#include <algorithm>
+
+#include <errlog.h>
+
+#include "nds3/impl/epicsThreadPool.h"
+
+namespace nds
+{
+
+/*
+ * Constructor
+ *
+ *************/
+EpicsThreadPool::EpicsThreadPool(const std::string& name, size_t maxIdleWorkers, double idleTimeoutSeconds):
+    m_name(name), m_idleTimeoutSeconds(idleTimeoutSeconds), m_maxIdleWorkers(maxIdleWorkers), m_enabled(true), m_stopping(false), m_threadCounter(0)
+{
+}
+
+
+/*
+ * Destructor: wake the idle workers and wait for all of them to exit
+ *
+ ********************************************************************/
+EpicsThreadPool::~EpicsThreadPool()
+{
+    std::unique_lock<std::mutex> lock(m_workersLock);
+    m_stopping = true;
+    for(std::vector<worker_t*>::iterator scanIdle(m_idleWorkers.begin()), endIdle(m_idleWorkers.end());
+        scanIdle != endIdle;
+        ++scanIdle)
+    {
+        epicsEventSignal((*scanIdle)->m_wakeUp);
+    }
+
+    while(!m_workers.empty())
+    {
+        m_noWorkersCondition.wait(lock);
+    }
+}
+
+
+void EpicsThreadPool::setMaxIdleWorkers(size_t maxIdleWorkers)
+{
+    std::lock_guard<std::mutex> lock(m_workersLock);
+    m_maxIdleWorkers = maxIdleWorkers;
+}
+
+
+size_t EpicsThreadPool::getMaxIdleWorkers() const
+{
+    std::lock_guard<std::mutex> lock(m_workersLock);
+    return m_maxIdleWorkers;
+}
+
+
+void EpicsThreadPool::setEnabled(bool enabled)
+{
+    std::lock_guard<std::mutex> lock(m_workersLock);
+    m_enabled = enabled;
+}
+
+
+bool EpicsThreadPool::isEnabled() const
+{
+    std::lock_guard<std::mutex> lock(m_workersLock);
+    return m_enabled;
+}
+
+
+/*
+ * Hand the function to the most recently idle worker (its stack is probably
+ *  still in the cache), or start a new worker if they are all busy
+ *
+ ***************************************************************************/
+ThreadBaseImpl* EpicsThreadPool::run(FactoryBaseImpl* pFactory, const std::string& name, threadFunction_t function)
+{
+    pTask_t pTask(std::make_shared<task_t>(name, function));
+    std::unique_ptr<pooledThread_t> pHandle(new pooledThread_t(pFactory, name, pTask));
+
+    std::lock_guard<std::mutex> lock(m_workersLock);
+    if(m_stopping)
+    {
+        throw std::logic_error("The thread pool is being destroyed");
+    }
+
+    if(!m_idleWorkers.empty())
+    {
+        worker_t* pWorker(m_idleWorkers.back());
+        m_idleWorkers.pop_back();
+        pWorker->m_idle = false;
+        {
+            std::lock_guard<std::mutex> lockTasks(pWorker->m_tasksLock);
+            pWorker->m_tasks.push_back(pTask);
+        }
+        epicsEventSignal(pWorker->m_wakeUp);
+        return pHandle.release();
+    }
+
+    std::ostringstream threadName;
+    threadName << m_name << m_threadCounter++;
+    std::unique_ptr<worker_t> pWorker(new worker_t(this, threadName.str()));
+    pWorker->m_tasks.push_back(pTask);
+
+    if(epicsThreadCreate(pWorker->m_threadName.c_str(),
+                         epicsThreadPriorityMedium,
+                         epicsThreadGetStackSize(epicsThreadStackSmall),
+                         EpicsThreadPool::workerThread,
+                         pWorker.get()) == 0)
+    {
+        throw std::runtime_error("Cannot allocate an EPICS thread");
+    }
+    m_workers.push_back(std::move(pWorker));
+
+    return pHandle.release();
+}
+
+
+/*
+ * Print the task executed by each worker
+ *
+ ****************************************/
+void EpicsThreadPool::report(FILE* pFile) const
+{
+    std::lock_guard<std::mutex> lock(m_workersLock);
+    fprintf(pFile, "Thread pool %s (%s): %zu workers, %zu idle, up to %zu idle kept\n",
+            m_name.c_str(), m_enabled ? "enabled" : "disabled", m_workers.size(), m_idleWorkers.size(), m_maxIdleWorkers);
+    for(std::vector<std::unique_ptr<worker_t> >::const_iterator scanWorkers(m_workers.begin()), endWorkers(m_workers.end());
+        scanWorkers != endWorkers;
+        ++scanWorkers)
+    {
+        const worker_t& worker(**scanWorkers);
+        fprintf(pFile, "  %-16s %s\n", worker.m_threadName.c_str(), worker.m_taskName.empty() ? "(idle)" : worker.m_taskName.c_str());
+    }
+}
+
+
+/*
+ * Entry point of the worker threads
+ *
+ ***********************************/
+void EpicsThreadPool::workerThread(void* pParameter)
+{
+    worker_t* pWorker((worker_t*)pParameter);
+    pWorker->m_pPool->runWorker(pWorker);
+}
+
+
+void EpicsThreadPool::runWorker(worker_t* pWorker)
+{
+    std::unique_lock<std::mutex> lock(m_workersLock);
+    for(;;)
+    {
+        pTask_t pTask(getTask(pWorker));
+        if(pTask.get() != 0)
+        {
+            pWorker->m_taskName = pTask->m_name;
+            lock.unlock();
+            execute(pWorker->m_threadName, pTask);
+            lock.lock();
+            pWorker->m_taskName.clear();
+            continue;
+        }
+
+        if(m_stopping)
+        {
+            break;
+        }
+
+        // Nothing to do: wait for a task or for the idle timeout
+        if(!pWorker->m_idle)
+        {
+            pWorker->m_idle = true;
+            m_idleWorkers.push_back(pWorker);
+        }
+
+        lock.unlock();
+        epicsEventStatus waitStatus(epicsEventWaitWithTimeout(pWorker->m_wakeUp, m_idleTimeoutSeconds));
+        lock.lock();
+
+        // Exit if there are more idle workers than needed. A worker that has
+        //  been assigned a task in the meantime is not idle anymore
+        if(pWorker->m_idle &&
+           (m_stopping || (waitStatus == epicsEventWaitTimeout && m_idleWorkers.size() > m_maxIdleWorkers)))
+        {
+            break;
+        }
+    }
+
+    // Leave the pool
+    std::vector<worker_t*>::iterator findIdle(std::find(m_idleWorkers.begin(), m_idleWorkers.end(), pWorker));
+    if(findIdle != m_idleWorkers.end())
+    {
+        m_idleWorkers.erase(findIdle);
+    }
+    for(std::vector<std::unique_ptr<worker_t> >::iterator scanWorkers(m_workers.begin()), endWorkers(m_workers.end());
+        scanWorkers != endWorkers;
+        ++scanWorkers)
+    {
+        if(scanWorkers->get() == pWorker)
+        {
+            m_workers.erase(scanWorkers);
+            break;
+        }
+    }
+    if(m_workers.empty())
+    {
+        m_noWorkersCondition.notify_all();
+    }
+}
+
+
+/*
+ * Pop from the front of the worker's own queue, or steal from the back of
+ *  the queue of a worker that has not yet woken up
+ *
+ *************************************************************************/
+EpicsThreadPool::pTask_t EpicsThreadPool::getTask(worker_t* pWorker)
+{
+    {
+        std::lock_guard<std::mutex> lockTasks(pWorker->m_tasksLock);
+        if(!pWorker->m_tasks.empty())
+        {
+            pTask_t pTask(pWorker->m_tasks.front());
+            pWorker->m_tasks.pop_front();
+            return pTask;
+        }
+    }
+
+    for(std::vector<std::unique_ptr<worker_t> >::iterator scanWorkers(m_workers.begin()), endWorkers(m_workers.end());
+        scanWorkers != endWorkers;
+        ++scanWorkers)
+    {
+        worker_t* pVictim(scanWorkers->get());
+        if(pVictim == pWorker)
+        {
+            continue;
+        }
+        std::lock_guard<std::mutex> lockTasks(pVictim->m_tasksLock);
+        if(!pVictim->m_tasks.empty())
+        {
+            pTask_t pTask(pVictim->m_tasks.back());
+            pVictim->m_tasks.pop_back();
+            return pTask;
+        }
+    }
+
+    return pTask_t();
+}
+
+
+/*
+ * Execute a task and wake up the threads waiting in join()
+ *
+ **********************************************************/
+void EpicsThreadPool::execute(const std::string& threadName, const pTask_t& pTask)
+{
+    try
+    {
+        pTask->m_function();
+    }
+    catch(const std::exception& e)
+    {
+        errlogSevPrintf(errlogMajor, "Thread %s (pool thread %s) terminated with an exception: %s\n",
+                        pTask->m_name.c_str(), threadName.c_str(), e.what());
+    }
+    catch(...)
+    {
+        errlogSevPrintf(errlogMajor, "Thread %s (pool thread %s) terminated with an unknown exception\n",
+                        pTask->m_name.c_str(), threadName.c_str());
+    }
+
+    // Release the captured objects before reporting the termination
+    pTask->m_function = threadFunction_t();
+
+    std::lock_guard<std::mutex> lock(pTask->m_lock);
+    pTask->m_done = true;
+    pTask->m_doneCondition.notify_all();
+}
+
+
+/*
+ * Worker
+ *
+ ********/
+EpicsThreadPool::worker_t::worker_t(EpicsThreadPool* pPool, const std::string& threadName):
+    m_pPool(pPool), m_threadName(threadName), m_idle(false)
+{
+    m_wakeUp = epicsEventCreate(epicsEventEmpty);
+    if(m_wakeUp == 0)
+    {
+        throw std::runtime_error("Cannot allocate an EPICS event");
+    }
+}
+
+
+EpicsThreadPool::worker_t::~worker_t()
+{
+    epicsEventDestroy(m_wakeUp);
+}
+
+
+/*
+ * Handle returned to the NDS library
+ *
+ ************************************/
+EpicsThreadPool::pooledThread_t::pooledThread_t(FactoryBaseImpl* pFactory, const std::string& name, const pTask_t& pTask):
+    ThreadBaseImpl(pFactory, name), m_pTask(pTask)
+{
+}
+
+
+void EpicsThreadPool::pooledThread_t::join()
+{
+    std::unique_lock<std::mutex> lock(m_pTask->m_lock);
+    while(!m_pTask->m_done)
+    {
+        m_pTask->m_doneCondition.wait(lock);
+    }
+}
+
+}
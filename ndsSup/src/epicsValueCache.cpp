@@ -0,0 +1,66 @@
+/*
+ * EPICS support for NDS3
+ *
+ * Copyright (c) 2015 Cosylab d.d.
+ *
+ * For more information about the license please refer to the license.txt
+ * file included in the distribution.
+ */
+
+/**
+ * @file epicsValueCache.cpp
+ *
+ * Last value cache used to serve the reads of the records.
+ *
+ */
+
+#include "nds3/impl/epicsValueCache.h"
+
+namespace nds
+{
+
+EpicsValueCache::EpicsValueCache(double maxAgeSeconds):
+    m_maxAgeSeconds(maxAgeSeconds), m_valid(false), m_elementSize(0), m_scalar(0), m_pArrayData(0), m_numElements(0), m_hits(0), m_misses(0)
+{
+    m_timestamp.tv_sec = 0;
+    m_timestamp.tv_nsec = 0;
+    m_storeTime.tv_sec = 0;
+    m_storeTime.tv_nsec = 0;
+}
+
+
+/*
+ * Check if the cached value can be used. The lock must be held.
+ *
+ ***************************************************************/
+bool EpicsValueCache::isFresh(size_t elementSize) const
+{
+    if(!m_valid || m_elementSize != elementSize)
+    {
+        return false;
+    }
+
+    if(m_maxAgeSeconds <= 0)
+    {
+        return true;
+    }
+
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    double ageSeconds = (double)(now.tv_sec - m_storeTime.tv_sec) + (double)(now.tv_nsec - m_storeTime.tv_nsec) / 1.0e9;
+    return ageSeconds <= m_maxAgeSeconds;
+}
+
+
+std::uint64_t EpicsValueCache::getHits() const
+{
+    return m_hits.load(std::memory_order_relaxed);
+}
+
+
+std::uint64_t EpicsValueCache::getMisses() const
+{
+    return m_misses.load(std::memory_order_relaxed);
+}
+
+}
@@ -0,0 +1,113 @@
+/*
+ * EPICS support for NDS3
+ *
+ * Copyright (c) 2015 Cosylab d.d.
+ *
+ * For more information about the license please refer to the license.txt
+ * file included in the distribution.
+ */
+
+#ifndef NDSEPICSARRAYACCESS_H
+#define NDSEPICSARRAYACCESS_H
+
+#include <cstddef>
+#include <ctime>
+
+namespace nds
+{
+
+/**
+ * @brief Optional interface for PVs that can copy their data directly into
+ *        the buffer of the EPICS record.
+ *
+ * EpicsInterfaceImpl checks if the PV implementation also derives from this
+ *  class: if it does then the array reads skip the intermediate std::vector
+ *  and the PV fills the record's buffer in place. PVs that don't implement it
+ *  are read through the std::vector overloads of PVBaseImpl::read().
+ *
+ * Example:
+ * @code
+ * class FastWaveformPV: public PVDelegateInImpl<std::vector<double> >, public EpicsArrayReader<double>
+ * {
+ *     virtual size_t readArray(timespec* pTimestamp, double* pBuffer, size_t capacity) const;
+ * };
+ * @endcode
+ */
+template<typename T>
+class EpicsArrayReader
+{
+public:
+    virtual ~EpicsArrayReader()
+    {
+    }
+
+    /**
+     * @brief Copy the PV data into the supplied buffer.
+     *
+     * Called on the asyn port thread.
+     *
+     * @param pTimestamp on input contains the time at which the record requested
+     *                   the data, on output must contain the data timestamp
+     * @param pBuffer    the buffer to fill
+     * @param capacity   the maximum number of elements that fit in pBuffer
+     * @return the number of elements written into pBuffer
+     */
+    virtual size_t readArray(timespec* pTimestamp, T* pBuffer, size_t capacity) const = 0;
+};
+
+
+/**
+ * @brief Optional interface for PVs that can consume the data written by an
+ *        EPICS record directly from the record's buffer.
+ *
+ * When the PV implementation also derives from this class the array writes
+ *  pass it a view of the record's buffer instead of copying it into a
+ *  std::vector. PVs that don't implement it receive the data through the
+ *  std::vector overloads of PVBaseImpl::write().
+ */
+template<typename T>
+class EpicsArrayWriter
+{
+public:
+    virtual ~EpicsArrayWriter()
+    {
+    }
+
+    /**
+     * @brief Receive the data written by the record.
+     *
+     * Called on the asyn port thread. The buffer belongs to the record and is
+     *  valid only until the function returns: PVs that need the data after
+     *  that must copy it.
+     *
+     * @param timestamp   the time at which the record wrote the data
+     * @param pBuffer     the record's buffer
+     * @param numElements the number of elements in pBuffer
+     */
+    virtual void writeArray(const timespec& timestamp, const T* pBuffer, size_t numElements) = 0;
+};
+
+
+/**
+ * @brief Optional marker for PVs whose read and write functions never block.
+ *
+ * The records of the PVs that derive from this class (and of the
+ *  PVVariableIn/PVVariableOut PVs, which only access a value in memory) are
+ *  linked to a synchronous asyn port: their reads and writes are executed
+ *  directly by the thread that processes the record, without waiting for the
+ *  thread of the asyn port.
+ *
+ * The read and write functions are called concurrently with the ones of the
+ *  other PVs of the port, so they must be thread safe.
+ */
+class EpicsNonBlockingPV
+{
+public:
+    virtual ~EpicsNonBlockingPV()
+    {
+    }
+};
+
+}
+
+#endif // NDSEPICSARRAYACCESS_H
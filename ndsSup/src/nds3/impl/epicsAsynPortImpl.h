@@ -0,0 +1,122 @@
+/*
+ * EPICS support for NDS3
+ *
+ * Copyright (c) 2015 Cosylab d.d.
+ *
+ * For more information about the license please refer to the license.txt
+ * file included in the distribution.
+ */
+
+#ifndef NDSEPICSASYNPORTIMPL_H
+#define NDSEPICSASYNPORTIMPL_H
+
+#include <string>
+
+#include <asynPortDriver.h>
+
+#include "nds3/impl/epicsConfig.h"
+#include "nds3/impl/epicsThreadPolicy.h"
+
+namespace nds
+{
+
+class EpicsInterfaceImpl;
+
+/**
+ * @internal
+ * @brief Base class for the asyn ports created by the EPICS layer.
+ *
+ * Registers the asyn interfaces used by the NDS PVs and allows the interrupt
+ *  hooks to find the EpicsInterfaceImpl that owns the PVs served by a port.
+ */
+class EpicsAsynPortImpl: public asynPortDriver
+{
+public:
+    /**
+     * @brief Registers the port with asyn.
+     *
+     * @param portName  the name of the asyn port
+     * @param asynFlags ASYN_CANBLOCK for ports with their own thread, 0 for
+     *                  synchronous ports
+     * @param threadPolicy priority and stack size of the port's thread
+     */
+    EpicsAsynPortImpl(const std::string& portName, int asynFlags, const threadPolicySettings_t& threadPolicy);
+
+    /**
+     * @brief Returns the interface that owns the PVs and the interrupt
+     *        subscribers of this port.
+     */
+    virtual EpicsInterfaceImpl* getInterfaceImpl() = 0;
+};
+
+
+/**
+ * @internal
+ * @brief Additional asyn port that serves a subset of the PVs of an
+ *        EpicsInterfaceImpl.
+ *
+ * All the requests are forwarded to the owner; the records' links select the
+ *  port. Used for the shards (each one with its own asyn thread, so the
+ *  blocking reads and writes of PVs assigned to different shards are executed
+ *  in parallel) and for the synchronous port of the non-blocking PVs.
+ */
+class EpicsShardPortImpl: public EpicsAsynPortImpl
+{
+public:
+    EpicsShardPortImpl(const std::string& portName, EpicsInterfaceImpl* pOwner, int asynFlags, const threadPolicySettings_t& threadPolicy);
+
+    virtual EpicsInterfaceImpl* getInterfaceImpl();
+
+    virtual asynStatus readInt32(asynUser *pasynUser, epicsInt32 *value);
+    virtual asynStatus writeInt32(asynUser *pasynUser, epicsInt32 value);
+
+    virtual asynStatus readFloat64(asynUser *pasynUser, epicsFloat64 *value);
+    virtual asynStatus writeFloat64(asynUser *pasynUser, epicsFloat64 value);
+
+    virtual asynStatus readInt8Array(asynUser *pasynUser, epicsInt8* pValue,
+                                                  size_t nElements, size_t *nIn);
+    virtual asynStatus writeInt8Array(asynUser *pasynUser, epicsInt8* pValue,
+                                                   size_t nElements);
+
+    virtual asynStatus readFloat64Array(asynUser *pasynUser, double* pValue,
+                                                  size_t nElements, size_t *nIn);
+    virtual asynStatus writeFloat64Array(asynUser *pasynUser, double* pValue,
+                                                   size_t nElements);
+
+    virtual asynStatus readInt32Array(asynUser *pasynUser, epicsInt32 *value,
+                                                  size_t nElements, size_t *nIn);
+    virtual asynStatus writeInt32Array(asynUser *pasynUser, epicsInt32 *value,
+                                                   size_t nElements);
+
+#ifdef NDS3_EXTENDED_DATA_TYPES
+    virtual asynStatus readInt16Array(asynUser *pasynUser, epicsInt16 *value,
+                                                  size_t nElements, size_t *nIn);
+    virtual asynStatus writeInt16Array(asynUser *pasynUser, epicsInt16 *value,
+                                                   size_t nElements);
+
+    virtual asynStatus readFloat32Array(asynUser *pasynUser, epicsFloat32 *value,
+                                                  size_t nElements, size_t *nIn);
+    virtual asynStatus writeFloat32Array(asynUser *pasynUser, epicsFloat32 *value,
+                                                   size_t nElements);
+
+    virtual asynStatus readInt64(asynUser *pasynUser, epicsInt64 *value);
+    virtual asynStatus writeInt64(asynUser *pasynUser, epicsInt64 value);
+
+    virtual asynStatus readInt64Array(asynUser *pasynUser, epicsInt64 *value,
+                                                  size_t nElements, size_t *nIn);
+    virtual asynStatus writeInt64Array(asynUser *pasynUser, epicsInt64 *value,
+                                                   size_t nElements);
+#endif
+
+    virtual asynStatus drvUserCreate(asynUser *pasynUser, const char *drvInfo,
+                                     const char **pptypeName, size_t *psize);
+
+    virtual void report(FILE* fp, int details);
+
+private:
+    EpicsInterfaceImpl* m_pOwner;
+};
+
+}
+
+#endif // NDSEPICSASYNPORTIMPL_H
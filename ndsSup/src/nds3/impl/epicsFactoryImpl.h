@@ -15,6 +15,8 @@
 #include <string>
 #include <set>
 #include <sstream>
+#include <mutex>
+#include <ctime>
 
 #include <dbStaticLib.h>
 #include <initHooks.h>
@@ -25,6 +27,13 @@
 #include <nds3/impl/factoryBaseImpl.h>
 #include <nds3/impl/logStreamGetterImpl.h>
 
+#include "nds3/impl/epicsPushDispatcher.h"
+#include "nds3/impl/epicsPushFilter.h"
+#include "nds3/impl/epicsProcessAtInit.h"
+#include "nds3/impl/epicsThreadPool.h"
+#include "nds3/impl/epicsThreadPolicy.h"
+#include "nds3/impl/epicsLogger.h"
+
 namespace nds
 {
 
@@ -32,6 +41,8 @@ namespace nds
  * @brief Takes care of registering everything with EPICS
  *
  */
+class EpicsInterfaceImpl;
+
 class EpicsFactoryImpl: public FactoryBaseImpl, public LogStreamGetterImpl
 {
     friend class EpicsLogStreamBufferImpl;
@@ -43,6 +54,8 @@ public:
 
     static void createNdsDevice(const iocshArgBuf * arguments);
 
+    static void destroyNdsDevice(const iocshArgBuf * arguments);
+
     static void loadNdsDriver(const iocshArgBuf * arguments);
 
     static void loadNdsNamingRules(const iocshArgBuf * arguments);
@@ -51,10 +64,95 @@ public:
 
     static void ndsUserCommand(const iocshArgBuf * arguments);
 
+    static void setPortShards(const iocshArgBuf * arguments);
+
+    static void setNonBlockingPVs(const iocshArgBuf * arguments);
+
+    static void setValueCache(const iocshArgBuf * arguments);
+
+    static void setPushQueue(const iocshArgBuf * arguments);
+
+    static void setPushFilter(const iocshArgBuf * arguments);
+
+    static void setDatabaseCache(const iocshArgBuf * arguments);
+
+    static void setProcessAtInit(const iocshArgBuf * arguments);
+
+    static void initReport(const iocshArgBuf * arguments);
+
+    static void setThreadPool(const iocshArgBuf * arguments);
+
+    static void threadPoolReport(const iocshArgBuf * arguments);
+
+    static void setThreadPolicy(const iocshArgBuf * arguments);
+
+    static void setLogRateLimit(const iocshArgBuf * arguments);
+
+    static void logReport(const iocshArgBuf * arguments);
+
+    static void setPvStatsRecords(const iocshArgBuf * arguments);
+
+    static void pvStats(const iocshArgBuf * arguments);
+
+    static void setLatencyHistograms(const iocshArgBuf * arguments);
+
+    static void latencyReport(const iocshArgBuf * arguments);
+
+    static void latencyReset(const iocshArgBuf * arguments);
+
     static void epicsInitHookFunction(initHookState state);
 
     virtual InterfaceBaseImpl* getNewInterface(const std::string& fullName);
 
+    /**
+     * @brief Retrieve the EPICS interface of a port.
+     *
+     * Allows the drivers to use the functions that are specific to the EPICS
+     *  layer, like EpicsInterfaceImpl::pushBatch().
+     *
+     * @param portName the full name of the port
+     * @return the port's interface, or 0 if the port doesn't exist
+     */
+    static EpicsInterfaceImpl* getInterface(const std::string& portName);
+
+    /**
+     * @brief Set the priority, stack size, scheduling policy and CPU affinity
+     *        of the threads created after the call.
+     *
+     * Same as the command ndsSetThreadPolicy. Applies to the threads started
+     *  with runInThread() and to the threads of the asyn ports; when several
+     *  rules match a thread name the last one is used. The functions started
+     *  with runInThread() that match a rule get a dedicated thread instead of
+     *  a worker of the thread pool, also with the default settings.
+     *
+     * @param threadNamePattern glob pattern matched against the thread names
+     *                          or the asyn port names
+     * @param settings          the settings of the matching threads
+     */
+    static void addThreadPolicy(const std::string& threadNamePattern, const threadPolicySettings_t& settings);
+
+    /**
+     * @brief Retrieve the settings configured for a thread or an asyn port.
+     *
+     * @param threadName the name of the thread or of the asyn port
+     * @param pSettings  filled with the settings of the last matching rule
+     * @return true if a rule matches the name
+     */
+    bool getThreadPolicySettings(const std::string& threadName, threadPolicySettings_t* pSettings) const;
+
+    /**
+     * @brief Returns the logger that forwards the messages of the log
+     *        streams to errlog.
+     */
+    EpicsLogger& getLogger();
+
+    /**
+     * @brief Called by the interface's destructor.
+     *
+     * @param portName the full name of the port
+     */
+    void deregisterInterface(const std::string& portName);
+
     virtual void run(int argc,char *argv[]);
 
     virtual LogStreamGetterImpl* getLogStreamGetter();
@@ -74,6 +172,69 @@ public:
 
     void processAtInit(const std::string& pvName);
 
+    /**
+     * @brief Process the records added with processAtInit(), if the IOC is
+     *        running. Called by the init hook and after the registration of
+     *        PVs added to a running IOC.
+     */
+    void processPendingRecords();
+
+    /**
+     * @brief Returns true once iocInit has started: the records can no
+     *        longer be created.
+     */
+    bool isIocInitialized() const;
+
+    /**
+     * @brief Retrieve the push filter configured for a PV with ndsSetPushFilter.
+     *
+     * @param pvName    the PV's external name
+     * @param pSettings filled with the settings of the last matching rule
+     * @return true if a rule matches the PV name
+     */
+    bool getPushFilterSettings(const std::string& pvName, pushFilterSettings_t* pSettings) const;
+
+    /**
+     * @brief Returns true if the PV has been declared non-blocking with
+     *        ndsSetNonBlockingPVs.
+     *
+     * @param pvName the PV's external name
+     */
+    bool isNonBlockingPV(const std::string& pvName) const;
+
+    /**
+     * @brief Returns true if the latencies of the PV are recorded in its own
+     *        histograms, enabled with ndsSetLatencyHistograms.
+     *
+     * @param pvName the PV's external name
+     */
+    bool hasLatencyHistograms(const std::string& pvName) const;
+
+    /**
+     * @brief Retrieve the value cache configured for a PV with ndsSetValueCache.
+     *
+     * @param pvName         the PV's external name
+     * @param pMaxAgeSeconds filled with the maximum age of the last matching rule
+     * @return true if a rule matches the PV name
+     */
+    bool getValueCacheSettings(const std::string& pvName, double* pMaxAgeSeconds) const;
+
+    /**
+     * @brief Retrieve the scan period of the statistics waveform configured
+     *        for a PV with ndsSetPvStatsRecords.
+     *
+     * @param pvName       the PV's external name
+     * @param pScanSeconds filled with the scan period of the last matching rule
+     * @return true if a rule matches the PV name
+     */
+    bool getPvStatsRecordsSettings(const std::string& pvName, double* pScanSeconds) const;
+
+    /**
+     * @brief Returns the directory set with ndsSetDatabaseCache, or an empty
+     *        string if the generated databases are not cached.
+     */
+    const std::string& getDatabaseCacheDirectory() const;
+
 protected:
     virtual std::ostream* createLogStream(const logLevel_t logLevel);
 
@@ -124,7 +285,50 @@ private:
     typedef std::map<std::string, nodeCommand_t> nodeCommands_t;
     nodeCommands_t m_nodeCommands;
 
-    std::list<std::string> m_processAtInit;
+    EpicsProcessAtInit m_processAtInit; ///< Records processed when the IOC is running
+    bool m_parallelProcessAtInit;       ///< Process them through the callback queues, set with ndsSetProcessAtInit
+
+    EpicsThreadPool m_threadPool;       ///< Executes the functions passed to runInThread(), sized with ndsSetThreadPool
+
+    typedef std::list<std::pair<std::string, threadPolicySettings_t> > threadPolicyRules_t;
+    threadPolicyRules_t m_threadPolicyRules; ///< Thread settings, with the thread name patterns they apply to
+    mutable std::mutex m_threadPolicyLock;   ///< The drivers may add rules while the threads are started
+
+    std::unique_ptr<EpicsLogger> m_pLogger;  ///< Forwards the log streams to errlog
+
+    typedef std::map<std::string, size_t> portShards_t;
+    portShards_t m_portShards; ///< Number of asyn ports for each NDS port, set with ndsSetPortShards
+
+    std::list<std::string> m_nonBlockingPVs; ///< Name patterns of the PVs served by the synchronous ports
+
+    std::list<std::string> m_latencyHistogramPVs; ///< Name patterns of the PVs with their own latency histograms
+
+    struct pushQueueSettings_t
+    {
+        size_t m_queueSize;
+        pushQueueOverflow_t m_overflowPolicy;
+    };
+    typedef std::map<std::string, pushQueueSettings_t> portPushQueueSettings_t;
+    portPushQueueSettings_t m_pushQueueSettings; ///< Push queue settings, per port name
+
+    typedef std::map<std::string, EpicsInterfaceImpl*> interfaces_t;
+    interfaces_t m_interfaces;       ///< The interfaces, per port name
+    mutable std::mutex m_interfacesLock;
+
+    typedef std::list<std::pair<std::string, double> > valueCacheRules_t;
+    valueCacheRules_t m_valueCacheRules; ///< Maximum age of the cached values, with the PV name patterns they apply to
+
+    typedef std::list<std::pair<std::string, pushFilterSettings_t> > pushFilterRules_t;
+    pushFilterRules_t m_pushFilterRules; ///< Push filters, with the PV name patterns they apply to
+
+    typedef std::list<std::pair<std::string, double> > pvStatsRecordsRules_t;
+    pvStatsRecordsRules_t m_pvStatsRecordsRules; ///< Scan period of the statistics waveforms, with the PV name patterns they apply to
+
+    std::string m_databaseCacheDirectory; ///< Where the generated databases are saved, set with ndsSetDatabaseCache
+
+    timespec m_iocBuildStart;       ///< Monotonic time at the beginning of iocInit
+    timespec m_databaseInitialized; ///< Monotonic time after the initialization of the records
+    timespec m_iocRunning;          ///< Monotonic time at the end of iocInit
 };
 
 class EpicsLogStreamBufferImpl: public std::stringbuf
@@ -137,6 +341,7 @@ protected:
 
     logLevel_t m_logLevel;
     EpicsFactoryImpl* m_pFactory;
+    logRateLimiter_t m_rateLimiter; ///< The stream is a source for the rate limit of the logger
 };
 
 class EpicsLogStream: public std::ostream
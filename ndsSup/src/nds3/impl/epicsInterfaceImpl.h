@@ -11,13 +11,31 @@
 #define NDSEPICSINTERFACEIMPL_H
 
 #include <string>
+#include <cstdint>
 #include <vector>
 #include <set>
+#include <unordered_map>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
 
 #include <asynPortDriver.h>
+#include <dbStaticLib.h>
 
 #include <nds3/impl/interfaceBaseImpl.h>
 
+#include "nds3/impl/epicsConfig.h"
+#include "nds3/impl/epicsAsynPortImpl.h"
+#include "nds3/impl/epicsPushDispatcher.h"
+#include "nds3/impl/epicsPushFilter.h"
+#include "nds3/impl/epicsPushBatch.h"
+#include "nds3/impl/epicsValueCache.h"
+#include "nds3/impl/epicsSharedArray.h"
+#include "nds3/impl/epicsSnapshot.h"
+#include "nds3/impl/epicsPvStatistics.h"
+#include "nds3/impl/epicsLatencyHistogram.h"
+
 namespace nds
 {
 
@@ -28,11 +46,56 @@ class EpicsFactoryImpl;
  * @brief The AsynInterface class. Allocated by AsynPort
  *        to communicate with the AsynDriver
  */
-class EpicsInterfaceImpl: public InterfaceBaseImpl, asynPortDriver
+class EpicsInterfaceImpl: public InterfaceBaseImpl, EpicsAsynPortImpl
 {
 public:
     EpicsInterfaceImpl(const std::string& portName, EpicsFactoryImpl* pEpicsFactory);
 
+    virtual ~EpicsInterfaceImpl();
+
+    /**
+     * @brief Deliver the pushed values from a dedicated thread.
+     *
+     * After this call push() stores the values in a queue and returns
+     *  immediately: the asyn interrupt callbacks (and the processing of the
+     *  records) are executed by a dispatcher thread dedicated to the port.
+     * Arrays are copied into the queue.
+     *
+     * Must be called before the PVs start pushing data.
+     *
+     * @param queueSize      the maximum number of values in the queue
+     * @param overflowPolicy what to do when the queue is full
+     */
+    void enablePushQueue(size_t queueSize, pushQueueOverflow_t overflowPolicy);
+
+    /**
+     * @brief Spread the PVs across several asyn ports, each one with its own
+     *        thread.
+     *
+     * Creates numShards - 1 additional ports named portName_1, portName_2...:
+     *  the PVs are assigned to the shards in round robin by registerPV() and
+     *  the links of their records point to the assigned shard, so the blocking
+     *  reads and writes of PVs in different shards are executed in parallel.
+     * The PVs of the driver must be prepared to be accessed concurrently.
+     *
+     * Must be called before the PVs are registered.
+     *
+     * @param numShards the total number of asyn ports, including the main one
+     */
+    void enableShards(size_t numShards);
+
+    /**
+     * @brief Replace the interrupt registration functions of the asyn
+     *        interfaces of a port with hooks that index the subscribers.
+     *
+     * Called for the main port and for the shards.
+     *
+     * @param pInterfaces the interfaces registered by the asyn port
+     */
+    void installInterruptHooks(asynStandardInterfaces* pInterfaces);
+
+    std::string getPortName() const;
+
     virtual void registerPV(std::shared_ptr<PVBaseImpl> pv);
 
     virtual void deregisterPV(std::shared_ptr<PVBaseImpl> pv);
@@ -46,6 +109,45 @@ public:
     virtual void push(const PVBaseImpl& pv, const timespec& timestamp, const std::vector<std::int32_t> & value);
     virtual void push(const PVBaseImpl& pv, const timespec& timestamp, const std::vector<double> & value);
     virtual void push(const PVBaseImpl& pv, const timespec& timestamp, const std::string& value);
+#ifdef NDS3_EXTENDED_DATA_TYPES
+    virtual void push(const PVBaseImpl& pv, const timespec& timestamp, const std::vector<std::int16_t> & value);
+    virtual void push(const PVBaseImpl& pv, const timespec& timestamp, const std::vector<std::uint16_t> & value);
+    virtual void push(const PVBaseImpl& pv, const timespec& timestamp, const std::vector<float> & value);
+    virtual void push(const PVBaseImpl& pv, const timespec& timestamp, const std::int64_t& value);
+    virtual void push(const PVBaseImpl& pv, const timespec& timestamp, const std::vector<std::int64_t> & value);
+#endif
+
+    /**
+     * @brief Push several scalar values at once.
+     *
+     * Equivalent to calling push() for each value in the batch, but the
+     *  subscribers of each asyn interface are locked only twice per batch:
+     *  to reference the subscribers of the values and to terminate the
+     *  delivery. The callbacks are called without the lock.
+     *
+     * @param batch the values to push. All the PVs must belong to this port
+     */
+    void pushBatch(const EpicsPushBatch& batch);
+
+    /**
+     * @brief Push an array without copying it.
+     *
+     * The EPICS layer keeps a reference to the array instead of copying it:
+     *  the push queue, the value cache and the genericPointer interrupt
+     *  clients (see EpicsSharedArray) share it. The driver must not modify
+     *  the array after the call; it can reuse it when the last reference is
+     *  released, for instance by acquiring it from an EpicsBufferPool.
+     *
+     * Available for the element types of the array PVs (std::int8_t,
+     *  std::uint8_t, std::int32_t, double and, with the extended data types,
+     *  std::int16_t, std::uint16_t, float and std::int64_t).
+     *
+     * @param pv        the PV that receives the array
+     * @param timestamp the array's timestamp
+     * @param pArray    the array
+     */
+    template<typename T>
+    void pushSharedArray(const PVBaseImpl& pv, const timespec& timestamp, const std::shared_ptr<const std::vector<T> >& pArray);
 
     virtual asynStatus readInt32(asynUser *pasynUser, epicsInt32 *value);
     virtual asynStatus writeInt32(asynUser *pasynUser, epicsInt32 value);
@@ -68,18 +170,307 @@ public:
     virtual asynStatus writeInt32Array(asynUser *pasynUser, epicsInt32 *value,
                                                    size_t nElements);
 
+#ifdef NDS3_EXTENDED_DATA_TYPES
+    virtual asynStatus readInt16Array(asynUser *pasynUser, epicsInt16 *value,
+                                                  size_t nElements, size_t *nIn);
+    virtual asynStatus writeInt16Array(asynUser *pasynUser, epicsInt16 *value,
+                                                   size_t nElements);
+
+    virtual asynStatus readFloat32Array(asynUser *pasynUser, epicsFloat32 *value,
+                                                  size_t nElements, size_t *nIn);
+    virtual asynStatus writeFloat32Array(asynUser *pasynUser, epicsFloat32 *value,
+                                                   size_t nElements);
+
+    virtual asynStatus readInt64(asynUser *pasynUser, epicsInt64 *value);
+    virtual asynStatus writeInt64(asynUser *pasynUser, epicsInt64 value);
+
+    virtual asynStatus readInt64Array(asynUser *pasynUser, epicsInt64 *value,
+                                                  size_t nElements, size_t *nIn);
+    virtual asynStatus writeInt64Array(asynUser *pasynUser, epicsInt64 *value,
+                                                   size_t nElements);
+#endif
+
     virtual asynStatus drvUserCreate(asynUser *pasynUser, const char *drvInfo,
                                      const char **pptypeName, size_t *psize);
 
+    virtual void report(FILE* fp, int details);
+
+    /**
+     * @brief Print the time spent creating the records of the port and
+     *        resolving their links during iocInit (ndsInitReport).
+     *
+     * @param fp the output file
+     */
+    void initReport(FILE* fp) const;
+
+    /**
+     * @brief Statistics of a PV, returned by collectStatistics().
+     */
+    struct pvStatistics_t
+    {
+        std::string m_portName;
+        std::string m_pvName;                 ///< The PV name from the port
+        pvStatisticsSnapshot_t m_statistics;
+    };
+
+    typedef std::vector<pvStatistics_t> pvStatisticsList_t;
+
+    /**
+     * @brief Append the statistics of all the PVs of the port, including the
+     *        deregistered ones (ndsPvStats).
+     *
+     * @param pStatistics the list that receives the statistics
+     */
+    void collectStatistics(pvStatisticsList_t* pStatistics) const;
+
+    /**
+     * @brief Print the latency histograms of the port and of the PVs
+     *        selected with ndsSetLatencyHistograms (ndsLatencyReport).
+     *
+     * @param fp the output file
+     */
+    void latencyReport(FILE* fp) const;
+
+    /**
+     * @brief Clear the latency histograms of the port and of its PVs
+     *        (ndsLatencyReset).
+     */
+    void resetLatency();
+
     timespec convertEpicsTimeToUnixTime(const epicsTimeStamp& time);
     epicsTimeStamp convertUnixTimeToEpicsTime(const timespec& time);
 
+    /**
+     * @brief Describes how the values of an NDS type travel to EPICS: the
+     *        asyn interface that carries them and the records that
+     *        display them.
+     *
+     * Specialized for each NDS value type in epicsInterfaceImpl.cpp. Each
+     *  specialization provides:
+     * - asyn_t: the element type on the asyn interface
+     * - getHook(): the interrupt hook of the asyn interface
+     * - inputRecord(), outputRecord(), inputDeviceType(), outputDeviceType()
+     *   and ftvl(): the record types, DTYP and FTVL of the generated records
+     *
+     * @tparam T the value type used by the NDS PVs (e.g. std::vector<float>)
+     */
+    template<typename T>
+    struct typeTraits_t;
+
 private:
-    template<typename T, typename interruptType>
-    void pushOneValue(const PVBaseImpl& pv, const timespec& timestamp, const T& value, void* interruptPvt);
+    /**
+     * @brief Keeps track of the asyn clients registered for the interrupts of
+     *        one asyn interface, indexed by reason.
+     *
+     * The register/cancel functions of the asyn interface are replaced with
+     *  hooks that keep the index updated, so a push visits only the records
+     *  bound to the pushed PV instead of the whole list of interrupt clients.
+     *
+     * The list of the subscribers of a reason is copied on write: a delivery
+     *  takes a reference to the current list and calls the callbacks without
+     *  holding the lock, so the callbacks can register and cancel interrupt
+     *  users.
+     */
+    template<typename interfaceType, typename callbackType, typename interruptType>
+    struct interruptHook_t
+    {
+        interruptHook_t(): m_pOriginal(0), m_pDeliveries(0), m_waitingCancels(0)
+        {
+        }
+
+        typedef interfaceType interface_t;
+        typedef callbackType callback_t;
+        typedef interruptType interrupt_t;
+        typedef std::vector<interrupt_t*> subscribers_t;
+
+        /**
+         * @brief A delivery in progress, linked in m_pDeliveries while its
+         *        callbacks are called.
+         */
+        struct delivery_t
+        {
+            delivery_t(): m_pPrevious(0), m_pNext(0)
+            {
+            }
+
+            std::shared_ptr<const subscribers_t> m_pSubscribers;
+            std::thread::id m_thread;
+            subscribers_t m_cancelled;   ///< Subscribers cancelled by the delivering thread: they are skipped
+            delivery_t* m_pPrevious;
+            delivery_t* m_pNext;
+        };
+
+        interface_t m_interface;        ///< Copy of the asyn interface with the hooked functions.
+        const interface_t* m_pOriginal; ///< The interface installed by asynPortDriver.
+
+        std::mutex m_lock;              ///< Protects m_subscribers and m_pDeliveries. Not held while calling the callbacks.
+        std::condition_variable m_deliveryDone; ///< Signalled when a delivery terminates
+        std::vector<std::shared_ptr<const subscribers_t> > m_subscribers;
+        delivery_t* m_pDeliveries;      ///< The deliveries in progress, waited by cancelInterruptUser()
+        size_t m_waitingCancels;        ///< Number of cancelInterruptUser() waiting for m_deliveryDone
+    };
+
+    /**
+     * @brief Reference the subscribers of a reason and link the delivery in
+     *        the hook. The subscribers lock must be held.
+     *
+     * @param hook      the hook of the asyn interface
+     * @param reason    the reason of the delivered value
+     * @param pDelivery the delivery. Its subscribers stay NULL if the reason
+     *                  has no subscribers
+     */
+    template<typename hook_t>
+    static void startDelivery(hook_t& hook, size_t reason, typename hook_t::delivery_t* pDelivery);
+
+    /**
+     * @brief Unlink a delivery started by startDelivery(). The subscribers
+     *        lock must be held.
+     */
+    template<typename hook_t>
+    static void endDelivery(hook_t& hook, typename hook_t::delivery_t* pDelivery);
+
+    /**
+     * @brief Takes a reference to the subscribers of a reason and registers
+     *        the delivery until it goes out of scope.
+     */
+    template<typename hook_t>
+    class deliveryGuard_t
+    {
+    public:
+        deliveryGuard_t(hook_t& hook, size_t reason);
+
+        ~deliveryGuard_t();
+
+        /**
+         * @brief Returns false if the reason has no subscribers.
+         */
+        bool hasSubscribers() const
+        {
+            return m_delivery.m_pSubscribers.get() != 0 && !m_delivery.m_pSubscribers->empty();
+        }
+
+        const typename hook_t::delivery_t& get() const
+        {
+            return m_delivery;
+        }
+
+    private:
+        deliveryGuard_t(const deliveryGuard_t&);
+        deliveryGuard_t& operator=(const deliveryGuard_t&);
+
+        hook_t& m_hook;
+        typename hook_t::delivery_t m_delivery;
+    };
+
+    typedef interruptHook_t<asynInt32, interruptCallbackInt32, asynInt32Interrupt> int32Hook_t;
+    typedef interruptHook_t<asynFloat64, interruptCallbackFloat64, asynFloat64Interrupt> float64Hook_t;
+    typedef interruptHook_t<asynInt8Array, interruptCallbackInt8Array, asynInt8ArrayInterrupt> int8ArrayHook_t;
+    typedef interruptHook_t<asynInt32Array, interruptCallbackInt32Array, asynInt32ArrayInterrupt> int32ArrayHook_t;
+    typedef interruptHook_t<asynFloat64Array, interruptCallbackFloat64Array, asynFloat64ArrayInterrupt> float64ArrayHook_t;
+    typedef interruptHook_t<asynGenericPointer, interruptCallbackGenericPointer, asynGenericPointerInterrupt> genericPointerHook_t;
+#ifdef NDS3_EXTENDED_DATA_TYPES
+    typedef interruptHook_t<asynInt16Array, interruptCallbackInt16Array, asynInt16ArrayInterrupt> int16ArrayHook_t;
+    typedef interruptHook_t<asynFloat32Array, interruptCallbackFloat32Array, asynFloat32ArrayInterrupt> float32ArrayHook_t;
+    typedef interruptHook_t<asynInt64, interruptCallbackInt64, asynInt64Interrupt> int64Hook_t;
+    typedef interruptHook_t<asynInt64Array, interruptCallbackInt64Array, asynInt64ArrayInterrupt> int64ArrayHook_t;
+#endif
+
+    virtual EpicsInterfaceImpl* getInterfaceImpl();
+
+    /**
+     * @brief Returns the name of the asyn port that serves the PV with the
+     *        specified reason.
+     */
+    std::string getShardPortName(size_t reason) const;
+
+    /**
+     * @brief Returns true if the PV's read and write functions don't block.
+     *
+     * The PV doesn't block if it is a PVVariableIn/PVVariableOut, if it
+     *  derives from EpicsNonBlockingPV or if its name matches a pattern
+     *  declared with ndsSetNonBlockingPVs.
+     */
+    bool isNonBlocking(const PVBaseImpl& pv) const;
+
+    /**
+     * @brief Returns the name of the synchronous asyn port used by the
+     *        non-blocking PVs. Creates the port the first time it is called.
+     */
+    std::string getSynchronousPortName();
+
+    /**
+     * @brief Apply the scheduling policy and the CPU affinity configured with
+     *        ndsSetThreadPolicy to the thread of an asyn port.
+     *
+     * The priority and the stack size are passed to asyn when the port is
+     *  created.
+     */
+    void applyPortThreadPolicy(const std::string& asynPortName);
+
+    template<typename hook_t, hook_t EpicsInterfaceImpl::*pHook>
+    void installInterruptHook(asynInterface* pAsynInterface);
+
+    template<typename hook_t, hook_t EpicsInterfaceImpl::*pHook>
+    static asynStatus registerInterruptUser(void* drvPvt, asynUser* pasynUser,
+                                            typename hook_t::callback_t callback, void* userPvt, void** registrarPvt);
+
+    template<typename hook_t, hook_t EpicsInterfaceImpl::*pHook>
+    static asynStatus cancelInterruptUser(void* drvPvt, asynUser* pasynUser, void* registrarPvt);
+
+    template<typename T>
+    void pushValue(const PVBaseImpl& pv, const timespec& timestamp, const T& value);
+
+    template<typename T>
+    void pushValue(const PVBaseImpl& pv, const timespec& timestamp, const std::vector<T>& value);
+
+    void pushValue(const PVBaseImpl& pv, const timespec& timestamp, const std::string& value);
+
+    template<typename T, typename hook_t>
+    void pushOneValue(hook_t& hook, const PVBaseImpl& pv, const timespec& timestamp, const T& value);
+
+    /**
+     * @brief Push an array to the subscribers of an asyn interface.
+     *
+     * @param pOwner the owner of pValue, if the array is shared by the driver.
+     *               When NULL the array is copied only if it has to survive
+     *               the call (push queue, value cache, genericPointer clients)
+     */
+    template<typename T, typename hook_t>
+    void pushArray(hook_t& hook, const PVBaseImpl& pv, const timespec& timestamp, const T* pValue, size_t numElements,
+                   std::shared_ptr<const void> pOwner = std::shared_ptr<const void>());
 
-    template<typename T, typename interruptType>
-    void pushArray(const PVBaseImpl& pv, const timespec& timestamp, const T* pValue, size_t numElements, void* interruptPvt);
+    template<typename T, typename hook_t>
+    void deliverOneValue(hook_t& hook, size_t reason, const timespec& timestamp, const T& value, std::uint64_t pushNanoseconds);
+
+    /**
+     * @brief Call the interrupt callbacks of a scalar.
+     *
+     * @return the number of callbacks called
+     */
+    template<typename T, typename delivery_t>
+    size_t callSubscribers(const delivery_t& delivery, const epicsTimeStamp& timestamp, const T& value);
+
+    template<typename T, typename hook_t, typename batchValue_t>
+    void pushBatchValues(hook_t& hook, const std::vector<batchValue_t>& values);
+
+    template<typename T, typename hook_t>
+    void deliverArray(hook_t& hook, size_t reason, const timespec& timestamp, const T* pValue, size_t numElements,
+                      const std::shared_ptr<const void>& pOwner, std::uint64_t pushNanoseconds);
+
+    /**
+     * @brief Deliver an array to the genericPointer subscribers.
+     *
+     * @return the number of callbacks called
+     */
+    template<typename T>
+    size_t deliverSharedArray(size_t reason, const timespec& timestamp, const T* pValue, size_t numElements,
+                              std::shared_ptr<const void> pOwner);
+
+    template<typename T, typename hook_t>
+    static void deliverQueuedValue(EpicsInterfaceImpl* pInterface, const queuedPush_t& push);
+
+    template<typename T, typename hook_t>
+    static void deliverQueuedArray(EpicsInterfaceImpl* pInterface, const queuedPush_t& push);
 
     template<typename T>
     asynStatus writeOneValue(asynUser* pasynUser, const T& pValue);
@@ -87,10 +478,18 @@ private:
     template<typename T>
     asynStatus readOneValue(asynUser* pasynUser, T* pValue);
 
-    template<typename T>
+    /**
+     * @brief Read an array from a PV.
+     *
+     * @tparam T                 the element type of the asyn interface
+     * @tparam unsignedElement_t the element type of the PVs with unsigned
+     *                           elements (reasonEntry_t::m_unsignedElements),
+     *                           when it differs from T only by the signedness
+     */
+    template<typename T, typename unsignedElement_t = T>
     asynStatus readArray(asynUser *pasynUser, T* pValue, size_t nElements, size_t *nIn);
 
-    template<typename T>
+    template<typename T, typename unsignedElement_t = T>
     asynStatus writeArray(asynUser *pasynUser, T* pValue, size_t nElements);
 
     typedef std::pair<const char*, size_t> errorAndSize_t;
@@ -107,13 +506,330 @@ private:
      */
     errorAndSize_t getErrorString(const std::string& error);
 
-    std::vector<std::shared_ptr<PVBaseImpl> > m_pvs;
+    /**
+     * @brief State of a reason.
+     *
+     * Allocated by registerPV() and kept until the interface is destroyed:
+     *  the records linked to the reason stay valid after the PV has been
+     *  deregistered, and a PV registered later with the same name takes the
+     *  reason over.
+     */
+    struct reasonEntry_t
+    {
+        reasonEntry_t(const std::string& name): m_name(name), m_unsignedElements(false), m_registered(false), m_activeCalls(0), m_releasePending(false)
+        {
+        }
+
+        const std::string m_name;                       ///< The PV name from the port
+        std::shared_ptr<PVBaseImpl> m_pPV;              ///< NULL while the reason is not registered
+        std::unique_ptr<EpicsPushFilter> m_pPushFilter; ///< NULL when not configured
+        std::unique_ptr<EpicsValueCache> m_pValueCache; ///< NULL when not configured
+        bool m_unsignedElements;                        ///< The PV's elements are unsigned, its asyn interface is signed (USHORT waveforms)
+        std::atomic<bool> m_registered;
+        std::atomic<size_t> m_activeCalls;              ///< Reads, writes and pushes in progress. See acquireReason()
+        bool m_releasePending;                          ///< The PV is deregistered but still in use. Protected by m_registrationLock
+        EpicsPvStatistics m_statistics;                 ///< Kept when the PV is deregistered
+        std::unique_ptr<EpicsLatencyHistograms> m_pLatency; ///< NULL when not configured. Set before the entry is published, never replaced
+    };
+
+    /**
+     * @brief Releases a reason acquired with acquireReason() when it goes out
+     *        of scope.
+     *
+     * The guards of a thread are linked, so deregisterPV() can tell whether
+     *  it is called from a read, write or push of the PV being deregistered.
+     */
+    class reasonGuard_t
+    {
+    public:
+        reasonGuard_t(const EpicsInterfaceImpl& interface, reasonEntry_t* pEntry): m_interface(interface), m_pEntry(pEntry), m_pPrevious(m_pLastGuard)
+        {
+            if(m_pEntry != 0)
+            {
+                m_pLastGuard = this;
+            }
+        }
+
+        ~reasonGuard_t()
+        {
+            if(m_pEntry != 0)
+            {
+                m_pLastGuard = m_pPrevious;
+                m_interface.releaseCall(m_pEntry);
+            }
+        }
+
+        reasonEntry_t* get() const
+        {
+            return m_pEntry;
+        }
+
+        reasonEntry_t* operator->() const
+        {
+            return m_pEntry;
+        }
+
+        /**
+         * @brief Returns true if the calling thread holds a guard on the
+         *        entry.
+         */
+        static bool isHeldByThisThread(const reasonEntry_t* pEntry);
+
+    private:
+        reasonGuard_t(const reasonGuard_t&);
+        reasonGuard_t& operator=(const reasonGuard_t&);
+
+        const EpicsInterfaceImpl& m_interface;
+        reasonEntry_t* m_pEntry;
+        reasonGuard_t* m_pPrevious;
+
+        static thread_local reasonGuard_t* m_pLastGuard; ///< The innermost guard of the thread
+    };
+
+    /**
+     * @brief Prevents the deregistration of a reason's PV until the returned
+     *        entry is released.
+     *
+     * @param reason the reason to acquire
+     * @return the reason's entry, or NULL if the reason has no registered PV.
+     *         Must be released by a reasonGuard_t
+     */
+    reasonEntry_t* acquireReason(size_t reason) const;
+
+    /**
+     * @brief Acquire the reason assigned to a PV by registerPV().
+     *
+     * The lookup uses the PV address in the published snapshot of the
+     *  reasons and doesn't allocate, therefore it can be called concurrently
+     *  by several producer threads.
+     *
+     * @param pv      the PV for which the reason is requested
+     * @param pReason receives the PV's reason
+     * @return the reason's entry, or NULL if the PV is not registered.
+     *         Must be released by a reasonGuard_t
+     */
+    reasonEntry_t* acquireReason(const PVBaseImpl& pv, size_t* pReason) const;
+
+    /**
+     * @brief Acquire an entry taken from the snapshot of the reasons, which
+     *        must not be held: the entry may have to be released.
+     */
+    reasonEntry_t* acquireEntry(reasonEntry_t* pEntry) const;
+
+    /**
+     * @brief Terminate a call started with acquireReason(). Releases the PV
+     *        if the call was the last one on a deregistered PV.
+     */
+    void releaseCall(reasonEntry_t* pEntry) const;
+
+    /**
+     * @brief Release the PV of a deregistered reason once its calls have
+     *        terminated. m_registrationLock must be held.
+     *
+     * @param entry  the deregistered reason
+     * @param pPV    receives the PV, to be released without holding the lock
+     */
+    void releaseEntry(reasonEntry_t& entry, std::shared_ptr<PVBaseImpl>* pPV) const;
+
+    /**
+     * @brief Allocate the reason of a PV, or reuse the reason of a
+     *        deregistered PV with the same name.
+     *
+     * @param pv      the PV to register
+     * @param pReused set to true if the reason (and its records) already existed
+     * @return the PV's reason
+     */
+    size_t allocateReason(const std::shared_ptr<PVBaseImpl>& pv, bool* pReused);
+
+    /**
+     * @brief Returns the entry of a reason from the published snapshot, or
+     *        NULL if the reason doesn't exist. The reason is not acquired:
+     *        only the members that don't change once the entry is published
+     *        can be used.
+     */
+    reasonEntry_t* getPublishedEntry(size_t reason) const;
+
+    /**
+     * @brief Read an array from the PV of an acquired reason.
+     *
+     * @tparam T           the element type of the asyn interface
+     * @tparam pvElement_t the element type of the PV
+     */
+    template<typename T, typename pvElement_t>
+    static void readPVArray(const reasonEntry_t& entry, timespec* pTimestamp, T* pValue, size_t nElements, size_t *nIn);
+
+    /**
+     * @brief Write an array into the PV of an acquired reason.
+     *
+     * @tparam T           the element type of the asyn interface
+     * @tparam pvElement_t the element type of the PV
+     */
+    template<typename T, typename pvElement_t>
+    static void writePVArray(const reasonEntry_t& entry, const timespec& timestamp, T* pValue, size_t nElements);
+
+    /**
+     * @brief Count the callbacks called for a pushed value and record the
+     *        time elapsed since the push.
+     *
+     * @param reason          the pushed PV's reason
+     * @param callbacks       the number of callbacks called
+     * @param pushNanoseconds the time of the push, from
+     *                        EpicsPvStatistics::getNanoseconds()
+     */
+    void countDelivery(size_t reason, size_t callbacks, std::uint64_t pushNanoseconds);
+
+    /**
+     * @brief Record the latency between the timestamp of a pushed value and
+     *        the push in the histograms of the port and of the PV.
+     */
+    void recordAcquisitionLatency(const reasonEntry_t& entry, const timespec& timestamp, const timespec& now);
+
+    /**
+     * @brief Count a read or a write in the statistics of its PV, or an error
+     *        if auxStatus is not asynSuccess.
+     *
+     * @param pasynUser        the request
+     * @param startNanoseconds the time at which the request started, from
+     *                         EpicsPvStatistics::getNanoseconds()
+     * @param bytes            the bytes read or written
+     * @param write            true for a write, false for a read
+     */
+    void countRequest(asynUser* pasynUser, std::uint64_t startNanoseconds, size_t bytes, bool write);
+
+    /**
+     * @brief Publish the reasons allocated by registerPV() and the removals
+     *        done by deregisterPV() to the readers.
+     */
+    void publishReasons();
+
+    typedef std::unordered_map<const PVBaseImpl*, size_t> pvToReason_t;
+
+    /**
+     * @brief Immutable snapshot of the reasons, read without locks by the
+     *        pushes and by the asyn requests. The entries outlive the
+     *        snapshots.
+     */
+    struct reasonTable_t
+    {
+        std::vector<reasonEntry_t*> m_entries; ///< Indexed by reason
+        pvToReason_t m_pvToReason;             ///< Used by push()
+    };
+
+    EpicsSnapshot<reasonTable_t> m_reasonTable; ///< The last published snapshot
+
+    mutable std::mutex m_registrationLock;                  ///< Protects the following members
+    mutable std::condition_variable m_releasedCondition;    ///< Signalled when a deregistered PV has been released
+    std::vector<std::unique_ptr<reasonEntry_t> > m_reasons; ///< Indexed by reason
+    pvToReason_t m_pvToReason;                              ///< Copied into the snapshots
+
+    typedef std::unordered_map<const PVBaseImpl*, std::shared_ptr<PVBaseImpl> > feedbackPVs_t;
+    feedbackPVs_t m_feedbackPVs; ///< Feedback PVs created for the action PVs, deregistered with them
+    feedbackPVs_t m_statisticsPVs; ///< Statistics PVs enabled with ndsSetPvStatsRecords, deregistered with their PVs
+
+    typedef std::unordered_map<std::string, size_t> nameToReason_t;
+    nameToReason_t m_nameToReason; ///< Reasons by name from the port, built by registerPV(), used by drvUserCreate()
+
+    int32Hook_t m_int32Hook;
+    float64Hook_t m_float64Hook;
+    int8ArrayHook_t m_int8ArrayHook;
+    int32ArrayHook_t m_int32ArrayHook;
+    float64ArrayHook_t m_float64ArrayHook;
+    genericPointerHook_t m_genericPointerHook; ///< Clients of the arrays by reference (EpicsSharedArray)
+#ifdef NDS3_EXTENDED_DATA_TYPES
+    int16ArrayHook_t m_int16ArrayHook;
+    float32ArrayHook_t m_float32ArrayHook;
+    int64Hook_t m_int64Hook;
+    int64ArrayHook_t m_int64ArrayHook;
+#endif
+
+    std::unique_ptr<EpicsPushDispatcher> m_pPushDispatcher; ///< Allocated when the push queue is enabled
+
+    EpicsLatencyHistograms m_latency; ///< Latencies of all the PVs of the port
+
+    std::vector<std::unique_ptr<EpicsShardPortImpl> > m_shardPorts; ///< Additional ports allocated by enableShards()
+    std::unique_ptr<EpicsShardPortImpl> m_pSynchronousPort;         ///< Port without thread for the non-blocking PVs
+
+    /**
+     * @brief Record generated by registerPV(), created by
+     *        registrationTerminated().
+     */
+    struct recordDefinition_t
+    {
+        recordDefinition_t(const std::string& recordType, const std::string& name);
+
+        void addField(const std::string& field, const std::string& value);
+
+        std::string m_recordType;
+        std::string m_name;
+
+        typedef std::vector<std::pair<std::string, std::string> > fields_t;
+        fields_t m_fields; ///< Field names and values, in the order they are set
+    };
+
+    /**
+     * @brief Create a record in the EPICS database through the dbStatic API.
+     *
+     * If the record already exists then its fields are updated, as
+     *  dbLoadDatabase does for records defined more than once.
+     *
+     * @param pEntry the database entry used for the creation
+     * @param record the record to create
+     */
+    static void createRecord(DBENTRY* pEntry, const recordDefinition_t& record);
+
+    typedef std::vector<recordDefinition_t> records_t;
+
+    /**
+     * @brief Load the records in m_records from the database cache if it is
+     *        enabled and up to date, otherwise create them.
+     *
+     * @return true if the records have been loaded from the cache
+     */
+    bool loadOrCreateRecords();
+
+    /**
+     * @brief Create the records in m_records.
+     */
+    void createRecords();
+
+    /**
+     * @brief Compute the FNV-1a hash of the records in m_records (types,
+     *        names, fields and values).
+     */
+    std::uint64_t hashRecords() const;
+
+    /**
+     * @brief Returns the hash stored in a database saved by writeDatabase().
+     *
+     * @param fileName the database file
+     * @param pHash    receives the hash
+     * @return false if the file doesn't exist or doesn't contain a hash
+     */
+    static bool readDatabaseHash(const std::string& fileName, std::uint64_t* pHash);
+
+    /**
+     * @brief Save the records in m_records to a db file, preceded by their
+     *        hash.
+     *
+     * The file is first written with a temporary name and then renamed, so a
+     *  reader never sees a partial file.
+     *
+     * @param fileName the database file
+     * @param hash     the hash of the records
+     */
+    void writeDatabase(const std::string& fileName, std::uint64_t hash) const;
+
+    records_t m_records; ///< Records waiting for registrationTerminated()
 
-    std::map<std::string, size_t> m_pvNameToReason;
+    size_t m_numRecords;             ///< Number of records created or loaded by registrationTerminated()
+    bool m_recordsFromCache;         ///< True if the records have been loaded from the database cache
+    double m_recordsCreationSeconds; ///< Time spent in registrationTerminated()
 
-    std::string m_autogeneratedDB;
+    std::atomic<std::uint64_t> m_drvUserCreateCalls;
+    std::atomic<std::uint64_t> m_drvUserCreateNanoseconds; ///< Total time spent resolving the records' links
 
     std::set<std::string> m_errorMessages;
+    std::mutex m_errorMessagesLock; ///< The shards may need error messages concurrently
 
     EpicsFactoryImpl* m_pEpicsFactory;
 
@@ -0,0 +1,74 @@
+/*
+ * EPICS support for NDS3
+ *
+ * Copyright (c) 2015 Cosylab d.d.
+ *
+ * For more information about the license please refer to the license.txt
+ * file included in the distribution.
+ */
+
+#ifndef NDSEPICSINTERFACEPROXYIMPL_H
+#define NDSEPICSINTERFACEPROXYIMPL_H
+
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+#include <nds3/impl/interfaceBaseImpl.h>
+
+#include "nds3/impl/epicsConfig.h"
+
+namespace nds
+{
+
+class EpicsInterfaceImpl;
+
+/**
+ * @internal
+ * @brief Interface returned to a port by EpicsFactoryImpl::getNewInterface().
+ *
+ * Forwards the calls to the EpicsInterfaceImpl of the port, which is never
+ *  deleted: the asyn ports and the records cannot be removed from a running
+ *  IOC. When a device is destroyed the port deletes its proxy, which
+ *  deregisters the PVs still registered; if the device is created again the
+ *  new PVs take over the reasons and the records of the old ones.
+ */
+class EpicsInterfaceProxyImpl: public InterfaceBaseImpl
+{
+public:
+    EpicsInterfaceProxyImpl(EpicsInterfaceImpl* pInterface);
+
+    virtual ~EpicsInterfaceProxyImpl();
+
+    virtual void registerPV(std::shared_ptr<PVBaseImpl> pv);
+
+    virtual void deregisterPV(std::shared_ptr<PVBaseImpl> pv);
+
+    virtual void registrationTerminated();
+
+    virtual void push(const PVBaseImpl& pv, const timespec& timestamp, const std::int32_t& value);
+    virtual void push(const PVBaseImpl& pv, const timespec& timestamp, const double& value);
+    virtual void push(const PVBaseImpl& pv, const timespec& timestamp, const std::vector<std::int8_t> & value);
+    virtual void push(const PVBaseImpl& pv, const timespec& timestamp, const std::vector<std::uint8_t> & value);
+    virtual void push(const PVBaseImpl& pv, const timespec& timestamp, const std::vector<std::int32_t> & value);
+    virtual void push(const PVBaseImpl& pv, const timespec& timestamp, const std::vector<double> & value);
+    virtual void push(const PVBaseImpl& pv, const timespec& timestamp, const std::string& value);
+#ifdef NDS3_EXTENDED_DATA_TYPES
+    virtual void push(const PVBaseImpl& pv, const timespec& timestamp, const std::vector<std::int16_t> & value);
+    virtual void push(const PVBaseImpl& pv, const timespec& timestamp, const std::vector<std::uint16_t> & value);
+    virtual void push(const PVBaseImpl& pv, const timespec& timestamp, const std::vector<float> & value);
+    virtual void push(const PVBaseImpl& pv, const timespec& timestamp, const std::int64_t& value);
+    virtual void push(const PVBaseImpl& pv, const timespec& timestamp, const std::vector<std::int64_t> & value);
+#endif
+
+private:
+    EpicsInterfaceImpl* m_pInterface;
+
+    std::mutex m_pvsLock;
+    typedef std::unordered_map<const PVBaseImpl*, std::shared_ptr<PVBaseImpl> > pvs_t;
+    pvs_t m_pvs; ///< PVs registered through this proxy, deregistered by the destructor
+};
+
+}
+
+#endif // NDSEPICSINTERFACEPROXYIMPL_H
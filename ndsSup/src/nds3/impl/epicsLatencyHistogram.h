@@ -0,0 +1,153 @@
+/*
+ * EPICS support for NDS3
+ *
+ * Copyright (c) 2015 Cosylab d.d.
+ *
+ * For more information about the license please refer to the license.txt
+ * file included in the distribution.
+ */
+
+#ifndef NDSEPICSLATENCYHISTOGRAM_H
+#define NDSEPICSLATENCYHISTOGRAM_H
+
+#include <atomic>
+#include <string>
+#include <cstdint>
+#include <cstddef>
+#include <cstdio>
+#include <ctime>
+
+namespace nds
+{
+
+/**
+ * @brief Percentiles of the latencies recorded in an EpicsLatencyHistogram,
+ *        returned by EpicsLatencyHistogram::getSummary().
+ *
+ * The percentiles are the upper bounds of the buckets they fall in.
+ */
+struct latencySummary_t
+{
+    std::uint64_t m_count;
+    double m_meanNanoseconds;
+    std::uint64_t m_p50Nanoseconds;
+    std::uint64_t m_p90Nanoseconds;
+    std::uint64_t m_p99Nanoseconds;
+    std::uint64_t m_p999Nanoseconds;
+    std::uint64_t m_maxNanoseconds;
+};
+
+/**
+ * @internal
+ * @brief Histogram of latencies with a fixed number of buckets.
+ *
+ * Latencies below 32 ns have one bucket per nanosecond; above, each power of
+ *  two is split in 32 buckets, so a recorded value is known with an error
+ *  below 3.2% up to 137 seconds. Longer latencies fall in the last bucket.
+ *
+ * record() is lock-free and can be called by any number of threads. The
+ *  summary and reset() are not atomic with respect to the recording threads:
+ *  a latency recorded during a reset may be partially kept.
+ */
+class EpicsLatencyHistogram
+{
+public:
+    EpicsLatencyHistogram();
+
+    void record(std::uint64_t nanoseconds)
+    {
+        m_buckets[getBucket(nanoseconds)].fetch_add(1, std::memory_order_relaxed);
+        m_sumNanoseconds.fetch_add(nanoseconds, std::memory_order_relaxed);
+
+        std::uint64_t maxNanoseconds(m_maxNanoseconds.load(std::memory_order_relaxed));
+        while(nanoseconds > maxNanoseconds &&
+              !m_maxNanoseconds.compare_exchange_weak(maxNanoseconds, nanoseconds, std::memory_order_relaxed))
+        {
+        }
+    }
+
+    void reset();
+
+    /**
+     * @brief Add the latencies recorded in another histogram, e.g. to combine
+     *        the histograms recorded by different threads.
+     */
+    void merge(const EpicsLatencyHistogram& other);
+
+    void getSummary(latencySummary_t* pSummary) const;
+
+    static size_t getBucket(std::uint64_t nanoseconds)
+    {
+        if(nanoseconds < subBuckets)
+        {
+            return (size_t)nanoseconds;
+        }
+        size_t exponent(63 - __builtin_clzll(nanoseconds));
+        size_t group(exponent - subBucketBits + 1);
+        if(group >= numGroups)
+        {
+            return numBuckets - 1;
+        }
+        return group * subBuckets + (size_t)((nanoseconds >> (exponent - subBucketBits)) & (subBuckets - 1));
+    }
+
+    /**
+     * @brief Returns the highest latency that falls in a bucket.
+     */
+    static std::uint64_t getBucketUpperBound(size_t bucket);
+
+    static const size_t subBucketBits = 5;
+    static const size_t subBuckets = 1 << subBucketBits;
+    static const size_t numGroups = 33;
+    static const size_t numBuckets = numGroups * subBuckets;
+
+private:
+    std::atomic<std::uint64_t> m_buckets[numBuckets];
+    std::atomic<std::uint64_t> m_sumNanoseconds;
+    std::atomic<std::uint64_t> m_maxNanoseconds;
+};
+
+
+/**
+ * @internal
+ * @brief The latencies recorded for a port or for a PV.
+ */
+struct EpicsLatencyHistograms
+{
+    EpicsLatencyHistogram m_acquisitionToPush; ///< From the timestamp of the pushed value to the push() call.
+    EpicsLatencyHistogram m_pushToCallbacks;   ///< From the push() call to the return of the interrupt callbacks.
+    EpicsLatencyHistogram m_readService;       ///< Duration of the reads requested by the records.
+    EpicsLatencyHistogram m_writeService;      ///< Duration of the writes requested by the records.
+
+    /**
+     * @brief Record the latency between the timestamp of a pushed value and
+     *        the push.
+     *
+     * @param timestamp the value's timestamp (CLOCK_REALTIME). Null timestamps
+     *                  are ignored, timestamps in the future count as 0
+     * @param now       the time of the push (CLOCK_REALTIME)
+     */
+    void recordAcquisition(const timespec& timestamp, const timespec& now)
+    {
+        if(timestamp.tv_sec == 0 && timestamp.tv_nsec == 0)
+        {
+            return;
+        }
+        std::int64_t nanoseconds((std::int64_t)(now.tv_sec - timestamp.tv_sec) * 1000000000 + (now.tv_nsec - timestamp.tv_nsec));
+        m_acquisitionToPush.record(nanoseconds < 0 ? 0 : (std::uint64_t)nanoseconds);
+    }
+
+    void reset();
+
+    /**
+     * @brief Print the percentiles of the four histograms.
+     *
+     * @param pFile where to print
+     * @param name  printed in the title
+     */
+    void report(FILE* pFile, const std::string& name) const;
+};
+
+}
+
+#endif // NDSEPICSLATENCYHISTOGRAM_H
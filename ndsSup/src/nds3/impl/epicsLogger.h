@@ -0,0 +1,149 @@
+/*
+ * EPICS support for NDS3
+ *
+ * Copyright (c) 2015 Cosylab d.d.
+ *
+ * For more information about the license please refer to the license.txt
+ * file included in the distribution.
+ */
+
+#ifndef NDSEPICSLOGGER_H
+#define NDSEPICSLOGGER_H
+
+#include <atomic>
+#include <memory>
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+
+#include <epicsEvent.h>
+
+#include <nds3/definitions.h>
+#include <nds3/impl/factoryBaseImpl.h>
+
+#include "nds3/impl/epicsRingBuffer.h"
+#include "nds3/impl/epicsThread.h"
+
+namespace nds
+{
+
+/**
+ * @internal
+ * @brief State of the rate limiter of a log source (a log stream).
+ *
+ * Each source is used by one thread at a time: the state is not protected.
+ */
+struct logRateLimiter_t
+{
+    logRateLimiter_t(): m_tokens(-1), m_suppressed(0)
+    {
+        m_lastRefill.tv_sec = 0;
+        m_lastRefill.tv_nsec = 0;
+    }
+
+    double m_tokens;            ///< Messages that can be logged now, -1 before the first message.
+    timespec m_lastRefill;      ///< Monotonic time of the last refill of the tokens.
+    std::uint64_t m_suppressed; ///< Messages suppressed or dropped since the last logged one.
+};
+
+/**
+ * @internal
+ * @brief Forwards the messages of the log streams to errlog from a
+ *        background thread.
+ *
+ * The threads that log copy the message into a preallocated lock-free queue
+ *  and return immediately: they never wait for errlog. When the queue is full
+ *  the message is dropped and counted, globally and in its source.
+ *
+ * Each source can log up to burst messages at once, then messagesPerSecond
+ *  messages per second (token bucket). The messages above the limit are
+ *  suppressed; their number is logged before the next message of the source
+ *  that passes the limit.
+ */
+class EpicsLogger
+{
+public:
+    /**
+     * @param pFactory the factory, used to create the background thread
+     * @param capacity maximum number of messages waiting for errlog
+     */
+    EpicsLogger(FactoryBaseImpl* pFactory, size_t capacity);
+
+    /**
+     * @brief Forwards the queued messages and stops the background thread.
+     */
+    ~EpicsLogger();
+
+    /**
+     * @brief Queue a message. Never blocks.
+     *
+     * Messages longer than maxMessageLength are truncated.
+     *
+     * @param pSource  the rate limiter of the message's source
+     * @param logLevel the severity
+     * @param pText    the text, not null terminated
+     * @param length   the length of the text
+     */
+    void log(logRateLimiter_t* pSource, logLevel_t logLevel, const char* pText, size_t length);
+
+    /**
+     * @brief Set the rate limit applied to each source.
+     *
+     * @param messagesPerSecond sustained rate, 0 to disable the rate limit
+     * @param burst             messages that can be logged at once
+     */
+    void setRateLimit(double messagesPerSecond, double burst);
+
+    /**
+     * @brief Forward the queued messages from the calling thread.
+     */
+    void flush();
+
+    /**
+     * @brief Print the counters of the logger.
+     */
+    void report(FILE* pFile) const;
+
+    static const size_t maxMessageLength = 511;
+
+private:
+    struct logMessage_t
+    {
+        logLevel_t m_logLevel;
+        std::uint64_t m_suppressedBefore; ///< Messages of the same source suppressed before this one.
+        size_t m_length;
+        char m_text[maxMessageLength + 1];
+    };
+
+    bool acceptMessage(logRateLimiter_t* pSource);
+
+    void forwardMessages();
+
+    void forward(const logMessage_t& message);
+
+    void reportDropped();
+
+    static void atExit(void* pParameter);
+
+    EpicsRingBuffer<logMessage_t> m_queue;
+
+    std::atomic<double> m_messagesPerSecond;
+    std::atomic<double> m_burst;
+
+    std::atomic<bool> m_running;
+    std::atomic<bool> m_forwarderSleeping;
+    epicsEventId m_forwarderEvent;
+
+    std::atomic<std::uint64_t> m_queuedMessages;    ///< Messages stored in the queue.
+    std::atomic<std::uint64_t> m_forwardedMessages; ///< Messages passed to errlog.
+    std::atomic<std::uint64_t> m_droppedMessages;   ///< Messages discarded because the queue was full.
+    std::atomic<std::uint64_t> m_suppressedMessages;///< Messages discarded by the rate limit.
+    std::atomic<std::uint64_t> m_truncatedMessages; ///< Messages longer than maxMessageLength.
+    std::atomic<std::uint64_t> m_reportedDropped;   ///< Dropped messages already reported to errlog.
+
+    std::unique_ptr<EpicsThread> m_pThread;
+};
+
+}
+
+#endif // NDSEPICSLOGGER_H
@@ -0,0 +1,84 @@
+/*
+ * EPICS support for NDS3
+ *
+ * Copyright (c) 2015 Cosylab d.d.
+ *
+ * For more information about the license please refer to the license.txt
+ * file included in the distribution.
+ */
+
+#ifndef NDSEPICSPROCESSATINIT_H
+#define NDSEPICSPROCESSATINIT_H
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include <callback.h>
+#include <dbAccess.h>
+#include <epicsEvent.h>
+
+namespace nds
+{
+
+/**
+ * @internal
+ * @brief Processes the records of the PVs declared with processAtInit once
+ *        the IOC is running.
+ *
+ * The records are looked up directly in the database and processed without
+ *  going through the shell. In parallel mode each record is processed by an
+ *  EPICS callback thread, so records in independent lock sets are processed
+ *  concurrently; process() returns when all the requests have been served.
+ */
+class EpicsProcessAtInit
+{
+public:
+    EpicsProcessAtInit();
+    ~EpicsProcessAtInit();
+
+    /**
+     * @brief Add a record to the list of the records to process.
+     *
+     * @param recordName the record's name
+     */
+    void addRecord(const std::string& recordName);
+
+    /**
+     * @brief Process all the added records and clear the list.
+     *
+     * Asynchronous records (e.g. the ones served by a port that can block)
+     *  complete their processing later: only the requests are waited for.
+     *
+     * @param parallel true to process the records through the callback
+     *                 queues, false to process them in the calling thread
+     */
+    void process(bool parallel);
+
+private:
+    struct request_t
+    {
+        CALLBACK m_callback;
+        DBADDR m_procAddress;         ///< The PROC field of the record
+        EpicsProcessAtInit* m_pOwner;
+    };
+
+    static void processRecord(DBADDR* pProcAddress);
+
+    static void processCallback(CALLBACK* pCallback);
+
+    /**
+     * @brief Called when a request has been served: wakes up process() after
+     *        the last one.
+     */
+    void requestDone();
+
+    std::vector<std::string> m_recordNames;
+
+    std::atomic<size_t> m_pendingRequests;
+    epicsEventId m_allDone;
+};
+
+}
+
+#endif // NDSEPICSPROCESSATINIT_H
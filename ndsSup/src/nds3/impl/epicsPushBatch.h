@@ -0,0 +1,87 @@
+/*
+ * EPICS support for NDS3
+ *
+ * Copyright (c) 2015 Cosylab d.d.
+ *
+ * For more information about the license please refer to the license.txt
+ * file included in the distribution.
+ */
+
+#ifndef NDSEPICSPUSHBATCH_H
+#define NDSEPICSPUSHBATCH_H
+
+#include <vector>
+#include <cstdint>
+#include <ctime>
+
+namespace nds
+{
+
+class PVBaseImpl;
+
+/**
+ * @brief A set of scalar values to push with a single call to
+ *        EpicsInterfaceImpl::pushBatch().
+ *
+ * The values are grouped by asyn interface while they are added, so the
+ *  interface delivers each group taking the subscribers lock only twice.
+ * clear() keeps the allocated memory: a driver can reuse the same batch on
+ *  every acquisition cycle without allocating.
+ *
+ * All the PVs in the batch must belong to the port that receives it.
+ */
+class EpicsPushBatch
+{
+public:
+    template<typename T>
+    struct value_t
+    {
+        value_t(const PVBaseImpl& pv, const timespec& timestamp, const T& value):
+            m_pPV(&pv), m_timestamp(timestamp), m_value(value)
+        {
+        }
+
+        const PVBaseImpl* m_pPV;
+        timespec m_timestamp;
+        T m_value;
+    };
+
+    void add(const PVBaseImpl& pv, const timespec& timestamp, const std::int32_t& value)
+    {
+        m_int32Values.push_back(value_t<std::int32_t>(pv, timestamp, value));
+    }
+
+    void add(const PVBaseImpl& pv, const timespec& timestamp, const double& value)
+    {
+        m_float64Values.push_back(value_t<double>(pv, timestamp, value));
+    }
+
+    void clear()
+    {
+        m_int32Values.clear();
+        m_float64Values.clear();
+    }
+
+    bool empty() const
+    {
+        return m_int32Values.empty() && m_float64Values.empty();
+    }
+
+    const std::vector<value_t<std::int32_t> >& getInt32Values() const
+    {
+        return m_int32Values;
+    }
+
+    const std::vector<value_t<double> >& getFloat64Values() const
+    {
+        return m_float64Values;
+    }
+
+private:
+    std::vector<value_t<std::int32_t> > m_int32Values;
+    std::vector<value_t<double> > m_float64Values;
+};
+
+}
+
+#endif // NDSEPICSPUSHBATCH_H
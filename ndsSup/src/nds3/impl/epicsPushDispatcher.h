@@ -0,0 +1,190 @@
+/*
+ * EPICS support for NDS3
+ *
+ * Copyright (c) 2015 Cosylab d.d.
+ *
+ * For more information about the license please refer to the license.txt
+ * file included in the distribution.
+ */
+
+#ifndef NDSEPICSPUSHDISPATCHER_H
+#define NDSEPICSPUSHDISPATCHER_H
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <string>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+
+#include <epicsEvent.h>
+
+#include "nds3/impl/epicsRingBuffer.h"
+#include "nds3/impl/epicsSnapshot.h"
+
+namespace nds
+{
+
+class EpicsInterfaceImpl;
+class EpicsFactoryImpl;
+class EpicsThread;
+
+/**
+ * @brief What push() does when the queue of a port is full.
+ */
+enum class pushQueueOverflow_t
+{
+    block,      ///< The producer waits until the dispatcher frees a slot.
+    dropOldest, ///< The oldest queued value is discarded.
+    keepLatest  ///< Only the latest value of each PV is kept until there is space in the queue.
+};
+
+/**
+ * @internal
+ * @brief A value pushed by a driver, waiting to be delivered to the asyn
+ *        interrupt subscribers.
+ */
+struct queuedPush_t
+{
+    typedef void (*deliver_t)(EpicsInterfaceImpl* pInterface, const queuedPush_t& push);
+
+    queuedPush_t(): m_deliver(0), m_pHook(0), m_reason(0), m_pushNanoseconds(0), m_scalar(0), m_pArrayData(0), m_numElements(0)
+    {
+        m_timestamp.tv_sec = 0;
+        m_timestamp.tv_nsec = 0;
+    }
+
+    template<typename T>
+    void setScalar(const T& value)
+    {
+        static_assert(sizeof(T) <= sizeof(m_scalar), "Scalar type too big for the push queue");
+        ::memcpy(&m_scalar, &value, sizeof(T));
+    }
+
+    template<typename T>
+    T getScalar() const
+    {
+        T value;
+        ::memcpy(&value, &m_scalar, sizeof(T));
+        return value;
+    }
+
+    deliver_t m_deliver;   ///< Delivers the value to the subscribers of the right asyn interface.
+    void* m_pHook;         ///< The interrupt hook of the asyn interface.
+    size_t m_reason;
+    timespec m_timestamp;
+    std::uint64_t m_pushNanoseconds;        ///< Monotonic time of the push, for the latency histograms.
+
+    std::uint64_t m_scalar;                 ///< Storage for scalar values.
+    std::shared_ptr<const void> m_pArray;   ///< Owner of the array data.
+    const void* m_pArrayData;
+    size_t m_numElements;
+};
+
+/**
+ * @internal
+ * @brief Decouples the drivers' threads from the delivery of the pushed
+ *        values to the EPICS records.
+ *
+ * push() stores the values in a bounded lock-free queue, a dedicated thread
+ *  per port delivers them to the asyn interrupt subscribers.
+ */
+class EpicsPushDispatcher
+{
+public:
+    EpicsPushDispatcher(EpicsFactoryImpl* pFactory, EpicsInterfaceImpl* pInterface, const std::string& portName,
+                        size_t queueSize, pushQueueOverflow_t overflowPolicy);
+
+    ~EpicsPushDispatcher();
+
+    /**
+     * @brief Prepare the per-reason data for the keepLatest policy.
+     *
+     * Can be called while the values are being pushed, when new reasons are
+     *  registered on a running IOC. Must not be called concurrently with
+     *  itself.
+     *
+     * @param numReasons the number of reasons registered on the port
+     */
+    void setNumReasons(size_t numReasons);
+
+    /**
+     * @brief Queue a value for the dispatcher thread.
+     *
+     * @param push the value to queue. Its content is moved into the queue
+     */
+    void enqueue(queuedPush_t& push);
+
+    void report(FILE* pFile) const;
+
+    /**
+     * @brief Returns the number of values discarded or overwritten because
+     *        the queue was full.
+     */
+    std::uint64_t getDroppedValues() const;
+
+private:
+    void dispatch();
+
+    void deliver(queuedPush_t& push);
+
+    void deliverLatestValues();
+
+    void wakeDispatcher();
+
+    EpicsInterfaceImpl* m_pInterface;
+    const pushQueueOverflow_t m_overflowPolicy;
+
+    EpicsRingBuffer<queuedPush_t> m_queue;
+
+    /**
+     * @brief Latest value of a PV that did not fit in the queue (keepLatest policy).
+     *
+     * The value is delivered once the dispatcher has delivered all the
+     *  values that were in the queue when it was stored.
+     */
+    struct latestValue_t
+    {
+        latestValue_t(): m_pending(false), m_enqueuePosition(0)
+        {
+        }
+
+        std::mutex m_lock;
+        bool m_pending;
+        size_t m_enqueuePosition;
+        queuedPush_t m_push;
+    };
+    std::vector<std::unique_ptr<latestValue_t> > m_latestValues; ///< Owns the latest values
+
+    /**
+     * @brief Returns the latest value of a reason. The latest values are
+     *        never deleted.
+     */
+    latestValue_t& getLatestValue(size_t reason) const;
+
+    typedef std::vector<latestValue_t*> latestValuesIndex_t;
+    EpicsSnapshot<latestValuesIndex_t> m_latestValuesIndex; ///< Latest values by reason, read without locks
+    std::mutex m_pendingLatestLock;
+    std::vector<size_t> m_pendingLatest;           ///< Reasons with a pending latest value.
+    std::atomic<size_t> m_numPendingLatest;
+
+    std::atomic<bool> m_running;
+    std::atomic<bool> m_dispatcherSleeping;
+    std::atomic<size_t> m_waitingProducers;
+    epicsEventId m_dispatcherEvent;
+    epicsEventId m_spaceEvent;
+
+    std::atomic<std::uint64_t> m_queuedValues;     ///< Values stored in the queue.
+    std::atomic<std::uint64_t> m_droppedValues;    ///< Values discarded or overwritten because the queue was full.
+    std::atomic<std::uint64_t> m_deliveryErrors;   ///< Values not delivered because of an exception.
+    std::atomic<size_t> m_maxDepth;                ///< Highest number of values observed in the queue.
+
+    std::unique_ptr<EpicsThread> m_pThread;
+};
+
+}
+
+#endif // NDSEPICSPUSHDISPATCHER_H
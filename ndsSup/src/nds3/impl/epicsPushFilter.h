@@ -0,0 +1,109 @@
+/*
+ * EPICS support for NDS3
+ *
+ * Copyright (c) 2015 Cosylab d.d.
+ *
+ * For more information about the license please refer to the license.txt
+ * file included in the distribution.
+ */
+
+#ifndef NDSEPICSPUSHFILTER_H
+#define NDSEPICSPUSHFILTER_H
+
+#include <atomic>
+#include <mutex>
+#include <cstdint>
+#include <ctime>
+
+namespace nds
+{
+
+/**
+ * @brief Settings of the filter applied to the values pushed to a PV.
+ *
+ * A value of 0 disables the corresponding check.
+ */
+struct pushFilterSettings_t
+{
+    pushFilterSettings_t(): m_absoluteDeadband(0), m_relativeDeadband(0), m_minIntervalSeconds(0), m_onChange(false)
+    {
+    }
+
+    double m_absoluteDeadband;   ///< Scalars only: minimum absolute change from the last delivered value.
+    double m_relativeDeadband;   ///< Scalars only: minimum change relative to the last delivered value.
+    double m_minIntervalSeconds; ///< Minimum time between two delivered values.
+    bool m_onChange;             ///< Scalars only: deliver only values different from the last delivered one.
+};
+
+/**
+ * @internal
+ * @brief Decides if a pushed value is delivered to the EPICS records.
+ *
+ * The values are compared with the last delivered one, as the MDEL field of
+ *  the EPICS records does. The values suppressed by the rate limit are not
+ *  delivered later.
+ */
+class EpicsPushFilter
+{
+public:
+    EpicsPushFilter(const pushFilterSettings_t& settings);
+
+    /**
+     * @brief Check a scalar value.
+     *
+     * @param value the pushed value
+     * @return true if the value must be delivered, false if it is suppressed
+     */
+    bool acceptValue(double value);
+
+    /**
+     * @brief Check an integer scalar value. The values are compared exactly,
+     *        also above 2^53 where the doubles cannot represent them.
+     *
+     * @param value the pushed value
+     * @return true if the value must be delivered, false if it is suppressed
+     */
+    bool acceptValue(std::int64_t value);
+
+    /**
+     * @brief Check an array. Only the rate limit is applied.
+     *
+     * @return true if the array must be delivered, false if it is suppressed
+     */
+    bool acceptArray();
+
+    std::uint64_t getSuppressed() const;
+
+    const pushFilterSettings_t& getSettings() const;
+
+private:
+    bool checkInterval(const timespec& now) const;
+
+    /**
+     * @brief Apply the checks to a scalar value. m_lock must be held.
+     *
+     * @param comparable false if the deadbands and onChange don't apply (NaN
+     *                   compared with a number)
+     * @param unchanged  true if the value is equal to the last delivered one
+     * @param change     absolute difference from the last delivered value
+     * @param lastValue  the last delivered value
+     * @param now        the time of the push, set when a minimum interval is
+     *                   configured
+     * @return true if the value must be delivered
+     */
+    bool checkScalar(bool comparable, bool unchanged, double change, double lastValue, const timespec& now);
+
+    const pushFilterSettings_t m_settings;
+
+    std::mutex m_lock;            ///< Protects the data of the last delivered value.
+    bool m_delivered;             ///< true after the first value has been delivered.
+    double m_lastValue;
+    std::int64_t m_lastInteger;   ///< The last delivered value, when checked by acceptValue(std::int64_t)
+    timespec m_lastTime;          ///< Monotonic time of the last delivered value.
+
+    std::atomic<std::uint64_t> m_suppressed;
+};
+
+}
+
+#endif // NDSEPICSPUSHFILTER_H
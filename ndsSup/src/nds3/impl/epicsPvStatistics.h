@@ -0,0 +1,105 @@
+/*
+ * EPICS support for NDS3
+ *
+ * Copyright (c) 2015 Cosylab d.d.
+ *
+ * For more information about the license please refer to the license.txt
+ * file included in the distribution.
+ */
+
+#ifndef NDSEPICSPVSTATISTICS_H
+#define NDSEPICSPVSTATISTICS_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <ctime>
+
+namespace nds
+{
+
+/**
+ * @brief Values of the counters of a PV, returned by
+ *        EpicsPvStatistics::getSnapshot().
+ */
+struct pvStatisticsSnapshot_t
+{
+    std::uint64_t m_pushes;           ///< Values pushed by the driver.
+    std::uint64_t m_callbacks;        ///< Interrupt callbacks called with the pushed values.
+    std::uint64_t m_reads;            ///< Reads requested by the records.
+    std::uint64_t m_writes;           ///< Writes requested by the records.
+    std::uint64_t m_readNanoseconds;  ///< Total duration of the reads.
+    std::uint64_t m_writeNanoseconds; ///< Total duration of the writes.
+    std::uint64_t m_errors;           ///< Reads and writes that failed.
+    std::uint64_t m_bytes;            ///< Bytes pushed, read and written.
+};
+
+/**
+ * @internal
+ * @brief Counters of the operations on a PV.
+ *
+ * The counters are updated with relaxed atomic operations by the threads
+ *  that push, read and write the PV: they are consistent individually, not
+ *  with each other.
+ */
+class EpicsPvStatistics
+{
+public:
+    EpicsPvStatistics();
+
+    void countPush(size_t bytes)
+    {
+        m_pushes.fetch_add(1, std::memory_order_relaxed);
+        m_bytes.fetch_add(bytes, std::memory_order_relaxed);
+    }
+
+    void countCallbacks(size_t callbacks)
+    {
+        m_callbacks.fetch_add(callbacks, std::memory_order_relaxed);
+    }
+
+    void countRead(std::uint64_t nanoseconds, size_t bytes)
+    {
+        m_reads.fetch_add(1, std::memory_order_relaxed);
+        m_readNanoseconds.fetch_add(nanoseconds, std::memory_order_relaxed);
+        m_bytes.fetch_add(bytes, std::memory_order_relaxed);
+    }
+
+    void countWrite(std::uint64_t nanoseconds, size_t bytes)
+    {
+        m_writes.fetch_add(1, std::memory_order_relaxed);
+        m_writeNanoseconds.fetch_add(nanoseconds, std::memory_order_relaxed);
+        m_bytes.fetch_add(bytes, std::memory_order_relaxed);
+    }
+
+    void countError()
+    {
+        m_errors.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    pvStatisticsSnapshot_t getSnapshot() const;
+
+    /**
+     * @brief Monotonic time in nanoseconds, used to measure the durations.
+     */
+    static std::uint64_t getNanoseconds()
+    {
+        timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        return (std::uint64_t)now.tv_sec * 1000000000 + (std::uint64_t)now.tv_nsec;
+    }
+
+private:
+    std::atomic<std::uint64_t> m_pushes;
+    std::atomic<std::uint64_t> m_callbacks;
+    std::atomic<std::uint64_t> m_reads;
+    std::atomic<std::uint64_t> m_writes;
+    std::atomic<std::uint64_t> m_readNanoseconds;
+    std::atomic<std::uint64_t> m_writeNanoseconds;
+    std::atomic<std::uint64_t> m_errors;
+    std::atomic<std::uint64_t> m_bytes;
+};
+
+}
+
+#endif // NDSEPICSPVSTATISTICS_H
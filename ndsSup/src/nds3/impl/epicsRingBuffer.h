@@ -0,0 +1,177 @@
+/*
+ * EPICS support for NDS3
+ *
+ * Copyright (c) 2015 Cosylab d.d.
+ *
+ * For more information about the license please refer to the license.txt
+ * file included in the distribution.
+ */
+
+#ifndef NDSEPICSRINGBUFFER_H
+#define NDSEPICSRINGBUFFER_H
+
+#include <atomic>
+#include <memory>
+#include <cstddef>
+#include <cstdint>
+
+namespace nds
+{
+
+/**
+ * @internal
+ * @brief Bounded lock-free queue with multiple producers and consumers.
+ *
+ * Each cell carries a sequence number that tells producers and consumers
+ *  whether the cell is free or contains data for the current lap, so the
+ *  only contention is on the producer and consumer positions. The storage is
+ *  allocated in the constructor; the capacity is rounded up to a power of 2.
+ */
+template<typename T>
+class EpicsRingBuffer
+{
+public:
+    EpicsRingBuffer(size_t capacity)
+    {
+        size_t roundedCapacity(2);
+        while(roundedCapacity < capacity)
+        {
+            roundedCapacity <<= 1;
+        }
+        m_mask = roundedCapacity - 1;
+        m_pCells.reset(new cell_t[roundedCapacity]);
+        for(size_t scanCells(0); scanCells != roundedCapacity; ++scanCells)
+        {
+            m_pCells[scanCells].m_sequence.store(scanCells, std::memory_order_relaxed);
+        }
+        m_enqueuePosition.store(0, std::memory_order_relaxed);
+        m_dequeuePosition.store(0, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Move an item into the queue.
+     *
+     * @param item the item to store. It is moved only when the function succeeds
+     * @return true on success, false if the queue is full
+     */
+    bool tryPush(T& item)
+    {
+        cell_t* pCell;
+        size_t position = m_enqueuePosition.load(std::memory_order_relaxed);
+        for(;;)
+        {
+            pCell = &m_pCells[position & m_mask];
+            size_t sequence = pCell->m_sequence.load(std::memory_order_acquire);
+            std::intptr_t difference = (std::intptr_t)sequence - (std::intptr_t)position;
+            if(difference == 0)
+            {
+                if(m_enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                {
+                    break;
+                }
+            }
+            else if(difference < 0)
+            {
+                return false;
+            }
+            else
+            {
+                position = m_enqueuePosition.load(std::memory_order_relaxed);
+            }
+        }
+        pCell->m_data = std::move(item);
+        pCell->m_sequence.store(position + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief Move the oldest item out of the queue.
+     *
+     * @param item receives the item
+     * @return true on success, false if the queue is empty
+     */
+    bool tryPop(T& item)
+    {
+        cell_t* pCell;
+        size_t position = m_dequeuePosition.load(std::memory_order_relaxed);
+        for(;;)
+        {
+            pCell = &m_pCells[position & m_mask];
+            size_t sequence = pCell->m_sequence.load(std::memory_order_acquire);
+            std::intptr_t difference = (std::intptr_t)sequence - (std::intptr_t)(position + 1);
+            if(difference == 0)
+            {
+                if(m_dequeuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                {
+                    break;
+                }
+            }
+            else if(difference < 0)
+            {
+                return false;
+            }
+            else
+            {
+                position = m_dequeuePosition.load(std::memory_order_relaxed);
+            }
+        }
+        item = std::move(pCell->m_data);
+        pCell->m_sequence.store(position + m_mask + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief Number of items pushed since the creation of the queue.
+     */
+    size_t getEnqueuePosition() const
+    {
+        return m_enqueuePosition.load(std::memory_order_acquire);
+    }
+
+    /**
+     * @brief Number of items popped since the creation of the queue.
+     */
+    size_t getDequeuePosition() const
+    {
+        return m_dequeuePosition.load(std::memory_order_acquire);
+    }
+
+    /**
+     * @brief Approximate number of items in the queue.
+     */
+    size_t size() const
+    {
+        size_t dequeuePosition(getDequeuePosition());
+        size_t enqueuePosition(getEnqueuePosition());
+        return enqueuePosition > dequeuePosition ? enqueuePosition - dequeuePosition : 0;
+    }
+
+    size_t capacity() const
+    {
+        return m_mask + 1;
+    }
+
+private:
+    EpicsRingBuffer(const EpicsRingBuffer&);
+    EpicsRingBuffer& operator=(const EpicsRingBuffer&);
+
+    struct cell_t
+    {
+        std::atomic<size_t> m_sequence;
+        T m_data;
+    };
+
+    std::unique_ptr<cell_t[]> m_pCells;
+    size_t m_mask;
+
+    // Keep the producer and consumer positions on different cache lines
+    char m_padding0[64];
+    std::atomic<size_t> m_enqueuePosition;
+    char m_padding1[64];
+    std::atomic<size_t> m_dequeuePosition;
+    char m_padding2[64];
+};
+
+}
+
+#endif // NDSEPICSRINGBUFFER_H
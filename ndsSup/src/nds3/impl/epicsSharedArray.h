@@ -0,0 +1,157 @@
+/*
+ * EPICS support for NDS3
+ *
+ * Copyright (c) 2015 Cosylab d.d.
+ *
+ * For more information about the license please refer to the license.txt
+ * file included in the distribution.
+ */
+
+#ifndef NDSEPICSSHAREDARRAY_H
+#define NDSEPICSSHAREDARRAY_H
+
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <typeinfo>
+#include <cstddef>
+#include <ctime>
+
+namespace nds
+{
+
+/**
+ * @brief Array published by EpicsInterfaceImpl::pushSharedArray() or push(),
+ *        delivered by reference to the asyn genericPointer interrupt clients.
+ *
+ * The interrupt callback receives a pointer to this structure. The structure
+ *  itself is valid only during the callback: a client that needs the data
+ *  later must copy m_pOwner, which keeps the data alive and unmodified.
+ */
+struct EpicsSharedArray
+{
+    std::shared_ptr<const void> m_pOwner; ///< Owner of the data.
+    const void* m_pData;                  ///< The first element.
+    size_t m_numElements;
+    const std::type_info* m_pElementType; ///< typeid() of the elements.
+    timespec m_timestamp;
+};
+
+
+/**
+ * @brief Pool of arrays that return to the pool when the last reference is
+ *        released.
+ *
+ * A driver acquires an array, fills it and publishes it with
+ *  EpicsInterfaceImpl::pushSharedArray(): the EPICS layer, the push queue, the
+ *  value cache and the genericPointer clients share it without copying. When
+ *  they all have released it the array goes back to the pool with its memory,
+ *  ready for the next acquisition.
+ *
+ * The pool can be destroyed while some arrays are still in use: they are
+ *  then deleted when released.
+ *
+ * Example:
+ * @code
+ * EpicsBufferPool<std::int16_t> pool(4);
+ * std::shared_ptr<std::vector<std::int16_t> > pBuffer(pool.acquire(numSamples));
+ * readDma(pBuffer->data(), numSamples);
+ * pInterface->pushSharedArray<std::int16_t>(*pWaveformImpl, timestamp, pBuffer);
+ * @endcode
+ */
+template<typename T>
+class EpicsBufferPool
+{
+public:
+    /**
+     * @param maxFreeBuffers maximum number of released arrays kept in the pool
+     */
+    EpicsBufferPool(size_t maxFreeBuffers): m_pState(new state_t(maxFreeBuffers))
+    {
+    }
+
+    /**
+     * @brief Get an array from the pool, or allocate a new one if the pool
+     *        is empty.
+     *
+     * @param numElements the size of the returned array
+     * @return the array. It returns to the pool when the last copy of the
+     *         shared pointer is destroyed
+     */
+    std::shared_ptr<std::vector<T> > acquire(size_t numElements)
+    {
+        std::vector<T>* pBuffer(0);
+        {
+            std::lock_guard<std::mutex> lock(m_pState->m_lock);
+            if(!m_pState->m_freeBuffers.empty())
+            {
+                pBuffer = m_pState->m_freeBuffers.back();
+                m_pState->m_freeBuffers.pop_back();
+            }
+        }
+        if(pBuffer == 0)
+        {
+            pBuffer = new std::vector<T>;
+        }
+        pBuffer->resize(numElements);
+
+        return std::shared_ptr<std::vector<T> >(pBuffer, release_t(m_pState));
+    }
+
+private:
+    struct state_t
+    {
+        state_t(size_t maxFreeBuffers): m_maxFreeBuffers(maxFreeBuffers)
+        {
+            // The deleter must not allocate
+            m_freeBuffers.reserve(maxFreeBuffers);
+        }
+
+        ~state_t()
+        {
+            for(typename std::vector<std::vector<T>*>::iterator scanBuffers(m_freeBuffers.begin()), endBuffers(m_freeBuffers.end());
+                scanBuffers != endBuffers;
+                ++scanBuffers)
+            {
+                delete *scanBuffers;
+            }
+        }
+
+        const size_t m_maxFreeBuffers;
+        std::mutex m_lock;
+        std::vector<std::vector<T>*> m_freeBuffers;
+    };
+
+    /**
+     * @brief Deleter of the acquired arrays: puts them back in the pool.
+     */
+    struct release_t
+    {
+        release_t(const std::shared_ptr<state_t>& pState): m_pState(pState)
+        {
+        }
+
+        void operator()(std::vector<T>* pBuffer) const
+        {
+            std::shared_ptr<state_t> pState(m_pState.lock());
+            if(pState.get() != 0)
+            {
+                std::lock_guard<std::mutex> lock(pState->m_lock);
+                if(pState->m_freeBuffers.size() < pState->m_maxFreeBuffers)
+                {
+                    pState->m_freeBuffers.push_back(pBuffer);
+                    return;
+                }
+            }
+            delete pBuffer;
+        }
+
+        std::weak_ptr<state_t> m_pState;
+    };
+
+    std::shared_ptr<state_t> m_pState;
+};
+
+}
+
+#endif // NDSEPICSSHAREDARRAY_H
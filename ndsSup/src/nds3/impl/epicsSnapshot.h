@@ -0,0 +1,143 @@
+/*
+ * EPICS support for NDS3
+ *
+ * Copyright (c) 2015 Cosylab d.d.
+ *
+ * For more information about the license please refer to the license.txt
+ * file included in the distribution.
+ */
+
+#ifndef NDSEPICSSNAPSHOT_H
+#define NDSEPICSSNAPSHOT_H
+
+#include <atomic>
+#include <memory>
+#include <cstddef>
+
+#include <epicsThread.h>
+
+namespace nds
+{
+
+/**
+ * @internal
+ * @brief Publishes immutable snapshots of a data structure to readers that
+ *        don't lock, and deletes a snapshot once it has been replaced and
+ *        its readers are gone.
+ *
+ * The readers are counted in two counters, selected by the parity of an
+ *  epoch: publish() increments the epoch, so the new readers use the other
+ *  counter, and then waits for the counter of the previous epoch to drop to
+ *  zero before deleting the replaced snapshot.
+ *
+ * The readers must hold a snapshot only for a short time and must not block
+ *  or call code that may publish a snapshot while holding it.
+ *
+ * @tparam T the type of the snapshots
+ */
+template<typename T>
+class EpicsSnapshot
+{
+public:
+    EpicsSnapshot(): m_pSnapshot(0), m_epoch(0)
+    {
+        m_readers[0].store(0);
+        m_readers[1].store(0);
+    }
+
+    ~EpicsSnapshot()
+    {
+        delete m_pSnapshot.load();
+    }
+
+    /**
+     * @brief Gives access to the snapshot published when it is constructed,
+     *        until it goes out of scope.
+     */
+    class reader_t
+    {
+    public:
+        reader_t(const EpicsSnapshot& snapshot): m_snapshot(snapshot)
+        {
+            // A reader that raced with publish() may have counted itself in
+            //  a counter that is already being drained: retry
+            for(;;)
+            {
+                m_epoch = m_snapshot.m_epoch.load();
+                ++m_snapshot.m_readers[m_epoch & 1];
+                if(m_snapshot.m_epoch.load() == m_epoch)
+                {
+                    break;
+                }
+                --m_snapshot.m_readers[m_epoch & 1];
+            }
+            m_pSnapshot = m_snapshot.m_pSnapshot.load();
+        }
+
+        ~reader_t()
+        {
+            --m_snapshot.m_readers[m_epoch & 1];
+        }
+
+        /**
+         * @brief Returns the snapshot, or NULL if none has been published.
+         */
+        const T* get() const
+        {
+            return m_pSnapshot;
+        }
+
+        const T* operator->() const
+        {
+            return m_pSnapshot;
+        }
+
+    private:
+        reader_t(const reader_t&);
+        reader_t& operator=(const reader_t&);
+
+        const EpicsSnapshot& m_snapshot;
+        size_t m_epoch;
+        const T* m_pSnapshot;
+    };
+
+    /**
+     * @brief Replace the snapshot. Returns when the readers of the replaced
+     *        snapshot are gone and the snapshot has been deleted.
+     *
+     * Must not be called concurrently with itself.
+     *
+     * @param pSnapshot the new snapshot
+     */
+    void publish(std::unique_ptr<const T> pSnapshot)
+    {
+        std::unique_ptr<const T> pReplaced(m_pSnapshot.exchange(pSnapshot.release()));
+
+        size_t epoch(m_epoch.load());
+        m_epoch.store(epoch + 1);
+        while(m_readers[epoch & 1].load() != 0)
+        {
+            epicsThreadSleep(0);
+        }
+    }
+
+    /**
+     * @brief Returns true if a snapshot has been published.
+     */
+    bool isPublished() const
+    {
+        return m_pSnapshot.load() != 0;
+    }
+
+private:
+    EpicsSnapshot(const EpicsSnapshot&);
+    EpicsSnapshot& operator=(const EpicsSnapshot&);
+
+    std::atomic<const T*> m_pSnapshot;
+    std::atomic<size_t> m_epoch;
+    mutable std::atomic<size_t> m_readers[2]; ///< Readers counted by the parity of the epoch they started in
+};
+
+}
+
+#endif // NDSEPICSSNAPSHOT_H
@@ -18,13 +18,24 @@
 #include <nds3/impl/factoryBaseImpl.h>
 #include <nds3/impl/threadBaseImpl.h>
 
+#include "nds3/impl/epicsThreadPolicy.h"
+
 namespace nds
 {
 
 class EpicsThread: public ThreadBaseImpl
 {
 public:
-    EpicsThread(FactoryBaseImpl* pImpl, const std::string& name, threadFunction_t function);
+    /**
+     * @param pImpl    the factory that requested the thread
+     * @param name     the thread's name
+     * @param function the function executed by the thread
+     * @param settings priority, stack size, scheduling policy and CPU affinity
+     *                 of the thread. The policy and the affinity are applied by
+     *                 the thread before calling the function
+     */
+    EpicsThread(FactoryBaseImpl* pImpl, const std::string& name, threadFunction_t function,
+                const threadPolicySettings_t& settings = threadPolicySettings_t());
 
     ~EpicsThread();
 
@@ -35,6 +46,7 @@ protected:
 
 private:
     threadFunction_t m_function;
+    const threadPolicySettings_t m_settings;
     epicsThreadId m_threadId;
     epicsEventId m_threadStartedEventId;
 
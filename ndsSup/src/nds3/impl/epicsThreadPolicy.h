@@ -0,0 +1,78 @@
+/*
+ * EPICS support for NDS3
+ *
+ * Copyright (c) 2015 Cosylab d.d.
+ *
+ * For more information about the license please refer to the license.txt
+ * file included in the distribution.
+ */
+
+#ifndef NDSEPICSTHREADPOLICY_H
+#define NDSEPICSTHREADPOLICY_H
+
+#include <set>
+#include <string>
+#include <cstddef>
+
+#include <epicsThread.h>
+
+namespace nds
+{
+
+/**
+ * @brief Scheduling policy of a thread.
+ */
+enum class schedulingPolicy_t
+{
+    other,      ///< The default time-sharing scheduler (SCHED_OTHER).
+    fifo,       ///< Real-time, first in first out (SCHED_FIFO).
+    roundRobin  ///< Real-time, round robin (SCHED_RR).
+};
+
+/**
+ * @brief Scheduling settings of the threads, set with ndsSetThreadPolicy or
+ *        EpicsFactoryImpl::setThreadPolicy().
+ */
+struct threadPolicySettings_t
+{
+    threadPolicySettings_t(): m_priority(epicsThreadPriorityMedium), m_policy(schedulingPolicy_t::other), m_stackSize(0)
+    {
+    }
+
+    unsigned int m_priority;     ///< EPICS priority (0-99), also used as real-time priority by fifo and roundRobin.
+    schedulingPolicy_t m_policy;
+    size_t m_stackSize;          ///< Stack size in bytes, 0 for the default size.
+    std::set<unsigned int> m_cpus; ///< CPUs the thread may run on, empty for all the CPUs.
+};
+
+/**
+ * @brief Apply the priority, the scheduling policy and the CPU affinity to a
+ *        running thread. The stack size is used only when the threads are
+ *        created.
+ *
+ * The real-time policies usually require the CAP_SYS_NICE capability or an
+ *  rtprio limit in /etc/security/limits.conf.
+ *
+ * @param threadId the thread
+ * @param settings the settings to apply
+ * @throws std::runtime_error if the settings cannot be applied
+ */
+void applyThreadPolicy(epicsThreadId threadId, const threadPolicySettings_t& settings);
+
+/**
+ * @brief Parse a scheduling policy: "other", "fifo" or "rr".
+ *
+ * @throws std::runtime_error if the policy is unknown
+ */
+schedulingPolicy_t parseSchedulingPolicy(const std::string& policy);
+
+/**
+ * @brief Parse a list of CPUs in the form "0,2-3".
+ *
+ * @throws std::runtime_error if the list is malformed
+ */
+std::set<unsigned int> parseCpuList(const std::string& cpuList);
+
+}
+
+#endif // NDSEPICSTHREADPOLICY_H
@@ -0,0 +1,168 @@
+/*
+ * EPICS support for NDS3
+ *
+ * Copyright (c) 2015 Cosylab d.d.
+ *
+ * For more information about the license please refer to the license.txt
+ * file included in the distribution.
+ */
+
+#ifndef NDSEPICSTHREADPOOL_H
+#define NDSEPICSTHREADPOOL_H
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <cstdio>
+
+#include <epicsEvent.h>
+#include <epicsThread.h>
+
+#include <nds3/definitions.h>
+#include <nds3/impl/factoryBaseImpl.h>
+#include <nds3/impl/threadBaseImpl.h>
+
+namespace nds
+{
+
+/**
+ * @internal
+ * @brief Reusable threads that execute the functions passed to
+ *        EpicsFactoryImpl::runInThread().
+ *
+ * The functions may run for the lifetime of the IOC (e.g. acquisition loops),
+ *  so a function never waits for a busy worker: it is handed to an idle
+ *  worker, or a new worker is started when all the workers are busy. The
+ *  queued functions are stolen by the workers that become idle before their
+ *  assigned worker wakes up.
+ *
+ * Up to maxIdleWorkers workers are kept when idle, the others exit after
+ *  idleTimeoutSeconds without work.
+ */
+class EpicsThreadPool
+{
+public:
+    /**
+     * @param name               prefix of the names of the worker threads
+     * @param maxIdleWorkers     number of idle workers kept for the next functions
+     * @param idleTimeoutSeconds time after which the workers in excess exit
+     */
+    EpicsThreadPool(const std::string& name, size_t maxIdleWorkers, double idleTimeoutSeconds);
+
+    /**
+     * @brief Waits for the workers to terminate their functions and exit.
+     */
+    ~EpicsThreadPool();
+
+    void setMaxIdleWorkers(size_t maxIdleWorkers);
+
+    size_t getMaxIdleWorkers() const;
+
+    /**
+     * @brief Enable or disable the pool. The factory gives a dedicated thread
+     *        to the functions while the pool is disabled; the workers already
+     *        started terminate their functions.
+     */
+    void setEnabled(bool enabled);
+
+    bool isEnabled() const;
+
+    /**
+     * @brief Execute a function in a worker.
+     *
+     * @param pFactory the factory that requested the thread
+     * @param name     the name of the task, used in the error messages
+     * @param function the function to execute
+     * @return a handle whose join() waits for the function's termination
+     */
+    ThreadBaseImpl* run(FactoryBaseImpl* pFactory, const std::string& name, threadFunction_t function);
+
+    /**
+     * @brief Print the workers and the name of the task each of them is
+     *        executing: the workers cannot take the name of their task, so
+     *        the tasks don't appear under their name in epicsThreadShowAll.
+     *
+     * @param pFile where to print
+     */
+    void report(FILE* pFile) const;
+
+private:
+    /**
+     * @brief A function to execute, shared by the worker and the handle.
+     */
+    struct task_t
+    {
+        task_t(const std::string& name, threadFunction_t function): m_name(name), m_function(function), m_done(false)
+        {
+        }
+
+        const std::string m_name;
+        threadFunction_t m_function;
+
+        std::mutex m_lock;
+        std::condition_variable m_doneCondition;
+        bool m_done;
+    };
+
+    typedef std::shared_ptr<task_t> pTask_t;
+
+    /**
+     * @brief Handle returned by run().
+     */
+    class pooledThread_t: public ThreadBaseImpl
+    {
+    public:
+        pooledThread_t(FactoryBaseImpl* pFactory, const std::string& name, const pTask_t& pTask);
+
+        virtual void join();
+
+    private:
+        pTask_t m_pTask;
+    };
+
+    struct worker_t
+    {
+        worker_t(EpicsThreadPool* pPool, const std::string& threadName);
+        ~worker_t();
+
+        EpicsThreadPool* m_pPool;
+        const std::string m_threadName;
+        epicsEventId m_wakeUp;
+        bool m_idle;                  ///< Protected by EpicsThreadPool::m_workersLock
+        std::string m_taskName;       ///< The task being executed, protected by EpicsThreadPool::m_workersLock
+
+        std::mutex m_tasksLock;
+        std::deque<pTask_t> m_tasks;  ///< The owner pops from the front, the thieves from the back
+    };
+
+    static void workerThread(void* pParameter);
+
+    void runWorker(worker_t* pWorker);
+
+    /**
+     * @brief Take a task from the worker's queue or from another worker.
+     *        m_workersLock must be held.
+     */
+    pTask_t getTask(worker_t* pWorker);
+
+    static void execute(const std::string& threadName, const pTask_t& pTask);
+
+    const std::string m_name;
+    const double m_idleTimeoutSeconds;
+
+    mutable std::mutex m_workersLock;
+    std::condition_variable m_noWorkersCondition;  ///< Signalled when the last worker exits
+    size_t m_maxIdleWorkers;
+    bool m_enabled;
+    bool m_stopping;
+    size_t m_threadCounter;                        ///< Used to name the threads
+    std::vector<std::unique_ptr<worker_t> > m_workers;
+    std::vector<worker_t*> m_idleWorkers;          ///< Most recently idle last
+};
+
+}
+
+#endif // NDSEPICSTHREADPOOL_H
@@ -0,0 +1,166 @@
+/*
+ * EPICS support for NDS3
+ *
+ * Copyright (c) 2015 Cosylab d.d.
+ *
+ * For more information about the license please refer to the license.txt
+ * file included in the distribution.
+ */
+
+#ifndef NDSEPICSVALUECACHE_H
+#define NDSEPICSVALUECACHE_H
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+
+namespace nds
+{
+
+/**
+ * @internal
+ * @brief Keeps the last value pushed to a PV, so the reads of the records
+ *        can be served without calling the driver.
+ *
+ * Arrays are shared with the push queue, if enabled, and are never modified
+ *  once stored. A cached value is used only if it was pushed less than
+ *  maxAgeSeconds ago (measured with the monotonic clock).
+ */
+class EpicsValueCache
+{
+public:
+    /**
+     * @param maxAgeSeconds maximum age of a cached value. 0 means that once
+     *                      a value has been pushed the PV is never read again
+     */
+    EpicsValueCache(double maxAgeSeconds);
+
+    template<typename T>
+    void storeValue(const timespec& timestamp, const T& value)
+    {
+        static_assert(sizeof(T) <= sizeof(m_scalar), "Scalar type too big for the cache");
+
+        timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+
+        std::lock_guard<std::mutex> lock(m_lock);
+        ::memcpy(&m_scalar, &value, sizeof(T));
+        m_elementSize = sizeof(T);
+        m_pArray.reset();
+        m_timestamp = timestamp;
+        m_storeTime = now;
+        m_valid = true;
+    }
+
+    /**
+     * @brief Store an array.
+     *
+     * @param timestamp   the array's timestamp
+     * @param pOwner      keeps the array alive. The array must not be modified
+     * @param pData       the first element of the array
+     * @param numElements the number of elements in the array
+     */
+    template<typename T>
+    void storeArray(const timespec& timestamp, const std::shared_ptr<const void>& pOwner, const T* pData, size_t numElements)
+    {
+        timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_pArray = pOwner;
+        m_pArrayData = pData;
+        m_numElements = numElements;
+        m_elementSize = sizeof(T);
+        m_timestamp = timestamp;
+        m_storeTime = now;
+        m_valid = true;
+    }
+
+    /**
+     * @brief Retrieve the cached scalar.
+     *
+     * @param pTimestamp receives the timestamp of the pushed value
+     * @param pValue     receives the value
+     * @return true on a cache hit, false if the value is missing or stale
+     */
+    template<typename T>
+    bool getValue(timespec* pTimestamp, T* pValue)
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        if(m_pArray.get() != 0 || !isFresh(sizeof(T)))
+        {
+            ++m_misses;
+            return false;
+        }
+        ::memcpy(pValue, &m_scalar, sizeof(T));
+        *pTimestamp = m_timestamp;
+        ++m_hits;
+        return true;
+    }
+
+    /**
+     * @brief Copy the cached array into the record's buffer.
+     *
+     * @param pTimestamp   receives the timestamp of the pushed array
+     * @param pBuffer      the buffer to fill
+     * @param capacity     the maximum number of elements that fit in pBuffer
+     * @param pNumElements receives the number of elements copied into pBuffer
+     * @return true on a cache hit, false if the array is missing or stale
+     */
+    template<typename T>
+    bool getArray(timespec* pTimestamp, T* pBuffer, size_t capacity, size_t* pNumElements)
+    {
+        std::shared_ptr<const void> pArray;
+        const void* pArrayData;
+        size_t numElements;
+        {
+            std::lock_guard<std::mutex> lock(m_lock);
+            if(m_pArray.get() == 0 || !isFresh(sizeof(T)))
+            {
+                ++m_misses;
+                return false;
+            }
+            pArray = m_pArray;
+            pArrayData = m_pArrayData;
+            numElements = m_numElements;
+            *pTimestamp = m_timestamp;
+        }
+
+        // The array is immutable: copy it outside the lock
+        *pNumElements = std::min(numElements, capacity);
+        ::memcpy(pBuffer, pArrayData, *pNumElements * sizeof(T));
+        ++m_hits;
+        return true;
+    }
+
+    std::uint64_t getHits() const;
+
+    std::uint64_t getMisses() const;
+
+private:
+    bool isFresh(size_t elementSize) const;
+
+    const double m_maxAgeSeconds;
+
+    std::mutex m_lock;                    ///< Protects the cached value.
+    bool m_valid;
+    size_t m_elementSize;                 ///< Size of the cached type, checked by the readers.
+    std::uint64_t m_scalar;
+    std::shared_ptr<const void> m_pArray; ///< Owner of the cached array.
+    const void* m_pArrayData;
+    size_t m_numElements;
+    timespec m_timestamp;                 ///< Timestamp pushed with the value.
+    timespec m_storeTime;                 ///< Monotonic time at which the value was stored.
+
+    std::atomic<std::uint64_t> m_hits;
+    std::atomic<std::uint64_t> m_misses;
+};
+
+}
+
+#endif // NDSEPICSVALUECACHE_H